@@ -0,0 +1,212 @@
+// Headless benchmark runner: voxel-bench [--list] [--scenario name]... [--iterations n] [--seed n] [--output file]
+//                                        [--trace file] [--replay file]
+// Runs the named scenarios (all of them by default) without a window or GL context and writes
+// the results as JSON to stdout or to the output file. A short summary goes to stderr.
+// --trace also writes the scoped trace of the run as Chrome trace JSON. --replay runs only the replay
+// scenario on a file recorded with the engine's --record.
+#include "Benchmark.hpp"
+#include "MemoryStats.hpp"
+#include "Replay.hpp"
+#include "Trace.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+    std::string EscapeJson(const std::string &text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    void WriteResult(std::ostream &out, const ScenarioResult &result)
+    {
+        out << "    {\n";
+        out << "      \"name\": \"" << EscapeJson(result.name) << "\",\n";
+        out << "      \"iterations\": " << result.iterations << ",\n";
+        out << "      \"total_ms\": " << result.totalMilliseconds << ",\n";
+        out << "      \"throughput\": {\"value\": " << result.throughput << ", \"unit\": \""
+            << EscapeJson(result.throughputUnit) << "\"},\n";
+        out << "      \"latency_ms\": {\"samples\": " << result.latencies.Count()
+            << ", \"mean\": " << result.latencies.Mean()
+            << ", \"p50\": " << result.latencies.Percentile(50.0)
+            << ", \"p99\": " << result.latencies.Percentile(99.0)
+            << ", \"max\": " << result.latencies.Max() << "},\n";
+        out << "      \"counters\": {";
+        bool first = true;
+        for (const auto &counter : result.counters)
+        {
+            out << (first ? "" : ", ") << "\"" << EscapeJson(counter.first) << "\": " << counter.second;
+            first = false;
+        }
+        out << "},\n";
+        out << "      \"peak_rss_kb\": " << result.peakRssKilobytes << "\n";
+        out << "    }";
+    }
+
+    // Live and peak bytes of every accounted subsystem over the whole run
+    void WriteMemory(std::ostream &out)
+    {
+        out << "  \"memory\": {";
+        for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+        {
+            const MemoryUsage usage = MemoryStats::Get((MemoryCategory)i);
+            out << (i > 0 ? ",\n" : "\n") << "    \"" << MemoryStats::GetCategoryName((MemoryCategory)i)
+                << "\": {\"bytes\": " << usage.bytes << ", \"peak_bytes\": " << usage.peakBytes
+                << ", \"count\": " << usage.count << "}";
+        }
+        out << "\n  },\n";
+    }
+
+    void PrintUsage()
+    {
+        std::cerr << "usage: voxel-bench [--list] [--scenario name]... [--iterations n] [--seed n] [--output file] [--trace file] [--replay file]\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions options;
+    std::vector<std::string> selected;
+    std::string outputPath;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--list")
+        {
+            for (const Scenario &scenario : GetScenarios())
+            {
+                std::cerr << scenario.name << "\t" << scenario.description << "\n";
+            }
+            return 0;
+        }
+        else if (arg == "--scenario" && i + 1 < argc)
+        {
+            selected.push_back(argv[++i]);
+        }
+        else if (arg == "--iterations" && i + 1 < argc)
+        {
+            options.iterations = std::atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            options.seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--output" && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            options.replayPath = argv[++i];
+            ReplayPlayer player;
+            if (!player.Load(options.replayPath))
+            {
+                std::cerr << "Could not load replay " << options.replayPath << "\n";
+                return 1;
+            }
+            selected.push_back("replay");
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // Resolve the scenarios to run, all of them when none were named
+    std::vector<const Scenario *> toRun;
+    for (const Scenario &scenario : GetScenarios())
+    {
+        if (selected.empty())
+        {
+            toRun.push_back(&scenario);
+        }
+    }
+    for (const std::string &name : selected)
+    {
+        const Scenario *match = nullptr;
+        for (const Scenario &scenario : GetScenarios())
+        {
+            if (scenario.name == name)
+            {
+                match = &scenario;
+            }
+        }
+        if (match == nullptr)
+        {
+            std::cerr << "Unknown scenario: " << name << "\n";
+            return 1;
+        }
+        toRun.push_back(match);
+    }
+
+    std::vector<ScenarioResult> results;
+    bool mismatched = false;
+    for (const Scenario *scenario : toRun)
+    {
+        // The engine logs edits to std::cout, keep that out of the JSON
+        std::ostringstream discarded;
+        std::streambuf *previous = std::cout.rdbuf(discarded.rdbuf());
+        ScenarioResult result = scenario->run(options);
+        std::cout.rdbuf(previous);
+
+        result.name = scenario->name;
+        result.peakRssKilobytes = GetPeakRssKilobytes();
+        results.push_back(result);
+        // Correctness scenarios such as mesh-diff fail the run
+        const auto mismatches = result.counters.find("mismatches");
+        mismatched = mismatched || (mismatches != result.counters.end() && mismatches->second > 0.0);
+
+        std::cerr << result.name << ": " << result.throughput << " " << result.throughputUnit
+                  << ", p50 " << result.latencies.Percentile(50.0) << " ms"
+                  << ", p99 " << result.latencies.Percentile(99.0) << " ms\n";
+    }
+
+    if (!tracePath.empty() && !Tracer::Export(tracePath))
+    {
+        std::cerr << "Could not write " << tracePath << "\n";
+        return 1;
+    }
+
+    std::ofstream file;
+    if (!outputPath.empty())
+    {
+        file.open(outputPath);
+        if (!file)
+        {
+            std::cerr << "Could not open " << outputPath << "\n";
+            return 1;
+        }
+    }
+    std::ostream &out = outputPath.empty() ? std::cout : file;
+
+    out << "{\n  \"peak_rss_kb\": " << GetPeakRssKilobytes() << ",\n";
+    WriteMemory(out);
+    out << "  \"scenarios\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        WriteResult(out, results[i]);
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return mismatched ? 1 : 0;
+}
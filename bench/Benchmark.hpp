@@ -0,0 +1,78 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Wall clock timer used by every scenario
+class Stopwatch
+{
+public:
+    Stopwatch() { Restart(); }
+    void Restart() { m_start = std::chrono::steady_clock::now(); }
+    double ElapsedMilliseconds() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Latency samples of one scenario, in milliseconds
+class LatencySamples
+{
+public:
+    void Add(double milliseconds) { m_samples.push_back(milliseconds); }
+    // p in [0, 100], nearest rank
+    double Percentile(double p) const;
+    double Mean() const;
+    double Max() const;
+    size_t Count() const { return m_samples.size(); }
+
+private:
+    std::vector<double> m_samples;
+};
+
+// Everything a scenario reports, serialized as one JSON object
+struct ScenarioResult
+{
+    std::string name;
+    int iterations = 0;
+    double totalMilliseconds = 0.0;
+    // Work items per second, e.g. chunks/s or edits/s
+    double throughput = 0.0;
+    std::string throughputUnit;
+    LatencySamples latencies;
+    // Scenario specific numbers such as vertex counts
+    std::map<std::string, double> counters;
+    long peakRssKilobytes = 0;
+};
+
+// Options shared by all scenarios
+struct BenchOptions
+{
+    // 0 means use the scenario's default
+    int iterations = 0;
+    unsigned int seed = 1234u;
+    // Replay file for the replay scenario, a synthetic flight is used when empty
+    std::string replayPath;
+};
+
+// A named scenario
+struct Scenario
+{
+    std::string name;
+    std::string description;
+    ScenarioResult (*run)(const BenchOptions &options);
+};
+
+// Registered scenarios, in the order they run by default
+const std::vector<Scenario> &GetScenarios();
+
+// Peak resident set size of the process so far
+long GetPeakRssKilobytes();
+
+#endif /* BENCHMARK_HPP */
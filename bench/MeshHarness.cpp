@@ -0,0 +1,524 @@
+#include "MeshHarness.hpp"
+#include "ChunkManager.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <sstream>
+
+namespace
+{
+    const int CHUNK_SIZE = Chunk::CHUNK_SIZE;
+
+    // Face key layout: axis (2 bits), negative normal, front facing, then plane, u and v in
+    // voxel units, each biased into 20 bits
+    const int COORDINATE_BITS = 20;
+    const int64_t COORDINATE_BIAS = 1 << (COORDINATE_BITS - 1);
+    const uint64_t COORDINATE_MASK = (1u << COORDINATE_BITS) - 1;
+    // Keeps every doubled coordinate well inside the key and int64 edge functions
+    const float COORDINATE_LIMIT = 100000.0f;
+
+    uint64_t PackFace(int axis, bool negative, bool frontFacing, int64_t plane, int64_t u, int64_t v)
+    {
+        return ((uint64_t)axis << 62) | ((uint64_t)negative << 61) | ((uint64_t)frontFacing << 60) |
+               ((uint64_t)(plane + COORDINATE_BIAS) << (2 * COORDINATE_BITS)) |
+               ((uint64_t)(u + COORDINATE_BIAS) << COORDINATE_BITS) | (uint64_t)(v + COORDINATE_BIAS);
+    }
+
+    int64_t UnpackCoordinate(uint64_t face, int shift)
+    {
+        return (int64_t)((face >> shift) & COORDINATE_MASK) - COORDINATE_BIAS;
+    }
+
+    void ReferenceMesh(Chunk &chunk, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices)
+    {
+        indices.clear();
+        GLuint baseIndex = 0;
+        vertices = chunk.GetVertexData(0, 0, indices, baseIndex);
+    }
+
+    void PaddedMesh(Chunk &chunk, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices)
+    {
+        chunk.BuildMesh(vertices, indices);
+    }
+
+    // A triangle corner projected on the face plane, in doubled units so cell centers are odd
+    struct Point
+    {
+        int64_t u;
+        int64_t v;
+    };
+
+    int64_t Edge(const Point &a, const Point &b, const Point &p)
+    {
+        return (b.u - a.u) * (p.v - a.v) - (b.v - a.v) * (p.u - a.u);
+    }
+
+    // Samples exactly on an edge shared by two triangles belong to one of them only
+    bool OwnsEdge(const Point &a, const Point &b)
+    {
+        const int64_t du = b.u - a.u;
+        const int64_t dv = b.v - a.v;
+        return dv > 0 || (dv == 0 && du < 0);
+    }
+
+    bool Covers(const Point &a, const Point &b, const Point &p)
+    {
+        const int64_t edge = Edge(a, b, p);
+        return edge > 0 || (edge == 0 && OwnsEdge(a, b));
+    }
+
+    // Chunk coordinates of the test world, center first, then right, left, back, front
+    const int CHUNK_X[5] = {1, 0, 2, 1, 1};
+    const int CHUNK_Z[5] = {1, 1, 1, 0, 2};
+}
+
+const std::vector<Mesher> &GetMeshers()
+{
+    static const std::vector<Mesher> meshers = {
+        {"reference", ReferenceMesh},
+        {"padded", PaddedMesh},
+    };
+    return meshers;
+}
+
+FaceSet RasterizeFaces(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices)
+{
+    FaceSet result;
+    if (vertices.size() % Voxel::VERTEX_FLOATS != 0)
+    {
+        result.error = "vertex data is not a whole number of vertices";
+        return result;
+    }
+    if (indices.size() % 3 != 0)
+    {
+        result.error = "index count is not a multiple of 3";
+        return result;
+    }
+    const size_t vertexCount = vertices.size() / Voxel::VERTEX_FLOATS;
+
+    for (size_t t = 0; t < indices.size(); t += 3)
+    {
+        const GLfloat *corners[3];
+        for (int i = 0; i < 3; ++i)
+        {
+            if (indices[t + i] >= vertexCount)
+            {
+                result.error = "index " + std::to_string(indices[t + i]) + " out of range";
+                return result;
+            }
+            corners[i] = &vertices[indices[t + i] * Voxel::VERTEX_FLOATS];
+        }
+
+        // Faces lie on the voxel grid, every corner must be a whole voxel coordinate
+        int64_t doubled[3][3];
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const float value = corners[i][axis];
+                if (value != std::round(value) || std::fabs(value) > COORDINATE_LIMIT)
+                {
+                    result.error = "triangle " + std::to_string(t / 3) + " is off the voxel grid";
+                    return result;
+                }
+                doubled[i][axis] = 2 * (int64_t)value;
+            }
+        }
+
+        int axis = -1;
+        for (int candidate = 0; candidate < 3 && axis < 0; ++candidate)
+        {
+            if (doubled[0][candidate] == doubled[1][candidate] && doubled[0][candidate] == doubled[2][candidate])
+            {
+                axis = candidate;
+            }
+        }
+        const GLfloat *normal = corners[0] + 5;
+        if (axis < 0 || std::fabs(normal[axis]) != 1.0f || normal[(axis + 1) % 3] != 0.0f || normal[(axis + 2) % 3] != 0.0f)
+        {
+            result.error = "triangle " + std::to_string(t / 3) + " is not axis aligned with its normal";
+            return result;
+        }
+        const bool negative = normal[axis] < 0.0f;
+
+        // (u, v, axis) is right handed, so counter clockwise in the plane faces +axis
+        const int uAxis = (axis + 1) % 3;
+        const int vAxis = (axis + 2) % 3;
+        Point a = {doubled[0][uAxis], doubled[0][vAxis]};
+        Point b = {doubled[1][uAxis], doubled[1][vAxis]};
+        Point c = {doubled[2][uAxis], doubled[2][vAxis]};
+        const int64_t area = Edge(a, b, c);
+        if (area == 0)
+        {
+            continue;
+        }
+        const bool frontFacing = (area > 0) != negative;
+        if (area < 0)
+        {
+            std::swap(b, c);
+        }
+
+        // Sample every cell center inside the triangle's bounds
+        const int64_t minU = std::min({a.u, b.u, c.u}), maxU = std::max({a.u, b.u, c.u});
+        const int64_t minV = std::min({a.v, b.v, c.v}), maxV = std::max({a.v, b.v, c.v});
+        const int64_t plane = doubled[0][axis] / 2;
+        for (int64_t u = minU + 1; u < maxU; u += 2)
+        {
+            for (int64_t v = minV + 1; v < maxV; v += 2)
+            {
+                const Point p = {u, v};
+                if (Covers(a, b, p) && Covers(b, c, p) && Covers(c, a, p))
+                {
+                    result.faces.push_back(PackFace(axis, negative, frontFacing, plane, (u - 1) / 2, (v - 1) / 2));
+                }
+            }
+        }
+    }
+
+    std::sort(result.faces.begin(), result.faces.end());
+    return result;
+}
+
+std::string DescribeFace(uint64_t face)
+{
+    static const char AXES[3] = {'x', 'y', 'z'};
+    const int axis = (int)(face >> 62);
+    const bool negative = (face >> 61) & 1;
+    const bool frontFacing = (face >> 60) & 1;
+    std::ostringstream out;
+    out << (negative ? '-' : '+') << AXES[axis] << " face at " << AXES[axis] << "="
+        << UnpackCoordinate(face, 2 * COORDINATE_BITS) << " cell ("
+        << UnpackCoordinate(face, COORDINATE_BITS) << ", " << UnpackCoordinate(face, 0) << ")"
+        << (frontFacing ? "" : " wound against its normal");
+    return out.str();
+}
+
+namespace
+{
+    // Quads of 4 consecutive vertices that cover a single unit face, keyed by their lowest corner
+    // and normal. Both meshers emit faces that way
+    std::map<std::array<int, 6>, const GLfloat *> MapUnitQuads(const std::vector<GLfloat> &vertices)
+    {
+        std::map<std::array<int, 6>, const GLfloat *> quads;
+        const size_t QUAD_FLOATS = 4 * Voxel::VERTEX_FLOATS;
+        for (size_t first = 0; first + QUAD_FLOATS <= vertices.size(); first += QUAD_FLOATS)
+        {
+            const GLfloat *quad = &vertices[first];
+            glm::vec3 low(quad[0], quad[1], quad[2]), high = low;
+            for (int corner = 1; corner < 4; corner++)
+            {
+                const glm::vec3 position(quad[corner * Voxel::VERTEX_FLOATS], quad[corner * Voxel::VERTEX_FLOATS + 1],
+                                         quad[corner * Voxel::VERTEX_FLOATS + 2]);
+                low = glm::min(low, position);
+                high = glm::max(high, position);
+            }
+            const glm::vec3 extent = high - low;
+            if (extent.x + extent.y + extent.z != 2.0f || glm::max(extent.x, glm::max(extent.y, extent.z)) != 1.0f)
+            {
+                continue;
+            }
+            quads[{(int)low.x, (int)low.y, (int)low.z, (int)quad[5], (int)quad[6], (int)quad[7]}] = quad;
+        }
+        return quads;
+    }
+
+    // Light must match, occlusion must match corner by corner
+    bool ShadingMatches(const GLfloat *reference, const GLfloat *tested)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            const GLfloat *vertex = tested + i * Voxel::VERTEX_FLOATS;
+            bool found = false;
+            for (int j = 0; j < 4 && !found; j++)
+            {
+                const GLfloat *match = reference + j * Voxel::VERTEX_FLOATS;
+                if (match[0] == vertex[0] && match[1] == vertex[1] && match[2] == vertex[2])
+                {
+                    found = true;
+                    if (match[8] != vertex[8] || match[9] != vertex[9] || match[10] != vertex[10])
+                    {
+                        return false;
+                    }
+                }
+            }
+            if (!found)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+MeshDiff CompareWithReference(Chunk &chunk, const Mesher &mesher)
+{
+    MeshDiff diff;
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+
+    GetMeshers().front().build(chunk, vertices, indices);
+    const FaceSet reference = RasterizeFaces(vertices, indices);
+    if (!reference.error.empty())
+    {
+        diff.error = "reference: " + reference.error;
+        return diff;
+    }
+
+    const std::vector<GLfloat> referenceVertices = vertices;
+
+    mesher.build(chunk, vertices, indices);
+    const FaceSet tested = RasterizeFaces(vertices, indices);
+    if (!tested.error.empty())
+    {
+        diff.error = tested.error;
+        return diff;
+    }
+    diff.referenceFaces = reference.faces.size();
+    diff.testedFaces = tested.faces.size();
+
+    // Both sets are sorted, walk them together. Faces covered twice show up as extra
+    size_t i = 0, j = 0;
+    while (i < reference.faces.size() || j < tested.faces.size())
+    {
+        if (j == tested.faces.size() || (i < reference.faces.size() && reference.faces[i] < tested.faces[j]))
+        {
+            if (diff.firstDifference.empty())
+            {
+                diff.firstDifference = "missing " + DescribeFace(reference.faces[i]);
+            }
+            diff.missing++;
+            i++;
+        }
+        else if (i == reference.faces.size() || tested.faces[j] < reference.faces[i])
+        {
+            if (diff.firstDifference.empty())
+            {
+                diff.firstDifference = "extra " + DescribeFace(tested.faces[j]);
+            }
+            diff.extra++;
+            j++;
+        }
+        else
+        {
+            i++;
+            j++;
+        }
+    }
+
+    const std::map<std::array<int, 6>, const GLfloat *> referenceQuads = MapUnitQuads(referenceVertices);
+    for (const auto &quad : MapUnitQuads(vertices))
+    {
+        const auto match = referenceQuads.find(quad.first);
+        if (match == referenceQuads.end() || ShadingMatches(match->second, quad.second))
+        {
+            continue;
+        }
+        if (diff.firstDifference.empty())
+        {
+            diff.firstDifference = "different light or occlusion on the face at (" + std::to_string(quad.first[0]) + ", " +
+                                   std::to_string(quad.first[1]) + ", " + std::to_string(quad.first[2]) + ")";
+        }
+        diff.shadingMismatches++;
+    }
+    return diff;
+}
+
+const char *GetPatternName(ChunkPattern pattern)
+{
+    static const char *NAMES[PATTERN_COUNT] = {
+        "empty", "full", "random", "checkerboard", "single", "columns", "slabs", "shell", "borders", "terrain"};
+    return pattern < PATTERN_COUNT ? NAMES[pattern] : "bytes";
+}
+
+MeshTestWorld::MeshTestWorld()
+{
+    const siv::PerlinNoise perlin{ChunkManager::SEED};
+    for (int i = 0; i < 5; ++i)
+    {
+        m_chunks[i].reset(new Chunk(perlin, CHUNK_X[i], CHUNK_Z[i]));
+        m_patterns[i] = PATTERN_TERRAIN;
+    }
+    // Keep the generated terrain so the terrain pattern can be restored after other fills
+    for (int i = 0; i < 5; ++i)
+    {
+        m_terrain[i].resize(CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE);
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+        {
+            for (int y = 0; y < CHUNK_SIZE; ++y)
+            {
+                for (int z = 0; z < CHUNK_SIZE; ++z)
+                {
+                    m_terrain[i][(x * CHUNK_SIZE + y) * CHUNK_SIZE + z] = m_chunks[i]->GetVoxel(x, y, z)->IsActive();
+                }
+            }
+        }
+    }
+    Reset(0xF);
+}
+
+void MeshTestWorld::Generate(const ChunkPattern patterns[5], int neighborMask, std::mt19937 &random)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        m_patterns[i] = patterns[i];
+        Fill(i, patterns[i], random);
+    }
+    Reset(neighborMask);
+}
+
+void MeshTestWorld::GenerateRandom(std::mt19937 &random)
+{
+    ChunkPattern patterns[5];
+    for (int i = 0; i < 5; ++i)
+    {
+        patterns[i] = (ChunkPattern)(random() % PATTERN_COUNT);
+    }
+    Generate(patterns, random() % 16, random);
+}
+
+void MeshTestWorld::FillFromBytes(const uint8_t *data, size_t size)
+{
+    const int neighborMask = size > 0 ? data[0] & 0xF : 0;
+    size_t bit = 0;
+    const size_t bitCount = size > 1 ? (size - 1) * 8 : 0;
+    for (int i = 0; i < 5; ++i)
+    {
+        m_patterns[i] = PATTERN_COUNT;
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+        {
+            for (int y = 0; y < CHUNK_SIZE; ++y)
+            {
+                for (int z = 0; z < CHUNK_SIZE; ++z)
+                {
+                    bool active = false;
+                    if (bitCount > 0)
+                    {
+                        const size_t index = bit++ % bitCount;
+                        active = (data[1 + index / 8] >> (index % 8)) & 1;
+                    }
+                    m_chunks[i]->GetVoxel(x, y, z)->SetActive(active);
+                }
+            }
+        }
+        m_chunks[i]->RebuildColumns();
+    }
+    Reset(neighborMask);
+}
+
+Chunk &MeshTestWorld::GetCenter()
+{
+    return *m_chunks[0];
+}
+
+void MeshTestWorld::CompressAll()
+{
+    for (std::unique_ptr<Chunk> &chunk : m_chunks)
+    {
+        chunk->Compress();
+    }
+}
+
+int MeshTestWorld::CountCompressed() const
+{
+    int count = 0;
+    for (const std::unique_ptr<Chunk> &chunk : m_chunks)
+    {
+        count += chunk->IsCompressed();
+    }
+    return count;
+}
+
+std::string MeshTestWorld::Describe() const
+{
+    static const char *SIDES[5] = {"center", "right", "left", "back", "front"};
+    std::ostringstream out;
+    for (int i = 0; i < 5; ++i)
+    {
+        const bool linked = i == 0 || (m_neighborMask & (1 << (i - 1))) != 0;
+        out << (i > 0 ? " " : "") << SIDES[i] << "=" << (linked ? GetPatternName(m_patterns[i]) : "none");
+    }
+    return out.str();
+}
+
+void MeshTestWorld::Reset(int neighborMask)
+{
+    m_neighborMask = neighborMask;
+    Chunk &center = *m_chunks[0];
+    center.SetRightNeighbor(neighborMask & NEIGHBOR_RIGHT ? m_chunks[1].get() : nullptr);
+    center.SetLeftNeighbor(neighborMask & NEIGHBOR_LEFT ? m_chunks[2].get() : nullptr);
+    center.SetBackNeighbor(neighborMask & NEIGHBOR_BACK ? m_chunks[3].get() : nullptr);
+    center.SetFrontNeighbor(neighborMask & NEIGHBOR_FRONT ? m_chunks[4].get() : nullptr);
+}
+
+void MeshTestWorld::Fill(int chunkIndex, ChunkPattern pattern, std::mt19937 &random)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const float density = 0.05f + 0.9f * unit(random);
+    const int parity = random() % 2;
+    const int slabAxis = random() % 3;
+    const unsigned int slabBits = random();
+    // The single voxel sits on the chunk border on about half of the axes
+    int single[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        single[axis] = random() % 2 ? (random() % 2) * (CHUNK_SIZE - 1) : random() % CHUNK_SIZE;
+    }
+    int heights[CHUNK_SIZE][CHUNK_SIZE];
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int z = 0; z < CHUNK_SIZE; ++z)
+        {
+            heights[x][z] = random() % (CHUNK_SIZE + 1);
+        }
+    }
+
+    Chunk &chunk = *m_chunks[chunkIndex];
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        {
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+            {
+                const bool onBorder = x == 0 || z == 0 || x == CHUNK_SIZE - 1 || z == CHUNK_SIZE - 1;
+                const int coordinates[3] = {x, y, z};
+                bool active = false;
+                switch (pattern)
+                {
+                case PATTERN_EMPTY:
+                    break;
+                case PATTERN_FULL:
+                    active = true;
+                    break;
+                case PATTERN_RANDOM:
+                    active = unit(random) < density;
+                    break;
+                case PATTERN_CHECKERBOARD:
+                    active = (x + y + z + parity) % 2 == 0;
+                    break;
+                case PATTERN_SINGLE:
+                    active = x == single[0] && y == single[1] && z == single[2];
+                    break;
+                case PATTERN_COLUMNS:
+                    active = y < heights[x][z];
+                    break;
+                case PATTERN_SLABS:
+                    active = (slabBits >> coordinates[slabAxis]) & 1;
+                    break;
+                case PATTERN_SHELL:
+                    active = onBorder || y == 0 || y == CHUNK_SIZE - 1;
+                    break;
+                case PATTERN_BORDERS:
+                    active = onBorder && unit(random) < density;
+                    break;
+                default:
+                    active = m_terrain[chunkIndex][(x * CHUNK_SIZE + y) * CHUNK_SIZE + z];
+                    break;
+                }
+                chunk.GetVoxel(x, y, z)->SetActive(active);
+            }
+        }
+    }
+    chunk.RebuildColumns();
+}
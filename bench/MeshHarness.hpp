@@ -0,0 +1,116 @@
+#ifndef MESHHARNESS_HPP
+#define MESHHARNESS_HPP
+
+#include "Chunk.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Differential checks of the chunk meshers against the reference mesher (Chunk::GetVertexData).
+// Meshes are compared by the unit faces they cover, not by vertex order, so meshers that merge,
+// reorder or pack faces differently still compare equal as long as they draw the same surface.
+
+// A mesher under test. Vertices use the Voxel::VERTEX_FLOATS layout, indices start at 0
+struct Mesher
+{
+    const char *name;
+    void (*build)(Chunk &chunk, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices);
+};
+
+// Every registered mesher, the reference first
+const std::vector<Mesher> &GetMeshers();
+
+// The unit faces covered by a mesh, sorted. Each key holds the axis, normal direction, winding,
+// plane and cell of one unit face. Error is set when the mesh is malformed (bad index, triangle
+// off the voxel grid, normal not matching the triangle's plane)
+struct FaceSet
+{
+    std::vector<uint64_t> faces;
+    std::string error;
+};
+
+FaceSet RasterizeFaces(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices);
+std::string DescribeFace(uint64_t face);
+
+// Result of one mesher against the reference on one chunk
+struct MeshDiff
+{
+    size_t referenceFaces = 0;
+    size_t testedFaces = 0;
+    // Faces the reference covers and the mesher does not, and the other way around
+    size_t missing = 0;
+    size_t extra = 0;
+    // Unit faces whose baked light or corner occlusion differs from the reference face at the same
+    // place. Merged faces have no reference counterpart and are not compared
+    size_t shadingMismatches = 0;
+    std::string firstDifference;
+    std::string error;
+
+    bool Matches() const { return error.empty() && missing == 0 && extra == 0 && shadingMismatches == 0; }
+};
+
+MeshDiff CompareWithReference(Chunk &chunk, const Mesher &mesher);
+
+// Contents used to fill a test chunk
+enum ChunkPattern
+{
+    PATTERN_EMPTY,
+    PATTERN_FULL,
+    PATTERN_RANDOM,       // Independent voxels at a random density
+    PATTERN_CHECKERBOARD, // Worst case: every face of every solid voxel is exposed
+    PATTERN_SINGLE,       // One voxel, often on a border
+    PATTERN_COLUMNS,
+    PATTERN_SLABS,
+    PATTERN_SHELL, // Only the outer layer, all interior faces hidden
+    PATTERN_BORDERS,
+    PATTERN_TERRAIN, // The generated terrain itself
+    PATTERN_COUNT
+};
+
+const char *GetPatternName(ChunkPattern pattern);
+
+// A center chunk and its four neighbors, each of which can be linked or left out
+class MeshTestWorld
+{
+public:
+    // Neighbor bits for the link mask
+    static const int NEIGHBOR_RIGHT = 1; // x - 1
+    static const int NEIGHBOR_LEFT = 2;  // x + 1
+    static const int NEIGHBOR_BACK = 4;  // z - 1
+    static const int NEIGHBOR_FRONT = 8; // z + 1
+
+    MeshTestWorld();
+
+    // Methods
+    // Fill every chunk with a pattern and link the neighbors in the mask
+    void Generate(const ChunkPattern patterns[5], int neighborMask, std::mt19937 &random);
+    // Random patterns and a random neighbor mask
+    void GenerateRandom(std::mt19937 &random);
+    // Fuzzer input: first byte is the neighbor mask, the remaining bytes are read cyclically as
+    // occupancy bits for the center chunk followed by the neighbors
+    void FillFromBytes(const uint8_t *data, size_t size);
+    Chunk &GetCenter();
+    // Move every chunk to the compressed tier, meshing the center then reads packed neighbors
+    void CompressAll();
+    // Chunks of the world in the compressed tier
+    int CountCompressed() const;
+    std::string Describe() const;
+
+private:
+    // Methods
+    void Reset(int neighborMask);
+    void Fill(int chunkIndex, ChunkPattern pattern, std::mt19937 &random);
+
+    // Member Variables
+    // Center first, then right, left, back, front
+    std::unique_ptr<Chunk> m_chunks[5];
+    ChunkPattern m_patterns[5];
+    // Occupancy of the generated terrain, restored by PATTERN_TERRAIN
+    std::vector<bool> m_terrain[5];
+    int m_neighborMask;
+};
+
+#endif /* MESHHARNESS_HPP */
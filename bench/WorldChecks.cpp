@@ -0,0 +1,154 @@
+#include "WorldChecks.hpp"
+#include "LightEngine.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+void FloodReferenceLight(ChunkManager &chunkManager, std::vector<uint8_t> &light)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    const int window = chunkManager.GetWindowSize();
+    const int blocks = window * size;
+    const int VOXELS = size * size * size;
+    auto index = [&](int x, int y, int z)
+    { return (x * size + y) * blocks + z; };
+    std::vector<uint8_t> solid(blocks * size * blocks), emission(solid.size());
+    std::vector<uint8_t> occupancy(VOXELS);
+    for (int slot = 0; slot < chunkManager.GetChunkCount(); ++slot)
+    {
+        Chunk *chunk = chunkManager.GetChunk(slot);
+        const int chunkX = slot / window;
+        const int chunkZ = slot % window;
+        chunk->CopyOccupancy(occupancy.data());
+        for (int i = 0; i < VOXELS; ++i)
+        {
+            const int x = i / (size * size), y = (i / size) % size, z = i % size;
+            solid[index(chunkX * size + x, y, chunkZ * size + z)] = occupancy[i];
+            emission[index(chunkX * size + x, y, chunkZ * size + z)] = chunk->GetEmission(x, y, z);
+        }
+    }
+
+    light.assign(solid.size(), 0);
+    for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; ++channel)
+    {
+        const int shift = channel == LIGHT_SKY ? 4 : 0;
+        std::vector<glm::ivec3> queue;
+        for (int x = 0; x < blocks; ++x)
+        {
+            for (int z = 0; z < blocks; ++z)
+            {
+                for (int y = size - 1; y >= 0; --y)
+                {
+                    if (channel == LIGHT_SKY && solid[index(x, y, z)])
+                    {
+                        break;
+                    }
+                    const int level = channel == LIGHT_SKY ? Voxel::MAX_LIGHT : emission[index(x, y, z)];
+                    if (level > 0)
+                    {
+                        light[index(x, y, z)] |= level << shift;
+                        queue.push_back(glm::ivec3(x, y, z));
+                    }
+                }
+            }
+        }
+        const glm::ivec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+        for (size_t i = 0; i < queue.size(); ++i)
+        {
+            const glm::ivec3 voxel = queue[i];
+            const int level = (light[index(voxel.x, voxel.y, voxel.z)] >> shift) & 15;
+            for (int direction = 0; direction < 6; ++direction)
+            {
+                const glm::ivec3 next = voxel + directions[direction];
+                if (next.x < 0 || next.x >= blocks || next.y < 0 || next.y >= size || next.z < 0 ||
+                    next.z >= blocks || solid[index(next.x, next.y, next.z)])
+                {
+                    continue;
+                }
+                const int spread = (channel == LIGHT_SKY && direction == 3 && level == Voxel::MAX_LIGHT) ? level : level - 1;
+                uint8_t &target = light[index(next.x, next.y, next.z)];
+                if (((target >> shift) & 15) < spread)
+                {
+                    target = (uint8_t)((target & ~(15 << shift)) | (spread << shift));
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+int CountLightMismatches(ChunkManager &chunkManager)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    const int window = chunkManager.GetWindowSize();
+    std::vector<uint8_t> reference;
+    FloodReferenceLight(chunkManager, reference);
+    int mismatches = 0;
+    for (int slot = 0; slot < chunkManager.GetChunkCount(); ++slot)
+    {
+        Chunk *chunk = chunkManager.GetChunk(slot);
+        const int chunkX = slot / window;
+        const int chunkZ = slot % window;
+        for (int x = 0; x < size; ++x)
+        {
+            for (int y = 0; y < size; ++y)
+            {
+                for (int z = 0; z < size; ++z)
+                {
+                    const uint8_t expected = reference[((chunkX * size + x) * size + y) * window * size + chunkZ * size + z];
+                    if (chunk->GetLight(x, y, z) != expected)
+                    {
+                        if (mismatches == 0)
+                        {
+                            std::cerr << "lighting: voxel " << chunkX * size + x << ", " << y << ", " << chunkZ * size + z
+                                      << " has light " << (int)chunk->GetLight(x, y, z) << ", expected " << (int)expected << std::endl;
+                        }
+                        mismatches++;
+                    }
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+std::vector<uint16_t> SnapshotColumns(ChunkManager &chunkManager)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    std::vector<uint16_t> masks;
+    masks.reserve(chunkManager.GetChunkCount() * size * size);
+    for (int slot = 0; slot < chunkManager.GetChunkCount(); ++slot)
+    {
+        Chunk *chunk = chunkManager.GetChunk(slot);
+        for (int column = 0; column < size * size; ++column)
+        {
+            masks.push_back(chunk->GetColumnMask(column / size, column % size));
+        }
+    }
+    return masks;
+}
+
+int CountColumnMismatches(const std::vector<uint16_t> &actual, const std::vector<uint16_t> &expected, const std::string &context)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    if (actual.size() != expected.size())
+    {
+        std::cerr << context << ": " << actual.size() << " columns, expected " << expected.size() << std::endl;
+        return (int)std::max(actual.size(), expected.size());
+    }
+    int mismatches = 0;
+    for (size_t i = 0; i < actual.size(); ++i)
+    {
+        if (actual[i] != expected[i])
+        {
+            if (mismatches == 0)
+            {
+                const int slot = (int)(i / (size * size)), column = (int)(i % (size * size));
+                std::cerr << context << ": column " << column / size << ", " << column % size << " of chunk slot " << slot
+                          << " has mask " << actual[i] << ", expected " << expected[i] << std::endl;
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
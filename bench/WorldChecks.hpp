@@ -0,0 +1,24 @@
+#ifndef WORLDCHECKS_HPP
+#define WORLDCHECKS_HPP
+
+#include "ChunkManager.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Reference checks of a loaded window shared by the scenarios that edit it. Slots are read in
+// GetChunk order, so the window is expected at its starting origin
+
+// Light of the whole window flooded from scratch, x, y, z order like the chunks. Same rules as
+// LightEngine: sky light falls straight down at full strength, everything else dims per voxel
+void FloodReferenceLight(ChunkManager &chunkManager, std::vector<uint8_t> &light);
+// Voxels whose light differs from the reference flood, the first is printed to stderr
+int CountLightMismatches(ChunkManager &chunkManager);
+
+// Column masks of every chunk of the window, slot by slot
+std::vector<uint16_t> SnapshotColumns(ChunkManager &chunkManager);
+// Columns that differ between two snapshots, the first is printed to stderr after the context
+int CountColumnMismatches(const std::vector<uint16_t> &actual, const std::vector<uint16_t> &expected, const std::string &context);
+
+#endif /* WORLDCHECKS_HPP */
@@ -0,0 +1,102 @@
+// Fuzz target for the chunk meshers, see MeshTestWorld::FillFromBytes for the input layout.
+// Built by "python3 build.py fuzz": with clang it is a libFuzzer target, otherwise
+// MESHER_FUZZ_STANDALONE adds a main that replays input files or random inputs.
+#include "MeshHarness.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static MeshTestWorld world;
+    world.FillFromBytes(data, size);
+    const std::vector<Mesher> &meshers = GetMeshers();
+    for (size_t m = 1; m < meshers.size(); ++m)
+    {
+        const MeshDiff diff = CompareWithReference(world.GetCenter(), meshers[m]);
+        if (!diff.Matches())
+        {
+            std::cerr << meshers[m].name << " differs from the reference: "
+                      << (diff.error.empty() ? diff.firstDifference : diff.error) << " ("
+                      << diff.missing << " missing, " << diff.extra << " extra, "
+                      << diff.shadingMismatches << " shaded differently)\n";
+            std::abort();
+        }
+    }
+
+    // The compressed tier must give back the same voxels, seen by the chunk and its neighbor
+    std::vector<GLfloat> vertices;
+    std::vector<GLuint> indices;
+    world.GetCenter().BuildMesh(vertices, indices);
+    const std::vector<uint64_t> resident = RasterizeFaces(vertices, indices).faces;
+    world.CompressAll();
+    world.GetCenter().BuildMesh(vertices, indices);
+    if (RasterizeFaces(vertices, indices).faces != resident)
+    {
+        std::cerr << "mesh differs after compressing the chunks\n";
+        std::abort();
+    }
+    return 0;
+}
+
+#ifdef MESHER_FUZZ_STANDALONE
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+// usage: mesher-fuzz [--runs n] [--seed n] [file]...
+int main(int argc, char **argv)
+{
+    int runs = 1000;
+    unsigned int seed = 1234u;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+        {
+            runs = std::atoi(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            seed = (unsigned int)std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            files.push_back(arg);
+        }
+    }
+
+    for (const std::string &path : files)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Could not open " << path << "\n";
+            return 1;
+        }
+        const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    if (!files.empty())
+    {
+        return 0;
+    }
+
+    // Random inputs of random length, short ones repeat their bits across the chunks
+    std::mt19937 random(seed);
+    std::vector<uint8_t> data;
+    for (int run = 0; run < runs; ++run)
+    {
+        data.resize(random() % 4096);
+        for (uint8_t &byte : data)
+        {
+            byte = (uint8_t)random();
+        }
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+    std::cerr << runs << " random inputs matched the reference\n";
+    return 0;
+}
+#endif
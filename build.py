@@ -1,6 +1,20 @@
-# Run with: python3 build.py
+# Run with: python3 build.py          (builds the engine)
+#       or: python3 build.py bench    (builds the headless voxel-bench, no SDL/GL needed)
+#       or: python3 build.py fuzz     (builds the mesher fuzz target, libFuzzer when clang++ exists)
+# Add "notrace" to either to compile the TRACE_SCOPE instrumentation out entirely.
+import glob
 import os
 import platform
+import shutil
+import sys
+
+# Which target to build: "engine" (default), "bench" or "fuzz"
+TARGETS = [arg for arg in sys.argv[1:] if arg!="notrace"]
+TARGET = TARGETS[0] if len(TARGETS) > 0 else "engine"
+TRACING = "notrace" not in sys.argv[1:]
+if TARGET not in ("engine", "bench", "fuzz"):
+    print("Unknown target '"+TARGET+"', expected 'engine', 'bench' or 'fuzz'")
+    exit(1)
 
 # (1)==================== COMMON CONFIGURATION OPTIONS ======================= #
 COMPILER="g++ -std=c++17"   # The compiler we want to use 
@@ -29,6 +43,44 @@ elif platform.system()=="Windows":
     LIBRARIES="-lmingw32 -lSDL2main -lSDL2 -mwindows -mconsole"
 # (2)=================== Platform specific configuration ===================== #
 
+# Scoped tracing is on by default, see include/Trace.hpp
+if TRACING:
+    ARGUMENTS=ARGUMENTS+" -D ENABLE_TRACING"
+
+# (2b)====================== Benchmark configuration ========================== #
+# The benchmark links everything except main.cpp (the only file that needs SDL)
+# plus the scenarios in ./bench, and is always built with optimizations.
+if TARGET=="bench":
+    engineSources=[f for f in sorted(glob.glob("./src/*.cpp")) if os.path.basename(f)!="main.cpp"]
+    SOURCE=" ".join(engineSources+sorted(glob.glob("./bench/*.cpp")))
+    EXECUTABLE="voxel-bench"
+    ARGUMENTS=ARGUMENTS+" -O2"
+    INCLUDE_DIR=INCLUDE_DIR+" -I./bench/"
+    if platform.system()=="Linux":
+        LIBRARIES="-ldl -lpthread"
+    elif platform.system()=="Darwin":
+        LIBRARIES=""
+    elif platform.system()=="Windows":
+        EXECUTABLE="voxel-bench.exe"
+        LIBRARIES=""
+# (2b)====================== Benchmark configuration ========================== #
+
+# (2c)========================= Fuzz configuration ============================ #
+# The mesher fuzz target links the engine (minus main.cpp), the mesh harness and
+# ./bench/fuzz. Without clang++ it falls back to a standalone random input driver.
+if TARGET=="fuzz":
+    engineSources=[f for f in sorted(glob.glob("./src/*.cpp")) if os.path.basename(f)!="main.cpp"]
+    SOURCE=" ".join(engineSources+["./bench/MeshHarness.cpp"]+sorted(glob.glob("./bench/fuzz/*.cpp")))
+    EXECUTABLE="mesher-fuzz"
+    INCLUDE_DIR=INCLUDE_DIR+" -I./bench/"
+    LIBRARIES="-ldl -lpthread" if platform.system()=="Linux" else ""
+    if shutil.which("clang++") is not None:
+        COMPILER="clang++ -std=c++17"
+        ARGUMENTS=ARGUMENTS+" -g -O1 -fsanitize=fuzzer,address,undefined"
+    else:
+        ARGUMENTS=ARGUMENTS+" -g -O1 -D MESHER_FUZZ_STANDALONE -fsanitize=address,undefined"
+# (2c)========================= Fuzz configuration ============================ #
+
 # (3)====================== Building the Executable ========================== #
 # Build a string of our compile commands that we run in the terminal
 compileString=COMPILER+" "+ARGUMENTS+" -o "+EXECUTABLE+" "+" "+INCLUDE_DIR+" "+SOURCE+" "+LIBRARIES
@@ -0,0 +1,13 @@
+#ifndef AABB_HPP
+#define AABB_HPP
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box in world space
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+#endif /* AABB_HPP */
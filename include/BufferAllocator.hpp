@@ -0,0 +1,64 @@
+#ifndef BUFFERALLOCATOR_HPP
+#define BUFFERALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// Free list sub-allocator for a linear range of elements (vertices, indices, bytes...).
+// It only does the bookkeeping so it has no dependency on OpenGL; the owner of the real
+// buffer copies the data when Defragment() moves blocks or Grow() extends the range.
+class BufferAllocator
+{
+public:
+    static const uint32_t INVALID_OFFSET = 0xFFFFFFFFu;
+
+    // One block that has to be copied from one offset to another
+    struct Move
+    {
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+
+    // Constructor
+    explicit BufferAllocator(uint32_t capacity = 0);
+
+    // Methods
+    // Best fit allocation, returns INVALID_OFFSET when no free block is large enough
+    uint32_t Allocate(uint32_t size);
+    void Free(uint32_t offset);
+    // Extend the managed range, existing allocations keep their offsets
+    void Grow(uint32_t newCapacity);
+    // Pack every allocation to the front of the range. The returned moves are ordered by
+    // offset and describe where each live block ends up (blocks that stay put are included)
+    std::vector<Move> Defragment();
+    void Clear();
+
+    // Getters
+    // 0 when all free space is one block, approaching 1 as it gets split into small holes
+    float GetFragmentation() const;
+    uint32_t GetCapacity() const;
+    uint32_t GetUsed() const;
+    uint32_t GetLargestFreeBlock() const;
+    uint32_t GetAllocationSize(uint32_t offset) const;
+    size_t GetAllocationCount() const;
+    size_t GetFreeBlockCount() const;
+
+private:
+    // Methods
+    void InsertFreeBlock(uint32_t offset, uint32_t size);
+    void EraseFreeBlock(std::map<uint32_t, uint32_t>::iterator block);
+
+    // Member Variables
+    uint32_t m_capacity;
+    uint32_t m_used;
+    // Live allocations, offset -> size
+    std::map<uint32_t, uint32_t> m_allocations;
+    // Free blocks indexed both ways: offset -> size for coalescing, size -> offset for best fit
+    std::map<uint32_t, uint32_t> m_freeByOffset;
+    std::multimap<uint32_t, uint32_t> m_freeBySize;
+};
+
+#endif /* BUFFERALLOCATOR_HPP */
@@ -29,6 +29,12 @@ public:
     void MoveDown(float speed);
     // Set the position for the camera
     void SetCameraEyePosition(float x, float y, float z);
+    // Set the direction the camera looks in (used when replaying recorded paths)
+    void SetViewDirection(const glm::vec3 &direction);
+    // Returns the world space position of the eye
+    glm::vec3 GetEyePosition() const;
+    // Returns the 'view' direction
+    glm::vec3 GetViewDirection() const;
     // Returns the Camera X Position where the eye is 
     float GetEyeXPosition();
     // Returns the Camera Y Position where the eye is 
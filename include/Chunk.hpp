@@ -1,26 +1,115 @@
 #ifndef CHUNK_HPP // include guard
 #define CHUNK_HPP
 
+#include <cstdint>
+#include <utility>
 #include <vector>
 #include <glad/glad.h>
 #include "PerlinNoise.hpp"
 #include "Voxel.hpp"
+#include "AABB.hpp"
 class Chunk
 {
 public:
     // Constructors/Destructor
     Chunk();
     Chunk(const siv::PerlinNoise perlin, int xOffset, int zOffset);
+    // Solid chunk at the chunk coordinates, for callers that fill in the voxels themselves
+    Chunk(int xOffset, int zOffset);
     ~Chunk();
+    // Chunks are owned by pointer, copying would also double count their memory
+    Chunk(const Chunk &) = delete;
+    Chunk &operator=(const Chunk &) = delete;
 
     // Constants
     static const int CHUNK_SIZE = 16;
+    // Column mask of a column solid all the way up
+    static const uint16_t FULL_COLUMN = (uint16_t)((1u << CHUNK_SIZE) - 1);
+    // Bump whenever BuildMesh or BuildLodMesh would produce different output for the same chunks,
+    // cached meshes of older versions are dropped
+    static const int MESHER_VERSION = 1;
 
     // Methods
+    // Reference mesher, one cube at a time. Kept as the ground truth the faster meshers are checked against
     const std::vector<GLfloat> GetVertexData(int xOffset, int zOffset, std::vector<GLuint> &indices, GLuint &baseIndex);
+    // Same faces as GetVertexData from a padded copy of the chunk and its neighbors' borders, indices start at 0.
+    // The neighbors on the sides set in skirtSides (bit 0 -x, 1 +x, 2 -z, 3 +z) count as empty, so the
+    // border faces there are kept as skirts over the seam to a neighbor meshed at another level of detail.
+    // Read from the column masks and the light, so neither the chunk nor its neighbors are decompressed
+    void BuildMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices, int skirtSides = 0);
+    // Coarse mesh for distant chunks, one cube per cell of 2^level voxels a side. A cell is solid when
+    // at least half of its voxels are, faces take the brightest light of the cell in front. Read from
+    // the column masks and the light, so compressed chunks stay compressed. Same skirts as BuildMesh
+    void BuildLodMesh(int level, int skirtSides, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices);
+    // Key of the mesh BuildMesh (level 0) or BuildLodMesh would build: a hash of the mesher version,
+    // the chunk's position, its column masks and light, and the border columns of the neighbors the
+    // mesher reads. Never decompresses
+    uint64_t HashMeshInputs(int level, int skirtSides);
+    // Decompresses a compressed chunk first
     Voxel *GetVoxel(int x, int y, int z);
     void UpdateBlock(int x, int y, int z, bool isActive);
+    // Occupancy of every voxel in x, y, z order (CHUNK_SIZE^3 bytes), read without decompressing
+    void CopyOccupancy(uint8_t *solid);
     bool IsInBounds(float x, float y, float z);
+    // Tight world space bounds of the active voxels
+    const AABB &GetBounds();
+    // Conservative solid boxes used as occluders by the culling pass
+    const std::vector<AABB> &GetOccluders();
+    // Bytes held by the voxel storage
+    size_t GetVoxelBytes() const;
+
+    // Cold chunks keep only their occupancy, run length encoded along the y columns and LZ packed.
+    // Every voxel access decompresses the chunk again, bounds and occluders stay available
+    void Compress();
+    bool IsCompressed() const;
+    // Whether the voxels were accessed since the last call
+    bool TakeAccessed();
+
+    // Light at a local position, sky light in the high nibble and block light in the low one.
+    // Light stays resident while the chunk is compressed, LightEngine keeps it up to date
+    uint8_t GetLight(int x, int y, int z) const;
+    void SetLight(int x, int y, int z, uint8_t light);
+    // Light of every voxel in x, y, z order (CHUNK_SIZE^3 bytes)
+    const uint8_t *GetLightData() const;
+    // Dark everywhere, as a chunk is until LightEngine lights it
+    void ClearLight();
+    bool HasLight() const;
+    uint64_t HashLight() const;
+    // Read from the column masks, never decompresses
+    bool IsSolid(int x, int y, int z) const;
+    // Block light emitted by the voxel at a local position, 0 unless it is a light source
+    int GetEmission(int x, int y, int z) const;
+    void SetEmission(int x, int y, int z, int level);
+    // Every light source, voxel index (x, y, z order) and level
+    const std::vector<std::pair<uint16_t, uint8_t>> &GetEmitters() const;
+    glm::ivec2 GetCoordinates() const;
+
+    // Per column index of the occupancy, x, z local coordinates. Filled by the generator, patched by
+    // UpdateBlock in constant time and kept while the chunk is compressed
+    // Highest solid voxel plus one, 0 for an empty column
+    int GetColumnHeight(int x, int z) const;
+    // Bit y is set when the voxel at height y is solid
+    uint16_t GetColumnMask(int x, int z) const;
+    // Call after writing voxels directly through GetVoxel
+    void RebuildColumns();
+    // Set the occupancy of every column at once, masks by x * CHUNK_SIZE + z. Only the voxels that
+    // flip are written and changed receives their bits per column. Light sources in voxels that
+    // became solid are put out, a chunk left all solid or all empty is packed like Fill. Returns
+    // how many voxels flipped
+    int SetColumnMasks(const uint16_t *masks, uint16_t *changed);
+    // Make every voxel solid or empty without visiting them: the voxel storage is replaced by the
+    // compressed form of a uniform chunk and the column index, bounds and occluders are set
+    // directly. changed receives the flipped bits like SetColumnMasks. Returns how many voxels flipped
+    int Fill(bool active, uint16_t *changed);
+    // Every voxel solid or every voxel empty
+    bool IsUniform() const;
+    // Height the generator gives the column at a world position (highest solid voxel plus one, 0
+    // for an empty column) without generating the chunk
+    static int GetTerrainHeight(const siv::PerlinNoise &perlin, int x, int z);
+    // Atlas rectangle (u0, v0, u1, v1) of the terrain blocks' texture
+    static glm::vec4 GetTerrainTextureBounds();
+    // Linked neighbor one chunk away along x or z, null on the edge of the loaded window
+    Chunk *GetNeighbor(int offsetX, int offsetZ);
 
     // Setters
     void SetFrontNeighbor(Chunk *chunk);
@@ -32,7 +121,21 @@ private:
     // Methods
     std::vector<GLfloat> GenerateCubeVertices(int x, int y, int z, std::vector<GLuint> &indices, GLuint &baseIndex);
     bool HasNeighborOnFace(int x, int y, int z, int offsetX, int offsetY, int offsetZ);
-    void AddFace(std::vector<GLuint> &indices, GLuint &baseIndex);
+    // Light of the voxel a face looks into, full sky light outside the loaded chunks
+    uint8_t GetFaceLight(int x, int y, int z, int offsetX, int offsetY, int offsetZ);
+    // Flipped faces are split along the other diagonal
+    void AddFace(std::vector<GLuint> &indices, GLuint &baseIndex, bool flip);
+    // Bake light and ambient occlusion into the face just appended, returns whether to flip it
+    bool ShadeFace(std::vector<GLfloat> &vertices, int x, int y, int z, int face);
+    // Solid voxel at a local position that may be in a neighbor chunk, diagonal ones included
+    bool IsSolidAt(int x, int y, int z);
+    void UpdateCullingData();
+    // Construct every voxel in place, solid
+    void AllocateVoxels();
+    // Make the voxels resident and count the access
+    void Touch();
+    void UpdateColumnHeight(int column);
+    void Decompress();
 
     // Member Variables
     std::vector<std::vector<std::vector<Voxel>>> m_Voxels;
@@ -42,6 +145,21 @@ private:
     Chunk *m_backNeighbor;
     Chunk *m_leftNeighbor;
     Chunk *m_rightNeighbor;
+    AABB m_bounds;
+    std::vector<AABB> m_occluders;
+    bool m_cullingDirty;
+    // Packed occupancy while compressed, m_Voxels is empty then
+    std::vector<uint8_t> m_compressedVoxels;
+    bool m_compressed;
+    bool m_accessed;
+    // One byte per voxel in x, y, z order
+    std::vector<uint8_t> m_light;
+    // Light sources by voxel index
+    std::vector<std::pair<uint16_t, uint8_t>> m_emitters;
+    // Column occupancy and heights, by x * CHUNK_SIZE + z
+    static_assert(CHUNK_SIZE == 16, "column masks, edit history deltas and region files hold a column in 16 bits");
+    uint16_t m_columnMasks[CHUNK_SIZE * CHUNK_SIZE];
+    uint8_t m_columnHeights[CHUNK_SIZE * CHUNK_SIZE];
 };
 
 #endif /* CHUNK_HPP */
\ No newline at end of file
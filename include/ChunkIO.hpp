@@ -0,0 +1,103 @@
+#ifndef CHUNKIO_HPP
+#define CHUNKIO_HPP
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Batched reads and writes of the region files. On Linux a whole batch goes to the kernel through
+// io_uring, so a cold load waits for the slowest read instead of the sum of them. Where io_uring
+// is missing or blocked a small thread pool issues pread/pwrite calls in parallel instead. With
+// either backend the completions run on the pool threads where there is more than one core, so
+// decoding what was read overlaps the reads still in flight. One batch at a time per instance.
+class ChunkIO
+{
+public:
+    enum Backend
+    {
+        BACKEND_IO_URING,
+        BACKEND_THREAD_POOL
+    };
+
+    struct Request
+    {
+        int fd;
+        uint64_t offset;
+        uint32_t length;
+        // Bytes to write. A read with data set is already in memory, it skips the I/O and only
+        // runs its completion
+        const uint8_t *data;
+        // Called once per request with the bytes read (or written) and whether all of them were.
+        // May run on a pool thread, so requests must not share state
+        std::function<void(const uint8_t *data, size_t size, bool ok)> complete;
+    };
+
+    // Requests in flight at once
+    static const unsigned QUEUE_DEPTH = 64;
+
+    explicit ChunkIO(bool useIoUring = true, int threadCount = 4);
+    ~ChunkIO();
+    ChunkIO(const ChunkIO &) = delete;
+    ChunkIO &operator=(const ChunkIO &) = delete;
+
+    // Methods
+    // Issue every request and return once all of them completed
+    void ReadBatch(std::vector<Request> &requests);
+    void WriteBatch(std::vector<Request> &requests);
+
+    // Getters
+    Backend GetBackend() const;
+    const char *GetBackendName() const;
+
+private:
+    struct Ring;
+
+    // A ring transfer handed to the pool threads to finish
+    struct Completion
+    {
+        Request *request;
+        // Bytes read, empty for writes and for reads already in memory
+        std::vector<uint8_t> buffer;
+        // The transfer fell short or was refused, redo it with a blocking call
+        bool redo;
+    };
+
+    // Methods
+    void RunRing(std::vector<Request> &requests, bool write);
+    void RunPool(std::vector<Request> &requests, bool write);
+    // Callers hold m_mutex
+    void StartWorkers();
+    // Queue a ring transfer for the pool threads
+    void PushCompletion(Completion completion);
+    // Run the oldest queued transfer. Called with the lock held, it is released meanwhile
+    void FinishCompletion(std::unique_lock<std::mutex> &lock);
+    void WorkerLoop();
+    // Plain blocking read or write of one request
+    static void RunBlocking(Request &request, bool write);
+
+    // Member Variables
+    std::unique_ptr<Ring> m_ring;
+    int m_threadCount;
+    std::vector<std::thread> m_workers;
+    // Batch handed to the pool
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::vector<Request> *m_batch;
+    bool m_batchWrite;
+    size_t m_nextRequest;
+    // Ring transfers waiting for a pool thread
+    std::deque<Completion> m_completions;
+    // With a single core the thread running the ring finishes its transfers itself
+    bool m_poolCompletes;
+    // Requests of the batch not completed yet
+    size_t m_remaining;
+    bool m_stopping;
+};
+
+#endif /* CHUNKIO_HPP */
@@ -1,32 +1,193 @@
 #ifndef CHUNKMANAGER_HPP
 #define CHUNKMANAGER_HPP
 
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 #include "Chunk.hpp"
 #include "PerlinNoise.hpp"
+#include "OcclusionCuller.hpp"
+#include "EditHistory.hpp"
+#include "EditJournal.hpp"
+#include "RegionFile.hpp"
+#include "LightEngine.hpp"
+#include "MeshCache.hpp"
+
+// First solid block along a ray
+struct RaycastHit
+{
+    glm::ivec3 block;
+    // Outward normal of the face the ray entered through, zero when the ray starts inside the block
+    glm::ivec3 normal;
+    // Along the normalized direction, to where the ray enters the block
+    float distance;
+};
 
 class ChunkManager
 {
 public:
     // Constructor/ Destructor
-    ChunkManager();
+    // With a save directory chunks are loaded from its region files before generating them,
+    // and saved back when they leave the window and on destruction. Edits are journaled as they
+    // happen and chunk meshes are cached in the directory across runs. The loaded window is
+    // windowSize x windowSize chunks
+    explicit ChunkManager(const std::string &saveDirectory = "", int windowSize = CHUNK_GRID_SIZE);
     ~ChunkManager();
 
     // Constant
-    static const int CHUNK_GRID_SIZE = 8; // Y x Y grid Ex: 2 is 2x2 grid
+    static const int CHUNK_GRID_SIZE = 8; // Default window, Y x Y grid Ex: 2 is 2x2 grid
+    // Window with distant chunks at lower detail, about the triangles of CHUNK_GRID_SIZE at full detail
+    static const int LOD_GRID_SIZE = 24;
+    static const int MAX_OCCLUDER_CHUNKS = 16; // Nearest chunks rasterized as occluders each frame
+    static const int COLD_FRAMES = 300; // Frames without a voxel access before a chunk is compressed
+    static const int MAX_COMPRESSIONS_PER_FRAME = 4;
+    static const int MAX_RELIGHTS_PER_FRAME = 16;
+    static const int LOD_LEVELS = 4; // Full detail plus meshes downsampled 2x, 4x and 8x
+    static const siv::PerlinNoise::seed_type SEED = 123456u;
 
     // Methods
     void GenerateChunks();
+    // Remove the block at the world position
     void UpdateChunks(int x, int y, int z);
+    // Place or remove a block, ignored outside the loaded chunks and the chunk height. The light
+    // around it is updated and the chunks whose light changed are marked dirty
+    void SetBlock(int x, int y, int z, bool active);
+    // Batch edits over a box of world blocks, min inclusive and max exclusive, clipped to the loaded
+    // chunks and the chunk height. Each chunk is edited a column mask at a time, journaled, relit and
+    // marked dirty once however many of its blocks change. Return how many blocks changed
+    int FillBox(const glm::ivec3 &min, const glm::ivec3 &max, bool active);
+    // Blocks whose centers are within the radius, active false carves the sphere out
+    int FillSphere(const glm::vec3 &center, float radius, bool active);
+    // Turn the blocks of one kind in the box into the other, blocks are solid (true) or empty.
+    // Chunks inside the box are remapped whole
+    int ReplaceInBox(const glm::ivec3 &min, const glm::ivec3 &max, bool from, bool to);
+    // Block edits are recorded in the edit history, every SetBlock and batch edit as its own undo
+    // step unless they are grouped between BeginTransaction and EndTransaction (calls may nest)
+    void BeginTransaction();
+    void EndTransaction();
+    // Take back the newest step, or apply the last one taken back again, as one batch edit with
+    // one relight and remesh per chunk. False when there is no step, a transaction is open or a
+    // chunk of the step is outside the loaded window (the step is kept for later). Without a save
+    // directory a chunk leaving the window loses its edits, and the steps that touch it are dropped
+    bool Undo();
+    bool Redo();
+    EditHistory &GetEditHistory();
+    // Make the empty voxel at the world position a light source, level 0 removes it. Light
+    // sources are saved with the chunk's blocks
+    void SetLightSource(int x, int y, int z, int level);
+    // Amanatides-Woo walk through the voxels of the loaded chunks. The current chunk is cached and
+    // only changes when the ray crosses a chunk border. Returns false if nothing solid is within
+    // maxDistance
+    bool Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RaycastHit &hit);
+    // World height of the top of the highest block in the column at the world position, 0 for an
+    // empty column and -1 outside the loaded chunks. Read from the chunk's column index
+    int GetSurfaceHeight(int x, int z);
+    // Move the loaded window so it is centered on the world position, loading or generating the
+    // chunks that came into range. Returns how many chunks were brought in
+    int StreamAround(float x, float z);
+    // Pick each chunk's level of detail from its horizontal distance to the eye (chunk space). A chunk
+    // only switches once it is a few blocks past a level's distance, so a camera moving back and
+    // forth over it does not remesh it every frame. Switched chunks and their neighbors, whose skirts
+    // change, are marked dirty. Returns how many chunks switched
+    int UpdateLevelsOfDetail(const glm::vec3 &eye);
+    // Distance in blocks from which chunks use the level, 1 to LOD_LEVELS - 1. Distances must grow
+    // with the level
+    void SetLodDistance(int level, float distance);
+    int GetLevelOfDetail(int index) const;
+    // Write every loaded chunk that changed since it was loaded, returns false if a file could not
+    // be written. Does nothing without a save directory
+    bool Save();
+    bool IsChunkLoaded(int chunkX, int chunkZ) const;
+    // Chunk coordinates of the lowest corner of the loaded window
+    glm::ivec2 GetWindowOrigin() const;
+    // Chunks along a side of the loaded window
+    int GetWindowSize() const;
+    // Call once per frame: ages the chunks and compresses up to MAX_COMPRESSIONS_PER_FRAME of
+    // those idle for COLD_FRAMES. Returns how many were compressed
+    int CompressColdChunks();
+    // Chunks loaded with their saved light are meshed with it right away, so cached meshes are
+    // used without lighting them first. Call once per frame to relight up to
+    // MAX_RELIGHTS_PER_FRAME of them; only those whose light turns out different are remeshed
+    // and saved again. Returns how many are left
+    int RelightSavedChunks();
+
+    // Chunks are addressed by slot index, x major over the grid. A chunk keeps its slot while
+    // it stays loaded, so per chunk data kept by index stays valid when the window moves
+    int GetChunkCount() const;
+    Chunk *GetChunk(int index);
+    // Mesh of a single chunk at its level of detail with indices starting at 0. Sides bordering a
+    // chunk at another level get skirts. Served from the mesh cache when it holds the same inputs
+    const std::vector<GLfloat> GetChunkVertexData(int index, std::vector<GLuint> &indices);
+    // Hand out (and clear) the chunks whose mesh needs to be rebuilt
+    void TakeDirtyChunks(std::vector<int> &dirtyChunks);
+    // Bounds of what a chunk's mesh may cover, CullChunks tests these. Coarse meshes round cells of
+    // 2^level voxels up to solid and keep border faces as skirts, so the voxel bounds are rounded
+    // out to whole cells
+    AABB GetCullingBounds(int index);
+    // Collect the chunks that survive frustum and occlusion culling
+    void CullChunks(OcclusionCuller &culler, const glm::mat4 &viewProjection, const glm::vec3 &eye,
+                    std::vector<int> &visibleChunks);
 
-    const std::vector<GLfloat> GetVertexData();
-    const std::vector<GLuint> GetIndexData();
+    const LightEngine &GetLightEngine() const;
+    // Null without a save directory
+    const MeshCache *GetMeshCache() const;
+
+    // Integer division rounding towards negative infinity
+    static int FloorDiv(int value, int divisor);
 
 private:
-    // 2D grid of chunk pointers
+    // Methods
+    int SlotIndex(int chunkX, int chunkZ) const;
+    void MarkDirty(int chunkX, int chunkZ);
+    // Apply edit(worldX, worldZ, mask, bits) -> mask to every column of the box, where bits are the
+    // heights inside the box. Backs the batch edits. uniform is -1, or the state every block of a
+    // chunk the box covers whole ends up in; those chunks are filled without visiting their voxels,
+    // and chunks the edit leaves all solid or all empty are packed the same way
+    template <typename ColumnEdit>
+    int EditColumns(const glm::ivec3 &min, const glm::ivec3 &max, int uniform, ColumnEdit edit);
+    // Bookkeeping of a chunk whose column masks an edit changed: save, remesh and journal it,
+    // remesh the neighbors whose border changed and, if record is set, add it to the history
+    void CommitChunkEdit(int chunkX, int chunkZ, const uint16_t *masks, const uint16_t *changed, bool record);
+    // Flip the voxels of an undo or redo step and light or put out its light sources, false without
+    // changes if a chunk is not loaded
+    bool ApplyDeltas(const std::vector<EditHistory::ChunkDelta> &deltas, bool undo);
+    // Mark the chunks whose meshes see light changed by the light engine, and save them again
+    void MarkLightDirty();
+    // Light freshly loaded chunks. Chunks that kept their saved light wait for RelightSavedChunks
+    void LightLoadedChunks(const std::vector<Chunk *> &chunks);
+    void LinkNeighbors();
+    // Chunks from the region files if they were saved, otherwise from the terrain generator
+    std::vector<Chunk *> LoadOrGenerateChunks(const std::vector<std::pair<int, int>> &coordinates);
+
+    // Terrain generator
+    siv::PerlinNoise m_perlin;
+    // 2D grid of chunk pointers, chunk (x, z) lives in slot (x mod size, z mod size)
     std::vector<std::vector<Chunk *>> m_ChunkGrid;
-    // Indices of triangle faces
-    std::vector<GLuint> m_indexes;
+    int m_windowSize;
+    // Chunk coordinates of the lowest corner of the loaded window
+    int m_originX;
+    int m_originZ;
+    // Chunks that changed since their mesh was last taken
+    std::vector<bool> m_dirtyChunks;
+    // Saved chunks and the journal of edits not folded into them yet, null when nothing is persisted
+    std::unique_ptr<RegionStore> m_regionStore;
+    std::unique_ptr<EditJournal> m_journal;
+    std::unique_ptr<MeshCache> m_meshCache;
+    // Chunks that differ from their saved copy (generated or edited), by slot
+    std::vector<bool> m_unsavedChunks;
+    // Chunks still lit with their saved light, by chunk coordinates
+    std::vector<std::pair<int, int>> m_savedLightChunks;
+    // Frames since each chunk's voxels were last accessed, by slot
+    std::vector<int> m_idleFrames;
+    // Level of detail of each chunk's mesh, by slot
+    std::vector<int> m_lods;
+    // Level the last mesh of each slot was built at, it is drawn until the new one is uploaded
+    std::vector<int> m_meshLods;
+    float m_lodDistances[LOD_LEVELS];
+    LightEngine m_lightEngine;
+    EditHistory m_history;
+    int m_transactionDepth;
 };
 
 #endif /* CHUNKMANAGER_HPP */
\ No newline at end of file
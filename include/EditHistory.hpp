@@ -0,0 +1,101 @@
+#ifndef EDITHISTORY_HPP
+#define EDITHISTORY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+#include "Chunk.hpp"
+
+// Undo and redo steps of block edits, one transaction at a time. For every chunk a transaction
+// changed it keeps the XOR of the chunk's column masks before and after, so undoing and redoing
+// are the same operation and no copy of a chunk is ever held. Light sources put out by blocks
+// placed over them are kept after the XOR, undo lights them again. Undo and redo steps share a
+// byte budget, the oldest steps are dropped to stay within it.
+//
+// Delta layout: runs of changed columns, each u8 first column (x * CHUNK_SIZE + z), u8 column
+// count - 1, then a u16 XOR mask per column (bit y set where the voxel at height y flipped). If
+// the step put out light sources the runs end with the header 0xFF 0xFF, which no run can have,
+// followed by a u16 voxel index (x, y, z with z fastest) and u8 level per light source
+class EditHistory
+{
+public:
+    static const size_t DEFAULT_BUDGET_BYTES = 16 * 1024 * 1024;
+
+    struct ChunkDelta
+    {
+        int chunkX;
+        int chunkZ;
+        std::vector<uint8_t> runs;
+    };
+
+    EditHistory();
+    ~EditHistory();
+    EditHistory(const EditHistory &) = delete;
+    EditHistory &operator=(const EditHistory &) = delete;
+
+    // Methods
+    // Add the flipped bits of a chunk (CHUNK_SIZE^2 masks) to the open transaction. Flips of the
+    // same voxel within a transaction cancel out
+    void Record(int chunkX, int chunkZ, const uint16_t *changed);
+    // Add light sources of a chunk put out by the open transaction. A voxel put out twice keeps
+    // the level it had before the transaction
+    void RecordEmitters(int chunkX, int chunkZ, const std::vector<std::pair<uint16_t, uint8_t>> &emitters);
+    // Close the open transaction. Unless it changed nothing it becomes the newest undo step and
+    // the redo steps are dropped
+    void Commit();
+    // Newest undo step and oldest redo step, null when there is none
+    const std::vector<ChunkDelta> *GetUndo() const;
+    const std::vector<ChunkDelta> *GetRedo() const;
+    // Move the newest undo step over to the redo steps, once it was applied
+    void PopUndo();
+    // Move the next redo step back to the undo steps, once it was applied
+    void PopRedo();
+    // Drop the steps that touch any of the chunks, whose edits were lost, and every step beyond
+    // them: older undo steps and later redo steps were made on top of the lost ones
+    void DropChunks(const std::vector<std::pair<int, int>> &chunks);
+    // Oldest steps are dropped right away if the history is over the new budget. A transaction
+    // bigger than the whole budget is dropped as soon as it is committed
+    void SetBudget(size_t bytes);
+    // Expand a delta into CHUNK_SIZE^2 XOR masks
+    static void DecodeDelta(const ChunkDelta &delta, uint16_t *masks);
+    // Light sources a delta's step put out, voxel index and level
+    static void DecodeEmitters(const ChunkDelta &delta, std::vector<std::pair<uint16_t, uint8_t>> &emitters);
+
+    // Getters
+    size_t GetUndoCount() const;
+    size_t GetRedoCount() const;
+    // Bytes held by the undo and redo steps
+    size_t GetBytes() const;
+    size_t GetBudget() const;
+    // Steps dropped to stay within the budget, since construction
+    size_t GetEvictedCount() const;
+
+private:
+    typedef std::vector<ChunkDelta> Transaction;
+
+    // Methods
+    static size_t GetTransactionBytes(const Transaction &transaction);
+    void Evict();
+    void Drop(std::deque<Transaction> &steps);
+    // Drop from the front through the step closest to the back that touches one of the chunks
+    void DropThrough(std::deque<Transaction> &steps, const std::set<std::pair<int, int>> &chunks);
+
+    // Member Variables
+    // Flipped bits of the open transaction by chunk
+    std::map<std::pair<int, int>, std::vector<uint16_t>> m_open;
+    // Light sources put out by the open transaction by chunk
+    std::map<std::pair<int, int>, std::vector<std::pair<uint16_t, uint8_t>>> m_openEmitters;
+    // The next step to undo or redo is at the back, the front of each is the furthest away and
+    // the first to be dropped
+    std::deque<Transaction> m_undo;
+    std::deque<Transaction> m_redo;
+    size_t m_bytes;
+    size_t m_budget;
+    size_t m_evicted;
+};
+
+#endif /* EDITHISTORY_HPP */
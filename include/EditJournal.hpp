@@ -0,0 +1,125 @@
+#ifndef EDITJOURNAL_HPP
+#define EDITJOURNAL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "Chunk.hpp"
+#include "PerlinNoise.hpp"
+#include "RegionFile.hpp"
+
+// Write ahead log of block edits and light sources in front of the region files. Appending an
+// edit only queues it in memory; a writer thread commits the queue every COMMIT_INTERVAL_MS with a
+// single fsync (group commit), folds the edits into the region files once enough have piled up
+// and flushes the chunks the game stored. Edits left in the journal by a crash are folded in by Open.
+//
+// File layout (little endian):
+//   "VXJN", u8 version, 3 reserved bytes
+//   per commit: u32 record count, u32 FNV-1a checksum of the records, then per record
+//     zigzag varint chunk x, zigzag varint chunk z, u16 voxel index (x, y, z order), u8 value:
+//     0 or 1 clears or places the block, LIGHT_EDIT | level sets its light source (0 removes it)
+// A torn or damaged commit at the end of the file ends the replay there.
+class EditJournal
+{
+public:
+    static const int COMMIT_INTERVAL_MS = 50;
+    // Commit early when this many edits are queued
+    static const size_t MAX_BATCH_EDITS = 4096;
+    // Fold the journal into the region files once it holds this many edits
+    static const size_t COMPACT_EDITS = 8192;
+    // Marks a record that sets a light source rather than a block
+    static const uint8_t LIGHT_EDIT = 0x80;
+
+    // Chunks that were never saved are rebuilt from the terrain generator
+    EditJournal(RegionStore &store, const siv::PerlinNoise &perlin, const std::string &path);
+    ~EditJournal();
+    EditJournal(const EditJournal &) = delete;
+    EditJournal &operator=(const EditJournal &) = delete;
+
+    // Methods
+    // Fold the edits of a previous run into the region files and start the writer thread.
+    // Returns false if the journal can not be written, edits are then kept in memory only
+    bool Open();
+    // Commit and fold everything, then stop the writer thread
+    void Close();
+    // Queue an edit, never waits for the disk. Returns its sequence number
+    uint64_t Append(int chunkX, int chunkZ, int x, int y, int z, bool active);
+    // Queue a light source change, level 0 removes the source
+    uint64_t AppendLight(int chunkX, int chunkZ, int x, int y, int z, int level);
+    // Queue edits of one chunk, voxel index (x, y, z order) and active, taking each lock once.
+    // Returns the sequence number of the last
+    uint64_t AppendBatch(int chunkX, int chunkZ, const std::vector<std::pair<uint16_t, bool>> &edits);
+    // The saved chunks, or generated terrain for those never saved, with every edit that is not
+    // folded into the region files yet. Saved chunks are read in one batch. unsaved[i] is set when
+    // chunks[i] differs from its saved copy
+    void LoadChunks(const std::vector<std::pair<int, int>> &coordinates, std::vector<Chunk *> &chunks,
+                    std::vector<uint8_t> &unsaved);
+    // Wait until every edit appended so far is on disk
+    void Sync();
+
+    // Getters
+    uint64_t GetAppendedSequence();
+    uint64_t GetDurableSequence() const;
+    uint64_t GetCommitCount() const;
+    uint64_t GetCompactionCount() const;
+    // Edits not folded into the region files yet
+    size_t GetUnfoldedCount();
+
+private:
+    struct Edit
+    {
+        int chunkX;
+        int chunkZ;
+        uint16_t index;
+        uint8_t value;
+    };
+    typedef std::map<std::pair<int, int>, std::vector<std::pair<uint16_t, uint8_t>>> EditIndex;
+
+    // Methods
+    uint64_t AppendRecord(int chunkX, int chunkZ, uint16_t index, uint8_t value);
+    void WriterLoop();
+    bool Commit(const std::vector<Edit> &batch);
+    // Fold every unfolded edit into the region files and empty the journal file
+    bool Compact();
+    // Start the file over with just the header
+    bool Truncate();
+    void ReadJournal(std::vector<Edit> &edits);
+    Chunk *BuildChunk(int chunkX, int chunkZ, bool &generated);
+
+    // Member Variables
+    RegionStore &m_store;
+    siv::PerlinNoise m_perlin;
+    std::string m_path;
+    std::FILE *m_file;
+    std::thread m_writer;
+
+    // Edits waiting to be committed
+    std::mutex m_queueMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_committed;
+    std::vector<Edit> m_queue;
+    uint64_t m_appended;
+    bool m_syncRequested;
+    bool m_stopping;
+    bool m_running;
+
+    // Edits not folded into the region files, by chunk in append order. LoadChunks and the
+    // compactor's swap of a chunk hold the lock so a load sees either the old or the new copy
+    std::mutex m_indexMutex;
+    EditIndex m_index;
+    size_t m_unfolded;
+
+    std::atomic<uint64_t> m_durable;
+    std::atomic<uint64_t> m_commits;
+    std::atomic<uint64_t> m_compactions;
+    std::atomic<bool> m_failed;
+};
+
+#endif /* EDITJOURNAL_HPP */
@@ -0,0 +1,14 @@
+#ifndef FRAMESTATS_HPP
+#define FRAMESTATS_HPP
+
+// Counters describing how the last frame was submitted to the GPU
+struct FrameStats
+{
+    int drawCalls = 0;
+    int chunksDrawn = 0;
+    long long trianglesSubmitted = 0;
+    // CPU time spent building and issuing the chunk draws
+    double submitMilliseconds = 0.0;
+};
+
+#endif /* FRAMESTATS_HPP */
@@ -0,0 +1,120 @@
+#ifndef FRAMETELEMETRY_HPP
+#define FRAMETELEMETRY_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Parts of a frame timed on the CPU, in the order MainLoop runs them
+enum FramePhase
+{
+    PHASE_INPUT,
+    PHASE_UPLOAD, // Meshing dirty chunks and streaming them to the arena
+    PHASE_PREDRAW,
+    PHASE_DRAW,
+    PHASE_SWAP,
+    PHASE_COUNT
+};
+
+// Fixed memory histogram of millisecond timings. Buckets are spaced logarithmically from
+// MIN_MILLISECONDS to MAX_MILLISECONDS so percentiles are within ~4% at any frame rate
+class FrameHistogram
+{
+public:
+    static const int BUCKET_COUNT = 256;
+    static constexpr double MIN_MILLISECONDS = 0.01;
+    static constexpr double MAX_MILLISECONDS = 1000.0;
+
+    FrameHistogram();
+
+    // Methods
+    void Add(double milliseconds);
+    void Clear();
+    // Upper edge of the bucket holding the p-th percentile, 0 when empty
+    double Percentile(double p) const;
+
+    // Getters
+    uint64_t GetCount() const;
+    double GetMax() const;
+
+private:
+    uint64_t m_buckets[BUCKET_COUNT];
+    uint64_t m_count;
+    double m_max;
+};
+
+// Everything recorded about a single frame
+struct FrameRecord
+{
+    uint64_t frameIndex = 0;
+    // Seconds since telemetry started, at the beginning of the frame
+    double startSeconds = 0.0;
+    // Wall time from BeginFrame to EndFrame, swap included (what the player feels)
+    float frameMilliseconds = 0.0f;
+    float phaseMilliseconds[PHASE_COUNT] = {};
+    // Negative until the GPU timer query for the frame has been read back
+    float gpuMilliseconds = -1.0f;
+    int chunksDrawn = 0;
+    int chunksUploaded = 0;
+};
+
+// Per phase CPU histograms, GPU time and a flight recorder holding the last few seconds of frames.
+// When a frame goes over the hitch threshold the recorder is written to disk so the frames leading
+// up to the hitch can be inspected afterwards.
+class FrameTelemetry
+{
+public:
+    // Enough for the record window at 240 frames per second
+    static const int MAX_RECORDED_FRAMES = 2048;
+
+    FrameTelemetry(double recordSeconds = 5.0, double hitchMilliseconds = 50.0);
+
+    // Methods
+    void BeginFrame();
+    // Time since the previous mark (or BeginFrame) is charged to the phase
+    void EndPhase(FramePhase phase);
+    void EndFrame(int chunksDrawn, int chunksUploaded);
+    // GPU results arrive a few frames late, they are matched to their frame by index. A hitch
+    // dump is written before its own frame's GPU time is known
+    void RecordGpuTime(uint64_t frameIndex, double milliseconds);
+    // Write every recorded frame of the last record window as JSON
+    bool DumpFlightRecorder(const std::string &path) const;
+    void PrintSummary(std::ostream &out) const;
+
+    // Getters
+    uint64_t GetFrameIndex() const;
+    const FrameHistogram &GetFrameHistogram() const;
+    const FrameHistogram &GetPhaseHistogram(FramePhase phase) const;
+    const FrameHistogram &GetGpuHistogram() const;
+    uint64_t GetHitchCount() const;
+    static const char *GetPhaseName(FramePhase phase);
+
+    // Setters
+    void SetHitchThreshold(double milliseconds);
+    // Prefix of the files written on a hitch, the frame index and .json are appended
+    void SetDumpPrefix(const std::string &prefix);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // Member Variables
+    double m_recordSeconds;
+    double m_hitchMilliseconds;
+    std::string m_dumpPrefix;
+    Clock::time_point m_start;
+    Clock::time_point m_frameStart;
+    Clock::time_point m_phaseStart;
+    FrameRecord m_current;
+    std::vector<FrameRecord> m_recorder;
+    uint64_t m_frameIndex;
+    uint64_t m_hitchCount;
+    // No new dump until the window written by the last one has scrolled out
+    double m_nextDumpSeconds;
+    FrameHistogram m_frameHistogram;
+    FrameHistogram m_phaseHistograms[PHASE_COUNT];
+    FrameHistogram m_gpuHistogram;
+};
+
+#endif /* FRAMETELEMETRY_HPP */
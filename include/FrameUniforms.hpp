@@ -0,0 +1,37 @@
+#ifndef FRAMEUNIFORMS_HPP
+#define FRAMEUNIFORMS_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Binding point of the FrameData uniform block shared by every shader program
+const GLuint FRAME_UNIFORM_BINDING = 0;
+
+// Per frame values, laid out to match the std140 FrameData block in the shaders.
+// Only mat4 and vec4 members are used so the C++ and std140 layouts agree.
+struct FrameUniforms
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 lightPosition;
+    glm::vec4 lightColor;
+    glm::vec4 cameraPosition;
+};
+
+// Uniform buffer holding FrameUniforms, written once per frame and read by all programs
+class FrameUniformBuffer
+{
+public:
+    // Constructor/Destructor
+    FrameUniformBuffer();
+    ~FrameUniformBuffer();
+
+    // Methods
+    void Update(const FrameUniforms &uniforms);
+
+private:
+    GLuint m_ubo;
+};
+
+#endif /* FRAMEUNIFORMS_HPP */
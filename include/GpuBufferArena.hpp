@@ -0,0 +1,83 @@
+#ifndef GPUBUFFERARENA_HPP
+#define GPUBUFFERARENA_HPP
+
+#include <vector>
+#include <glad/glad.h>
+#include "BufferAllocator.hpp"
+#include "FrameStats.hpp"
+#include "StagingRing.hpp"
+
+// Arguments for a glDrawElementsBaseVertex call of one mesh inside the arena
+struct MeshDrawRange
+{
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
+// One shared vertex buffer and index buffer that every chunk mesh is sub-allocated from.
+// Meshes use indices local to themselves and are drawn with a base vertex, so a whole
+// world lives in a single VAO. The layout matches the Voxel vertex format.
+class GpuBufferArena
+{
+public:
+    // Constructor/Destructor. Capacities are in vertices and indices
+    GpuBufferArena(GLuint vertexCapacity, GLuint indexCapacity);
+    ~GpuBufferArena();
+
+    // Methods
+    // Returns a handle to the uploaded mesh, empty meshes get a handle with nothing to draw
+    int Upload(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices);
+    // Same as above but the data goes through the staging ring. Returns -1 without allocating
+    // anything when the ring has no room left this frame
+    int Upload(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices, StagingRing &ring);
+    void Free(int handle);
+    bool GetDrawRange(int handle, MeshDrawRange &range) const;
+    // Compact both buffers once the free space is split up more than the threshold (0..1)
+    bool DefragmentIfNeeded(float threshold);
+    void Bind() const;
+    // Draw every listed mesh with a single glMultiDrawElementsBaseVertex call
+    void DrawMeshes(const std::vector<int> &handles, FrameStats &stats);
+
+    // Getters
+    GLuint GetVertexArray() const;
+    GLuint GetVertexBuffer() const;
+    GLuint GetIndexBuffer() const;
+    const BufferAllocator &GetVertexAllocator() const;
+    const BufferAllocator &GetIndexAllocator() const;
+
+private:
+    // Where one mesh lives inside the buffers
+    struct Mesh
+    {
+        uint32_t vertexOffset;
+        uint32_t vertexCount;
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        bool live;
+    };
+
+    // Methods
+    // Place a mesh in the buffers without writing it
+    int Allocate(uint32_t vertexCount, uint32_t indexCount);
+    void Reserve(uint32_t vertexCount, uint32_t indexCount);
+    void Defragment();
+    void Relocate(GLuint &buffer, GLsizeiptr elementSize, GLsizeiptr newCapacity,
+                  const std::vector<BufferAllocator::Move> &moves);
+    void SetupVertexArray();
+
+    // Member Variables
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    BufferAllocator m_vertexAllocator;
+    BufferAllocator m_indexAllocator;
+    std::vector<Mesh> m_meshes;
+    std::vector<int> m_freeHandles;
+    // Scratch arrays for the batched draw, kept to avoid allocating every frame
+    std::vector<GLsizei> m_drawCounts;
+    std::vector<const GLvoid *> m_drawOffsets;
+    std::vector<GLint> m_drawBaseVertices;
+};
+
+#endif /* GPUBUFFERARENA_HPP */
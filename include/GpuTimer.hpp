@@ -0,0 +1,51 @@
+#ifndef GPUTIMER_HPP
+#define GPUTIMER_HPP
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+
+// Measures GPU time of a section of each frame with GL_TIME_ELAPSED queries. Results are only
+// read once the driver reports them available, so a few queries are kept in flight and the
+// timer never stalls the pipeline. Does nothing when timer queries are not supported.
+class GpuTimer
+{
+public:
+    struct Result
+    {
+        uint64_t frameIndex;
+        double milliseconds;
+    };
+
+    // Queries in flight, frames whose query slot is still busy are not timed
+    static const int QUERY_COUNT = 4;
+
+    GpuTimer();
+    ~GpuTimer();
+
+    // Methods
+    void Begin(uint64_t frameIndex);
+    void End();
+    // Collect every finished query, oldest first
+    void Poll(std::vector<Result> &results);
+
+    // Getters
+    bool IsSupported() const;
+
+private:
+    struct Query
+    {
+        GLuint id;
+        uint64_t frameIndex;
+        bool pending;
+    };
+
+    // Member Variables
+    Query m_queries[QUERY_COUNT];
+    int m_next;
+    // Query currently between Begin and End, -1 if none
+    int m_active;
+    bool m_supported;
+};
+
+#endif /* GPUTIMER_HPP */
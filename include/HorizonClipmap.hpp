@@ -0,0 +1,74 @@
+#ifndef HORIZONCLIPMAP_HPP
+#define HORIZONCLIPMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include "PerlinNoise.hpp"
+
+// Heightfield impostor of the terrain past the loaded chunks. Nested square levels of column
+// heights around the camera, each with twice the spacing and twice the reach of the one inside it
+// (a clipmap). Heights come from the terrain generator without building chunks and are cached in
+// toroidal grids, so moving the camera only samples the rows and columns that came into range
+class HorizonClipmap
+{
+public:
+    explicit HorizonClipmap(siv::PerlinNoise::seed_type seed);
+    ~HorizonClipmap();
+    HorizonClipmap(const HorizonClipmap &) = delete;
+    HorizonClipmap &operator=(const HorizonClipmap &) = delete;
+
+    // Constants
+    static const int LEVELS = 6;
+    static const int GRID_SIZE = 32;   // Cells a side of every level, even
+    static const int BASE_SPACING = 8; // Blocks between the samples of the finest level
+
+    // Methods
+    // Center the levels on the world position and cut the square of loaded chunks out of the
+    // finest one. The square should be aligned to BASE_SPACING. Returns how many columns were sampled
+    int Update(float x, float z, const glm::ivec2 &holeMin, int holeSize);
+    // Whether the mesh changed since it was last built
+    bool IsDirty() const;
+    // One quad per cell, every level without the square covered by the level inside it. Skirts hang
+    // from the edges of each level down to the bottom of the world, covering the cracks to the next
+    // level and to the loaded chunks. Indices start at 0
+    void BuildMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices);
+
+    // Getters
+    // Cached height of a sample of a level, sample coordinates are world coordinates over the
+    // level's spacing. Only valid for samples inside the level
+    int GetHeight(int level, int sampleX, int sampleZ) const;
+    // Sample coordinates of the lowest corner of a level
+    glm::ivec2 GetOrigin(int level) const;
+    // Blocks from the center to the edge of the coarsest level
+    int GetReach() const;
+    // Columns sampled since construction
+    size_t GetSampledColumns() const;
+
+private:
+    struct Level
+    {
+        int spacing;
+        glm::ivec2 origin;
+        bool valid;
+        // (GRID_SIZE + 1)^2 samples, a sample lives in slot (x mod (GRID_SIZE + 1), z mod (GRID_SIZE + 1))
+        std::vector<uint8_t> heights;
+    };
+
+    // Methods
+    static int SampleSlot(int sample);
+    // Whether a cell of a level, in sample coordinates, is drawn
+    bool IsCellDrawn(int level, int cellX, int cellZ) const;
+
+    // Member Variables
+    siv::PerlinNoise m_perlin;
+    Level m_levels[LEVELS];
+    glm::ivec2 m_holeMin;
+    int m_holeSize;
+    bool m_dirty;
+    size_t m_sampledColumns;
+};
+
+#endif /* HORIZONCLIPMAP_HPP */
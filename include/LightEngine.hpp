@@ -0,0 +1,74 @@
+#ifndef LIGHTENGINE_HPP
+#define LIGHTENGINE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Chunk.hpp"
+
+// Light channels, stored as the two nibbles of Chunk::GetLight
+enum LightChannel
+{
+    LIGHT_SKY,   // Full above the world, falls straight down without dimming
+    LIGHT_BLOCK, // Emitted by light sources
+    LIGHT_CHANNEL_COUNT
+};
+
+// Breadth first flood fill of sky and block light through the voxels of linked chunks. Light
+// drops one level per voxel except sky light going down. Changes go through add and remove
+// queues, so an edit only revisits the voxels whose light it changes and the ones bordering them
+class LightEngine
+{
+public:
+    LightEngine();
+
+    // Methods
+    // Light a chunk linked to its neighbors: its sky columns and light sources, plus the light on
+    // the borders of its neighbors, flooded through it and back out
+    void LightChunk(Chunk *chunk);
+    // Call after the block at a local position of the chunk was placed or removed
+    void UpdateBlock(Chunk *chunk, int x, int y, int z);
+    // Relight chunks after edits to many of their blocks. All of their light is taken out, along
+    // with whatever it reached in the chunks around them, then their sky columns and light sources
+    // and the light bordering the darkened area flood back in. Cheaper than UpdateBlock per voxel
+    // once an edit changes more than a handful of a chunk's blocks
+    void RelightChunks(const std::vector<Chunk *> &chunks);
+    // Make an empty voxel emit block light, level 0 removes the source
+    void SetEmitter(Chunk *chunk, int x, int y, int z, int level);
+    // Hand out (and clear) the chunks whose meshes see changed light: the chunks whose light
+    // changed and the neighbors bordering a changed voxel
+    void TakeChangedChunks(std::vector<Chunk *> &chunks);
+
+    // Getters
+    // Voxels whose light was written, since construction
+    size_t GetUpdatedVoxels() const;
+
+    static int GetLevel(uint8_t light, int channel);
+
+private:
+    struct LightNode
+    {
+        Chunk *chunk;
+        int8_t x, y, z;
+        uint8_t level;
+    };
+
+    // Methods
+    void Propagate(int channel);
+    void Unpropagate(int channel);
+    // Write one channel of a voxel's light and record the chunks that see it
+    void Store(Chunk *chunk, int x, int y, int z, int channel, int level);
+    void MarkChanged(Chunk *chunk);
+    // Move to the voxel in one of the 6 directions, across chunk borders. False past the top or
+    // bottom of the world and outside the loaded chunks
+    static bool Step(LightNode &node, int direction);
+
+    // Member Variables
+    // Used as FIFOs, consumed from the front and cleared when drained
+    std::vector<LightNode> m_addQueue[LIGHT_CHANNEL_COUNT];
+    std::vector<LightNode> m_removeQueue[LIGHT_CHANNEL_COUNT];
+    std::vector<Chunk *> m_changedChunks;
+    size_t m_updatedVoxels;
+};
+
+#endif /* LIGHTENGINE_HPP */
@@ -0,0 +1,56 @@
+#ifndef MEMORYSTATS_HPP
+#define MEMORYSTATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Subsystems whose memory is accounted
+enum MemoryCategory
+{
+    MEMORY_CHUNK_VOXELS, // Voxel storage of loaded chunks
+    MEMORY_CHUNK_LIGHT,  // Sky and block light levels of loaded chunks
+    MEMORY_CPU_MESHES,   // Mesh data kept on the CPU side (pending uploads, sun)
+    MEMORY_GPU_BUFFERS,  // Buffer objects, by the size requested from the driver
+    MEMORY_TEXTURES,     // Texture images including their mip chain
+    MEMORY_JOB_QUEUES,   // Queued work: dirty chunk lists and the mesh upload queue
+    MEMORY_EDIT_HISTORY, // Undo and redo steps of block edits
+    MEMORY_CATEGORY_COUNT
+};
+
+// Snapshot of one category
+struct MemoryUsage
+{
+    int64_t bytes = 0;
+    int64_t count = 0;
+    int64_t peakBytes = 0;
+};
+
+// Process wide byte and object counters per subsystem. The owners of the memory report every
+// allocation and release, the counters are atomics so any thread may do so.
+class MemoryStats
+{
+public:
+    // Methods
+    static void Add(MemoryCategory category, int64_t bytes, int64_t count = 1);
+    static void Remove(MemoryCategory category, int64_t bytes, int64_t count = 1);
+    // Print a table of every category
+    static void Dump(std::ostream &out);
+
+    // Getters
+    static MemoryUsage Get(MemoryCategory category);
+    static int64_t GetTotalBytes();
+    static const char *GetCategoryName(MemoryCategory category);
+
+private:
+    struct Counters
+    {
+        std::atomic<int64_t> bytes;
+        std::atomic<int64_t> count;
+        std::atomic<int64_t> peakBytes;
+    };
+    static Counters s_counters[MEMORY_CATEGORY_COUNT];
+};
+
+#endif /* MEMORYSTATS_HPP */
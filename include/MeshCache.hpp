@@ -0,0 +1,120 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include "RegionFile.hpp"
+
+// Chunk meshes kept on disk between runs, keyed by Chunk::HashMeshInputs. A restart maps the file
+// and finds its meshes by key instead of meshing the chunks again; a chunk whose voxels, light or
+// neighbors changed hashes to a new key and misses. Only the newest mesh of a chunk is kept, in
+// memory until the chunk is released, then a writer thread appends it. Find only reads meshes of
+// earlier runs, so the frame loop never touches the file.
+//
+// File layout (little endian, every field 4 byte aligned):
+//   "VXMC", u32 mesher version
+//   per mesh: u64 key, u32 vertex float count, u32 index count, u32 FNV-1a checksum of the data,
+//     then the vertex floats and the indices
+// A file of another mesher version is started over, a torn mesh at the end is cut off.
+class MeshCache
+{
+public:
+    // Meshes are no longer appended past this size. Once the file is past half of it, Close
+    // rewrites it with only the meshes used this run
+    static const size_t MAX_FILE_BYTES = 64 * 1024 * 1024;
+
+    explicit MeshCache(const std::string &path);
+    ~MeshCache();
+    MeshCache(const MeshCache &) = delete;
+    MeshCache &operator=(const MeshCache &) = delete;
+
+    // Methods
+    // Map the meshes of a previous run and start the writer thread. Returns false if the file can
+    // not be written, the cache then only misses
+    bool Open();
+    // Write the meshes of the chunks not released yet, compact if the file grew too big, then close it
+    void Close();
+    // Copy the mesh stored under the key by an earlier run, false on a miss or a damaged mesh
+    bool Find(uint64_t key, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices);
+    // Keep the newest mesh of a chunk, replacing the one kept before. Nothing is kept if the file
+    // holds the key already
+    void Store(int chunkX, int chunkZ, uint64_t key, const std::vector<GLfloat> &vertices,
+               const std::vector<GLuint> &indices);
+    // The chunk left the loaded area, hand its newest mesh to the writer thread
+    void Release(int chunkX, int chunkZ);
+
+    // Getters
+    size_t GetHits() const;
+    size_t GetMisses() const;
+    size_t GetEntryCount() const;
+    // Meshes appended by the writer thread
+    size_t GetWrittenCount();
+
+private:
+    struct Entry
+    {
+        // Of the entry header in the file
+        size_t offset;
+        uint32_t vertexFloats;
+        uint32_t indexCount;
+    };
+
+    struct Mesh
+    {
+        uint64_t key;
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint> indices;
+    };
+
+    // Methods
+    void WriterLoop();
+    // Append a mesh to the file, false if the write failed. Called by the writer thread
+    bool Write(const Mesh &mesh);
+    // Index the meshes in the mapping, returns the end of the last whole one
+    size_t IndexEntries();
+    // Start the file over with just the header
+    bool Truncate();
+    // Rewrite the file with the meshes used this run
+    void Compact();
+
+    // Member Variables
+    std::string m_path;
+    bool m_open;
+    // Meshes of earlier runs, only read by Find
+    MappedFile m_mapping;
+    std::unordered_map<uint64_t, Entry> m_entries;
+    // Keys found or kept this run
+    std::unordered_set<uint64_t> m_usedKeys;
+    // Newest mesh of each loaded chunk that is not in the file, by chunk coordinates
+    std::map<std::pair<int, int>, Mesh> m_pending;
+    size_t m_hits;
+    size_t m_misses;
+
+    // Released meshes waiting for the writer thread
+    std::thread m_writer;
+    std::mutex m_queueMutex;
+    std::condition_variable m_wake;
+    std::vector<Mesh> m_queue;
+    bool m_stopping;
+    size_t m_writtenCount;
+
+    // Owned by the writer thread while it runs
+    std::FILE *m_file;
+    // Bytes in the file, appended ones included
+    size_t m_fileSize;
+    // Meshes appended this run
+    std::unordered_map<uint64_t, Entry> m_written;
+};
+
+#endif /* MESHCACHE_HPP */
@@ -0,0 +1,104 @@
+#ifndef OCCLUSIONCULLER_HPP
+#define OCCLUSIONCULLER_HPP
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include "AABB.hpp"
+
+// Counters for a single culling pass
+struct CullStats
+{
+    int chunksTested = 0;
+    int frustumCulled = 0;
+    int occlusionCulled = 0;
+    int chunksVisible = 0;
+    int occluderBoxes = 0;
+    int occluderTriangles = 0;
+    double rasterMilliseconds = 0.0;
+
+    // Fraction of the chunks that survived the frustum test but were hidden by occluders
+    float OcclusionRate() const;
+};
+
+// Low resolution software depth buffer used to reject chunks hidden behind nearer terrain.
+// Occluders are rasterized on the CPU so this runs (and can be exercised) without a GPU.
+// With more than one thread the bands of rows are rasterized by workers that live as long as the
+// culler, small frames are rasterized on the calling thread alone.
+class OcclusionCuller
+{
+public:
+    // Fewer occluder triangles than this are not worth waking the workers for
+    static const int MIN_PARALLEL_TRIANGLES = 256;
+
+    // Constructor. Width is rounded up to a multiple of 4 so rows can be processed 4 pixels at a time
+    OcclusionCuller(int width = 256, int height = 128, int threadCount = 1);
+    ~OcclusionCuller();
+    OcclusionCuller(const OcclusionCuller &) = delete;
+    OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+    // Methods
+    void BeginFrame(const glm::mat4 &viewProjection);
+    void AddOccluder(const AABB &box);
+    void RasterizeOccluders();
+    bool IsInFrustum(const AABB &box) const;
+    bool IsOccluded(const AABB &box) const;
+    // Frustum and occlusion test combined, updates the frame stats
+    bool TestVisibility(const AABB &box);
+
+    // Getters
+    const CullStats &GetStats() const;
+    CullStats &GetStats();
+    const std::vector<float> &GetDepthBuffer() const;
+    int GetWidth() const;
+    int GetHeight() const;
+
+    // Setters
+    void SetThreadCount(int threadCount);
+
+private:
+    // Screen space triangle with a depth plane, ready for rasterization
+    struct ScreenTriangle
+    {
+        glm::vec2 v0, v1, v2;
+        // depth = zBase + zStepX * x + zStepY * y
+        float zBase, zStepX, zStepY;
+        int minX, minY, maxX, maxY;
+    };
+
+    // Methods
+    void SetupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c);
+    void RasterizeRows(int rowBegin, int rowEnd);
+    void RasterizeTriangle(const ScreenTriangle &tri, int rowBegin, int rowEnd);
+    // Rows of the band a thread rasterizes, band 0 is the calling thread's
+    void GetBand(int band, int &rowBegin, int &rowEnd) const;
+    void WorkerLoop(int band);
+    void StopWorkers();
+
+    // Member Variables
+    int m_width;
+    int m_height;
+    int m_threadCount;
+    glm::mat4 m_viewProjection;
+    glm::vec4 m_frustumPlanes[6];
+    std::vector<float> m_depth;
+    std::vector<AABB> m_occluders;
+    std::vector<ScreenTriangle> m_triangles;
+    CullStats m_stats;
+
+    // Workers rasterizing bands 1 and up, started on the first frame that needs them
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    // Bumped for every frame handed to the workers
+    unsigned m_frame;
+    int m_bands;
+    int m_tilesPerBand;
+    int m_remaining;
+    bool m_stopping;
+};
+
+#endif /* OCCLUSIONCULLER_HPP */
@@ -0,0 +1,170 @@
+#ifndef REGIONFILE_HPP
+#define REGIONFILE_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Chunk.hpp"
+#include "ChunkIO.hpp"
+
+// Read only view of a whole file. Mapped with mmap where available, so reading a chunk touches
+// only the pages it lives in and nothing is copied; other platforms read the file into memory.
+// The descriptor stays open for ChunkIO reads.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Methods
+    // Returns false if the file is missing or empty
+    bool Open(const std::string &path);
+    void Close();
+
+    // True if reading the range through the mapping does not wait for the disk
+    bool IsResident(size_t offset, size_t length) const;
+
+    // Getters
+    const uint8_t *GetData() const;
+    size_t GetSize() const;
+    // -1 where the file was read into memory
+    int GetDescriptor() const;
+
+private:
+    // Member Variables
+    const uint8_t *m_data;
+    int m_fd;
+    size_t m_size;
+    bool m_mapped;
+    std::vector<uint8_t> m_copy;
+};
+
+// Saved chunks, grouped by 32x32 chunks per region file.
+//
+// File layout (little endian):
+//   "VXRG", u8 version, u8 chunk size, u16 reserved
+//   offset table: REGION_SIZE * REGION_SIZE entries of u32 offset, u32 length (0 length = not stored),
+//     indexed by local x * REGION_SIZE + local z
+//   payloads: u8 encoding, light sources if its bit 7 is set, light if its bit 6 is set, then the voxels
+//     light sources: u16 count, per source u16 voxel index (x, y, z order) and u8 level
+//     light: varint byte count, then runs of u8 light and varint length in x, y, z order
+//     raw: one bit per voxel in x, y, z order
+//     rle: u8 value of the first voxel, varint run lengths of alternating values
+//
+// Stored chunks are kept in memory until Flush rewrites their region files, a stored chunk that
+// is loaded again before that is read from memory. All methods may be called from any thread and
+// none of them touches the disk while holding the lock the others wait on: payloads are located
+// under it and read after it is released, the files they come from stay open until then. LoadChunks
+// and Flush go through ChunkIO, so a batch of chunks costs about one disk round trip.
+class RegionStore
+{
+public:
+    static const int REGION_SIZE = 32;
+    // Flush once this many chunks are waiting to be written
+    static const int MAX_PENDING_CHUNKS = 64;
+
+    // Without io_uring the batched I/O runs on a thread pool
+    explicit RegionStore(const std::string &directory, bool useIoUring = true);
+
+    // Methods
+    // Fill the chunk from its saved voxels, returns false if it was never saved or its data is damaged
+    bool LoadChunk(int chunkX, int chunkZ, Chunk &chunk);
+    // LoadChunk for many chunks with one batch. Chunks whose pages are in memory are decoded
+    // straight from the mapping, only the others are read, and every chunk is decoded on the
+    // ChunkIO pool while the reads are in flight. loaded[i] tells whether chunks[i] was filled
+    void LoadChunks(const std::vector<std::pair<int, int>> &coordinates, const std::vector<Chunk *> &chunks,
+                    std::vector<uint8_t> &loaded);
+    bool HasChunk(int chunkX, int chunkZ);
+    // Queue the chunk's voxels to be written by the next Flush
+    void StoreChunk(int chunkX, int chunkZ, Chunk &chunk);
+    // Rewrite every region with stored chunks and sync the files to disk, returns false if a file
+    // could not be written
+    bool Flush();
+
+    // Payload codec, also used to compare chunk contents
+    static void EncodeChunk(Chunk &chunk, std::vector<uint8_t> &payload);
+    static bool DecodeChunk(const uint8_t *payload, size_t size, Chunk &chunk);
+
+    // Getters
+    std::string GetRegionPath(int regionX, int regionZ) const;
+    int GetPendingCount() const;
+    const char *GetIOBackendName() const;
+    // Chunks LoadChunks had to read from disk, the others were decoded from resident pages
+    size_t GetDiskReadCount() const;
+
+private:
+    // A mapped region file with its offset table read into memory
+    struct RegionFile
+    {
+        MappedFile mapping;
+        // Offset and length per table index, 0 length where the chunk is not stored
+        std::vector<std::pair<uint32_t, uint32_t>> table;
+    };
+
+    struct Region
+    {
+        // Null when there is no file or its header is damaged. Readers hold a reference while they
+        // read outside the lock, Flush swaps in the rewritten file
+        std::shared_ptr<const RegionFile> file;
+        // Encoded chunks waiting for Flush, by table index
+        std::map<int, std::vector<uint8_t>> pending;
+    };
+
+    // Where a stored chunk's payload lives, found under m_mutex and read once it is released:
+    // a range of a region file or a copy of the pending payload
+    struct PayloadSource
+    {
+        std::shared_ptr<const RegionFile> file;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        std::vector<uint8_t> copy;
+    };
+
+    // A region file being rewritten by Flush
+    struct RegionWrite
+    {
+        int regionX;
+        int regionZ;
+        std::vector<uint8_t> data;
+        // The pending chunks it contains
+        std::map<int, std::vector<uint8_t>> written;
+        bool ok;
+    };
+
+    // Methods
+    // Map a region file and read its table, null if it is missing or damaged. Reads the disk
+    static std::shared_ptr<const RegionFile> OpenRegionFile(const std::string &path);
+    // Callers hold the lock on m_mutex. A region seen for the first time is opened with the lock
+    // released, so references taken before the call must not be relied on after it
+    Region &GetRegion(int regionX, int regionZ, std::unique_lock<std::mutex> &lock);
+    // Locate a chunk's payload, false if it is not stored. Callers hold the lock on m_mutex
+    bool FindPayload(int chunkX, int chunkZ, std::unique_lock<std::mutex> &lock, PayloadSource &source);
+    // Merge the chunks on disk with the stored ones into a new file image
+    void AssembleRegion(RegionWrite &write);
+    // Swap the written file in and drop the pending chunks it contains
+    bool InstallRegion(RegionWrite &write);
+    // Write the images next to the old files, returns false where that failed
+    void WriteFiles(std::vector<RegionWrite> &writes);
+
+    // Member Variables
+    std::string m_directory;
+    std::map<std::pair<int, int>, Region> m_regions;
+    int m_pendingCount;
+    // Guards the regions, held only for memory work
+    mutable std::mutex m_mutex;
+    // Serializes Flush
+    std::mutex m_flushMutex;
+    // Serializes the batches of the reader, Flush owns the writer
+    mutable std::mutex m_readMutex;
+    std::unique_ptr<ChunkIO> m_reader;
+    size_t m_diskReads;
+    std::unique_ptr<ChunkIO> m_writer;
+};
+
+#endif /* REGIONFILE_HPP */
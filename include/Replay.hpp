@@ -0,0 +1,95 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Camera paths, block edits and light sources recorded on a fixed tick clock, so a run can be replayed
+// frame for frame by the engine or headless by voxel-bench.
+//
+// File layout (little endian):
+//   "VXRP", u8 version, u8 reserved, u16 ticks per second, u32 event count
+//   per event: u8 type, varint ticks since the previous event, then
+//     camera: 3 float eye position, 3 float view direction
+//     edit, place: 3 zigzag varint block coordinates of the removed or placed block
+//     light: 3 zigzag varint block coordinates, u8 light level (0 removes the source)
+struct ReplayEvent
+{
+    enum Type : uint8_t
+    {
+        CAMERA = 1,
+        EDIT = 2,
+        PLACE = 3,
+        LIGHT = 4
+    };
+
+    Type type = CAMERA;
+    uint32_t tick = 0;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::ivec3 block = glm::ivec3(0);
+    // Light events only
+    uint8_t level = 0;
+};
+
+class ReplayRecorder
+{
+public:
+    static const uint16_t DEFAULT_TICK_RATE = 60;
+
+    explicit ReplayRecorder(uint16_t tickRate = DEFAULT_TICK_RATE);
+
+    // Methods
+    // Only stored when the camera moved or turned since the last recorded pose
+    void RecordCamera(uint32_t tick, const glm::vec3 &position, const glm::vec3 &direction);
+    // Removes the block, or places one when active is set
+    void RecordEdit(uint32_t tick, int x, int y, int z, bool active = false);
+    // Makes the block a light source, level 0 removes it
+    void RecordLight(uint32_t tick, int x, int y, int z, int level);
+    // Returns false if the file could not be written
+    bool Save(const std::string &path) const;
+    // The encoded file contents
+    std::vector<uint8_t> Encode() const;
+
+    // Getters
+    uint16_t GetTickRate() const;
+    size_t GetEventCount() const;
+
+private:
+    // Member Variables
+    uint16_t m_tickRate;
+    std::vector<ReplayEvent> m_events;
+    bool m_hasCamera;
+    glm::vec3 m_lastPosition;
+    glm::vec3 m_lastDirection;
+};
+
+class ReplayPlayer
+{
+public:
+    ReplayPlayer();
+
+    // Methods
+    // Returns false if the file is missing, truncated or not a replay
+    bool Load(const std::string &path);
+    bool Decode(const std::vector<uint8_t> &data);
+    // Hand out the events due at or before the tick, in recorded order
+    void TakeEvents(uint32_t tick, std::vector<ReplayEvent> &events);
+    void Rewind();
+    bool IsFinished() const;
+
+    // Getters
+    uint16_t GetTickRate() const;
+    uint32_t GetLastTick() const;
+    const std::vector<ReplayEvent> &GetEvents() const;
+
+private:
+    // Member Variables
+    uint16_t m_tickRate;
+    std::vector<ReplayEvent> m_events;
+    size_t m_next;
+};
+
+#endif /* REPLAY_HPP */
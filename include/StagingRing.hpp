@@ -0,0 +1,63 @@
+#ifndef STAGINGRING_HPP
+#define STAGINGRING_HPP
+
+#include <deque>
+#include <glad/glad.h>
+
+// Ring of upload memory in one staging buffer. Data is written into the ring through an
+// unsynchronized mapping and copied on the GPU into its destination buffer. Regions are only
+// reused once the fence placed after their copies has signaled, so writing never waits on the
+// driver and the ring never grows. A per frame byte budget spreads large uploads over frames.
+class StagingRing
+{
+public:
+    // Constructor/Destructor
+    StagingRing(GLsizeiptr capacity, GLsizeiptr frameBudget);
+    ~StagingRing();
+
+    // Methods
+    // Release regions whose copies have finished and reset the frame budget
+    void BeginFrame();
+    // Fence everything staged this frame
+    void EndFrame();
+    // True if the ring has room for this many bytes this frame without waiting
+    bool CanStage(GLsizeiptr size) const;
+    // Claim budget and ring space for uploads that must land together, like the vertices and
+    // indices of one mesh. The next Stage calls draw from the reservation until it is used up
+    bool Reserve(GLsizeiptr size, int parts);
+    // Copy data through the ring into destination at the given byte offset
+    bool Stage(GLuint destination, GLintptr destinationOffset, const void *data, GLsizeiptr size);
+
+    // Getters
+    GLsizeiptr GetCapacity() const;
+    GLsizeiptr GetBytesThisFrame() const;
+    GLsizeiptr GetFrameBudget() const;
+
+private:
+    // A region of the ring that is in flight until its fence signals
+    struct Region
+    {
+        GLsync fence;
+        GLintptr end;
+    };
+
+    // Methods
+    // Offset where size bytes can be written, or -1
+    GLintptr FindSpace(GLsizeiptr size) const;
+
+    // Member Variables
+    GLuint m_buffer;
+    GLsizeiptr m_capacity;
+    GLsizeiptr m_frameBudget;
+    GLsizeiptr m_bytesThisFrame;
+    // Bytes of the current reservation not staged yet, already counted in m_bytesThisFrame
+    GLsizeiptr m_reserved;
+    // Next byte to write and oldest byte still in use by the GPU
+    GLintptr m_head;
+    GLintptr m_tail;
+    // True while the ring holds data that is not yet released
+    bool m_inUse;
+    std::deque<Region> m_regions;
+};
+
+#endif /* STAGINGRING_HPP */
@@ -0,0 +1,61 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Lightweight scoped tracing. Every thread records complete events into its own fixed size
+// ring buffer, so recording never takes a lock. Tracer::Export() writes everything recorded so
+// far as Chrome trace JSON (chrome://tracing or ui.perfetto.dev).
+//
+// Use TRACE_SCOPE("Name") / TRACE_FUNCTION() at the top of a scope. Names must be string
+// literals (only the pointer is stored). Without ENABLE_TRACING the macros compile to nothing.
+class Tracer
+{
+public:
+    // Events kept per thread, older events are overwritten once a thread records more
+    static const uint32_t EVENTS_PER_THREAD = 1 << 16;
+
+    // Methods
+    static uint64_t NowNanoseconds();
+    static void Record(const char *name, uint64_t startNs, uint64_t endNs);
+    // Write the recorded events as Chrome trace JSON, returns false if the file could not be written
+    static bool Export(const std::string &path);
+    // Recording can be paused at runtime, it is on by default
+    static void SetEnabled(bool enabled);
+    static bool IsEnabled();
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+// Records one event covering its own lifetime
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name) : m_name(name), m_start(Tracer::NowNanoseconds()) {}
+    ~TraceScope()
+    {
+        if (Tracer::IsEnabled())
+        {
+            Tracer::Record(m_name, m_start, Tracer::NowNanoseconds());
+        }
+    }
+
+private:
+    const char *m_name;
+    uint64_t m_start;
+};
+
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_FUNCTION() TRACE_SCOPE(__func__)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_FUNCTION() ((void)0)
+#endif
+
+#endif /* TRACE_HPP */
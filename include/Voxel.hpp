@@ -12,6 +12,15 @@ public:
     // Position should be the corner of the voxel
     Voxel(glm::vec3 position, float width, glm::vec2 texture_position);
 
+    // Floats per vertex: position (3), texture coordinates (2), normal (3), sky and block light (2),
+    // ambient occlusion (1)
+    static const int VERTEX_FLOATS = 11;
+    // Light levels go from 0 to MAX_LIGHT. The voxel's own vertices are fully sky lit, chunk
+    // meshes bake in the light of the voxel in front of each face
+    static const int MAX_LIGHT = 15;
+    // Ambient occlusion of a face corner, from 0 (boxed in by three solid voxels) up to OPEN_CORNER
+    static const int OPEN_CORNER = 3;
+
     // Methods to get list of verticies and indexes
     std::vector<GLfloat> GetVertexData();
     std::vector<GLfloat> GetFrontVertices();
@@ -24,6 +33,8 @@ public:
     void GetIndexData(std::vector<GLuint> &indices, GLuint &nextIndex);
 
     glm::vec3 GetPosition();
+    // Atlas rectangle (u0, v0, u1, v1) of the voxel's texture
+    glm::vec4 GetTextureBounds();
 
     void SetPosition(glm::vec3 position) { m_position = position; }
 
@@ -3,17 +3,24 @@ layout (location = 0) in vec3 aPos;
 layout(location=1) in vec2 textureCoords;
 layout(location=2) in vec3 aNormal;
 
+// Per frame values shared by every program
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightPosition;
+    vec4 lightColor;
+    vec4 cameraPosition;
+};
+
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
-// Pass vertex colors to the fragment shader
-out vec3 v_vertexColors;
 out vec2 v_textureCoords;
 
 void main()
 {
     v_textureCoords = textureCoords;
 
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = viewProjection * (model * vec4(aPos, 1.0f));
 }
\ No newline at end of file
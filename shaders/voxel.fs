@@ -1,42 +1,39 @@
 #version 410 core
 out vec4 FragColor;
 
-uniform vec3 lightColor;  // Light color
+// Per frame values shared by every program
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightPosition;
+    vec4 lightColor;
+    vec4 cameraPosition;
+};
+
 uniform sampler2D u_Texture;  // Texture sampler
-uniform vec3 lightPos;  
-uniform vec3 viewPos;
 
 in vec2 v_textureCoords;  // Texture coordinates
-in vec3 v_normal;  // Normal vector
-in vec3 v_fragPos;  // Fragment position
+in vec2 v_light;  // Sky and block light levels, 0 to 15
+in float v_occlusion;  // Baked ambient occlusion, 1 for open corners
+
+// Brightness of each light level, 0.8 of the level above it down to a floor so caves are not black
+const float LIGHT_CURVE[16] = float[](0.05, 0.05, 0.055, 0.069, 0.086, 0.107, 0.134, 0.168,
+                                      0.210, 0.262, 0.328, 0.410, 0.512, 0.640, 0.800, 1.0);
+// Warm tint of block light
+const vec3 BLOCK_LIGHT_COLOR = vec3(1.0, 0.85, 0.6);
 
 void main()
 {
-    // Ambient lighting calculation
-    float ambientStrength = 0.3;  // Control ambient intensity
-    vec3 ambient = ambientStrength * lightColor;
-
-    // Diffuse lighting calculation
-    vec3 norm = normalize(v_normal);
-    // Calculate the light direction relative to the fragment position
-    vec3 lightDir = normalize(lightPos - v_fragPos);
-    float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
-
-    // Specular lighting calculation
-    float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - v_fragPos);
-    vec3 reflectDir = reflect(-lightDir, norm);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;
-
+    // The levels are whole numbers on every vertex of a face
+    float sky = LIGHT_CURVE[clamp(int(v_light.x + 0.5), 0, 15)];
+    float block = LIGHT_CURVE[clamp(int(v_light.y + 0.5), 0, 15)];
+    vec3 light = max(sky * lightColor.rgb, block * BLOCK_LIGHT_COLOR) * v_occlusion;
 
     // Sample the texture color
     vec4 texColor = texture(u_Texture, v_textureCoords);
 
-    // Combine ambient lighting with the texture color
-    vec3 resultColor = texColor.rgb * (ambient + diffuse + specular);
-
     // Set the final fragment color, preserving the texture's alpha
-    FragColor = vec4(resultColor, texColor.a);
-}
\ No newline at end of file
+    FragColor = vec4(texColor.rgb * light, texColor.a);
+}
@@ -2,21 +2,36 @@
 layout(location = 0) in vec3 aPos;
 layout(location=1) in vec2 textureCoords;
 layout(location=2) in vec3 aNormal;
+layout(location=3) in vec2 aLight;
+layout(location=4) in float aOcclusion;
+
+// Per frame values shared by every program
+layout(std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 lightPosition;
+    vec4 lightColor;
+    vec4 cameraPosition;
+};
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
 
-// Pass vertex colors to the fragment shader
 out vec2 v_textureCoords;
-out vec3 v_normal;
-out vec3 v_fragPos;
+// Sky and block light levels baked into the mesh
+out vec2 v_light;
+out float v_occlusion;
+
+// Brightness of a face corner by how many solid voxels box it in
+const float OCCLUSION_CURVE[4] = float[](0.5, 0.65, 0.8, 1.0);
 
 void main()
 {
     v_textureCoords = textureCoords;
-    v_fragPos = vec3(model * vec4(aPos, 1.0));
-    v_normal = aNormal;
+    v_light = aLight;
+    // Interpolated across the face, that gradient is the occlusion
+    v_occlusion = OCCLUSION_CURVE[clamp(int(aOcclusion + 0.5), 0, 3)];
 
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
-}
\ No newline at end of file
+	gl_Position = viewProjection * (model * vec4(aPos, 1.0));
+}
@@ -0,0 +1,199 @@
+#include "BufferAllocator.hpp"
+#include <iterator>
+
+BufferAllocator::BufferAllocator(uint32_t capacity)
+{
+    m_capacity = 0;
+    m_used = 0;
+    Grow(capacity);
+}
+
+uint32_t BufferAllocator::Allocate(uint32_t size)
+{
+    if (size == 0)
+    {
+        return INVALID_OFFSET;
+    }
+
+    // Smallest free block that still fits
+    auto fit = m_freeBySize.lower_bound(size);
+    if (fit == m_freeBySize.end())
+    {
+        return INVALID_OFFSET;
+    }
+
+    const uint32_t offset = fit->second;
+    const uint32_t blockSize = fit->first;
+    EraseFreeBlock(m_freeByOffset.find(offset));
+    if (blockSize > size)
+    {
+        InsertFreeBlock(offset + size, blockSize - size);
+    }
+
+    m_allocations[offset] = size;
+    m_used += size;
+    return offset;
+}
+
+void BufferAllocator::Free(uint32_t offset)
+{
+    auto allocation = m_allocations.find(offset);
+    if (allocation == m_allocations.end())
+    {
+        return;
+    }
+
+    uint32_t start = offset;
+    uint32_t size = allocation->second;
+    m_used -= size;
+    m_allocations.erase(allocation);
+
+    // Coalesce with the free block after us
+    auto next = m_freeByOffset.find(start + size);
+    if (next != m_freeByOffset.end())
+    {
+        size += next->second;
+        EraseFreeBlock(next);
+    }
+
+    // And with the free block before us
+    auto previous = m_freeByOffset.lower_bound(start);
+    if (previous != m_freeByOffset.begin())
+    {
+        --previous;
+        if (previous->first + previous->second == start)
+        {
+            start = previous->first;
+            size += previous->second;
+            EraseFreeBlock(previous);
+        }
+    }
+
+    InsertFreeBlock(start, size);
+}
+
+void BufferAllocator::Grow(uint32_t newCapacity)
+{
+    if (newCapacity <= m_capacity)
+    {
+        return;
+    }
+
+    uint32_t start = m_capacity;
+    uint32_t size = newCapacity - m_capacity;
+
+    // Extend a free block that runs to the old end
+    if (!m_freeByOffset.empty())
+    {
+        auto last = std::prev(m_freeByOffset.end());
+        if (last->first + last->second == m_capacity)
+        {
+            start = last->first;
+            size += last->second;
+            EraseFreeBlock(last);
+        }
+    }
+
+    InsertFreeBlock(start, size);
+    m_capacity = newCapacity;
+}
+
+std::vector<BufferAllocator::Move> BufferAllocator::Defragment()
+{
+    std::vector<Move> moves;
+    std::map<uint32_t, uint32_t> packed;
+    uint32_t cursor = 0;
+
+    for (const auto &allocation : m_allocations)
+    {
+        moves.push_back({allocation.first, cursor, allocation.second});
+        packed[cursor] = allocation.second;
+        cursor += allocation.second;
+    }
+
+    m_allocations.swap(packed);
+    m_freeByOffset.clear();
+    m_freeBySize.clear();
+    if (cursor < m_capacity)
+    {
+        InsertFreeBlock(cursor, m_capacity - cursor);
+    }
+    return moves;
+}
+
+void BufferAllocator::Clear()
+{
+    m_allocations.clear();
+    m_freeByOffset.clear();
+    m_freeBySize.clear();
+    m_used = 0;
+    if (m_capacity > 0)
+    {
+        InsertFreeBlock(0, m_capacity);
+    }
+}
+
+float BufferAllocator::GetFragmentation() const
+{
+    const uint32_t freeSpace = m_capacity - m_used;
+    if (freeSpace == 0)
+    {
+        return 0.0f;
+    }
+    return 1.0f - (float)GetLargestFreeBlock() / (float)freeSpace;
+}
+
+uint32_t BufferAllocator::GetCapacity() const
+{
+    return m_capacity;
+}
+
+uint32_t BufferAllocator::GetUsed() const
+{
+    return m_used;
+}
+
+uint32_t BufferAllocator::GetLargestFreeBlock() const
+{
+    if (m_freeBySize.empty())
+    {
+        return 0;
+    }
+    return std::prev(m_freeBySize.end())->first;
+}
+
+uint32_t BufferAllocator::GetAllocationSize(uint32_t offset) const
+{
+    auto allocation = m_allocations.find(offset);
+    return allocation == m_allocations.end() ? 0 : allocation->second;
+}
+
+size_t BufferAllocator::GetAllocationCount() const
+{
+    return m_allocations.size();
+}
+
+size_t BufferAllocator::GetFreeBlockCount() const
+{
+    return m_freeByOffset.size();
+}
+
+void BufferAllocator::InsertFreeBlock(uint32_t offset, uint32_t size)
+{
+    m_freeByOffset[offset] = size;
+    m_freeBySize.insert({size, offset});
+}
+
+void BufferAllocator::EraseFreeBlock(std::map<uint32_t, uint32_t>::iterator block)
+{
+    auto range = m_freeBySize.equal_range(block->second);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (it->second == block->first)
+        {
+            m_freeBySize.erase(it);
+            break;
+        }
+    }
+    m_freeByOffset.erase(block);
+}
@@ -57,6 +57,18 @@ void Camera::SetCameraEyePosition(float x, float y, float z){
     m_eyePosition.z = z;
 }
 
+void Camera::SetViewDirection(const glm::vec3 &direction){
+    m_viewDirection = direction;
+}
+
+glm::vec3 Camera::GetEyePosition() const {
+    return m_eyePosition;
+}
+
+glm::vec3 Camera::GetViewDirection() const {
+    return m_viewDirection;
+}
+
 float Camera::GetEyeXPosition() {
     return m_eyePosition.x;
 }
@@ -66,7 +78,7 @@ float Camera::GetEyeYPosition() {
 }
 
 float Camera::GetEyeZPosition() {
-    return -m_eyePosition.z;
+    return m_eyePosition.z;
 }
 
 float Camera::GetViewXDirection(){
@@ -1,6 +1,376 @@
 #include "Chunk.hpp"
+#include "MemoryStats.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
+namespace
+{
+    // The chunk plus a one voxel border taken from the neighbors
+    const int PADDED_SIZE = Chunk::CHUNK_SIZE + 2;
+
+    int PaddedIndex(int x, int y, int z)
+    {
+        return ((x + 1) * PADDED_SIZE + (y + 1)) * PADDED_SIZE + (z + 1);
+    }
+
+    // Cube faces in the order and layout of Voxel::Get*Vertices: front, back, left, right, top, bottom
+    struct FaceTemplate
+    {
+        int dx, dy, dz;
+        GLfloat corners[4][3];
+        GLfloat normal[3];
+    };
+
+    const FaceTemplate FACES[6] = {
+        {0, 0, 1, {{0, 1, 1}, {1, 1, 1}, {1, 0, 1}, {0, 0, 1}}, {0, 0, 1}},
+        {0, 0, -1, {{1, 1, 0}, {0, 1, 0}, {0, 0, 0}, {1, 0, 0}}, {0, 0, -1}},
+        {-1, 0, 0, {{0, 1, 0}, {0, 1, 1}, {0, 0, 1}, {0, 0, 0}}, {-1, 0, 0}},
+        {1, 0, 0, {{1, 1, 1}, {1, 1, 0}, {1, 0, 0}, {1, 0, 1}}, {1, 0, 0}},
+        {0, 1, 0, {{0, 1, 0}, {1, 1, 0}, {1, 1, 1}, {0, 1, 1}}, {0, 1, 0}},
+        {0, -1, 0, {{0, 0, 1}, {1, 0, 1}, {1, 0, 0}, {0, 0, 0}}, {0, -1, 0}},
+    };
+
+    const int CHUNK_VOXELS = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+
+    // Atlas tile of the terrain blocks
+    const glm::vec2 TERRAIN_TEXTURE(9, 7);
+    // Terrain density at or above the threshold is solid. Adjust it to control the terrain height
+    const double TERRAIN_THRESHOLD = 0.56;
+
+    // Density of the generated terrain at a local position of the chunk at chunkX, chunkZ. Kept in
+    // chunk local form so every caller gets the generator's values bit for bit
+    double TerrainNoise(const siv::PerlinNoise &perlin, int x, int y, int z, int chunkX, int chunkZ)
+    {
+        return perlin.noise3D_01(
+            (y * 0.01),
+            (x * 0.01) + (chunkX * Chunk::CHUNK_SIZE * .01),
+            (z * 0.01) + (chunkZ * Chunk::CHUNK_SIZE * .01));
+    }
+
+    // The voxels that shade a face corner, relative to the voxel of the face: the two beside the
+    // corner and the one diagonal to it, all in the layer in front of the face
+    void GetCornerNeighbors(int face, int corner, int neighbors[3][3])
+    {
+        const FaceTemplate &tpl = FACES[face];
+        const int front[3] = {tpl.dx, tpl.dy, tpl.dz};
+        int side = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            for (int axis = 0; axis < 3; axis++)
+            {
+                neighbors[i][axis] = front[axis];
+            }
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (front[axis] == 0)
+            {
+                const int toward = tpl.corners[corner][axis] > 0 ? 1 : -1;
+                neighbors[side][axis] += toward;
+                neighbors[2][axis] += toward;
+                side++;
+            }
+        }
+    }
+
+    // Classic 4 level corner occlusion, two solid sides hide the corner whatever the diagonal is
+    int CornerOcclusion(bool side1, bool side2, bool diagonal)
+    {
+        if (side1 && side2)
+        {
+            return 0;
+        }
+        return Voxel::OPEN_CORNER - (side1 + side2 + diagonal);
+    }
+
+    // Quads are split along the diagonal between the brighter pair of opposite corners, otherwise
+    // the occlusion is interpolated along the other diagonal and the shading turns anisotropic
+    bool FlipQuad(const int occlusion[4])
+    {
+        return occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3];
+    }
+
+    int VoxelIndex(int x, int y, int z)
+    {
+        return (x * Chunk::CHUNK_SIZE + y) * Chunk::CHUNK_SIZE + z;
+    }
+
+    // Overwrite the light and occlusion of the face just appended, its 4 vertices share the light
+    void SetFaceShading(std::vector<GLfloat> &vertices, uint8_t light, const int occlusion[4])
+    {
+        GLfloat *vertex = vertices.data() + vertices.size() - 4 * Voxel::VERTEX_FLOATS;
+        for (int corner = 0; corner < 4; corner++, vertex += Voxel::VERTEX_FLOATS)
+        {
+            vertex[8] = light >> 4;
+            vertex[9] = light & 15;
+            vertex[10] = occlusion[corner];
+        }
+    }
+
+    // 64 bit FNV-1a, folded in piece by piece
+    void HashBytes(uint64_t &hash, const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+    }
+
+    // Representative block of a level of detail cell of scale^3 voxels: solid when at least half of
+    // its voxels are
+    bool CellSolid(const Chunk &chunk, int scale, int cellX, int cellY, int cellZ)
+    {
+        const uint16_t bits = (uint16_t)(((1 << scale) - 1) << (cellY * scale));
+        int count = 0;
+        for (int x = cellX * scale; x < (cellX + 1) * scale; x++)
+        {
+            for (int z = cellZ * scale; z < (cellZ + 1) * scale; z++)
+            {
+                count += __builtin_popcount(chunk.GetColumnMask(x, z) & bits);
+            }
+        }
+        return count * 2 >= scale * scale * scale;
+    }
+
+    // Brightest sky and block light among the voxels of a cell, each channel on its own
+    uint8_t CellLight(const Chunk &chunk, int scale, int cellX, int cellY, int cellZ)
+    {
+        int sky = 0, block = 0;
+        for (int x = cellX * scale; x < (cellX + 1) * scale; x++)
+        {
+            for (int y = cellY * scale; y < (cellY + 1) * scale; y++)
+            {
+                for (int z = cellZ * scale; z < (cellZ + 1) * scale; z++)
+                {
+                    const uint8_t light = chunk.GetLight(x, y, z);
+                    sky = std::max(sky, light >> 4);
+                    block = std::max(block, light & 15);
+                }
+            }
+        }
+        return (uint8_t)((sky << 4) | block);
+    }
+
+    // Compressed chunks, stage 1: occupancy run length encoded along the y columns, columns in
+    // x, z order. The first byte is the value of the first voxel, then one byte per run of
+    // alternating values. Longer runs are split by a zero length run of the other value
+    void EncodeColumnRuns(const uint8_t *solid, std::vector<uint8_t> &runs)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        runs.clear();
+        uint8_t value = solid[0];
+        runs.push_back(value);
+        int run = 0;
+        for (int x = 0; x < size; x++)
+        {
+            for (int z = 0; z < size; z++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    if (solid[VoxelIndex(x, y, z)] != value || run == 255)
+                    {
+                        runs.push_back(run);
+                        if (solid[VoxelIndex(x, y, z)] == value)
+                        {
+                            runs.push_back(0);
+                        }
+                        value = solid[VoxelIndex(x, y, z)];
+                        run = 0;
+                    }
+                    run++;
+                }
+            }
+        }
+        runs.push_back(run);
+    }
+
+    bool DecodeColumnRuns(const std::vector<uint8_t> &runs, uint8_t *solid)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        if (runs.empty())
+        {
+            return false;
+        }
+        uint8_t value = runs[0] != 0;
+        size_t next = 1;
+        int remaining = 0;
+        for (int x = 0; x < size; x++)
+        {
+            for (int z = 0; z < size; z++)
+            {
+                for (int y = 0; y < size; y++)
+                {
+                    while (remaining == 0)
+                    {
+                        if (next >= runs.size())
+                        {
+                            return false;
+                        }
+                        if (next > 1)
+                        {
+                            value = !value;
+                        }
+                        remaining = runs[next++];
+                    }
+                    solid[VoxelIndex(x, y, z)] = value;
+                    remaining--;
+                }
+            }
+        }
+        return remaining == 0 && next == runs.size();
+    }
+
+    // Stage 2: LZ77 with LZ4 style sequences, which folds the run patterns repeated by neighbouring
+    // columns. A sequence is a token (literal count << 4 | match length - 4, 15 continues in
+    // following bytes of 255), the literals, then a u16 match distance and the rest of the match
+    // length. The last sequence has literals only
+    const int LZ_MIN_MATCH = 4;
+    const int LZ_HASH_BITS = 10;
+
+    void WriteLength(std::vector<uint8_t> &out, size_t length)
+    {
+        while (length >= 255)
+        {
+            out.push_back(255);
+            length -= 255;
+        }
+        out.push_back(length);
+    }
+
+    void LzCompress(const std::vector<uint8_t> &input, std::vector<uint8_t> &output)
+    {
+        output.clear();
+        int table[1 << LZ_HASH_BITS];
+        std::fill(table, table + (1 << LZ_HASH_BITS), -1);
+        const int size = (int)input.size();
+        int literalStart = 0;
+        int position = 0;
+        while (position + LZ_MIN_MATCH <= size)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, &input[position], 4);
+            const uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+            const int candidate = table[hash];
+            table[hash] = position;
+            if (candidate < 0 || position - candidate > 0xFFFF || std::memcmp(&input[candidate], &input[position], 4) != 0)
+            {
+                position++;
+                continue;
+            }
+            int length = LZ_MIN_MATCH;
+            while (position + length < size && input[candidate + length] == input[position + length])
+            {
+                length++;
+            }
+
+            const size_t literals = position - literalStart;
+            const size_t extra = length - LZ_MIN_MATCH;
+            output.push_back((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(extra, 15));
+            if (literals >= 15)
+            {
+                WriteLength(output, literals - 15);
+            }
+            output.insert(output.end(), input.begin() + literalStart, input.begin() + position);
+            const int distance = position - candidate;
+            output.push_back(distance & 0xFF);
+            output.push_back(distance >> 8);
+            if (extra >= 15)
+            {
+                WriteLength(output, extra - 15);
+            }
+            position += length;
+            literalStart = position;
+        }
+
+        const size_t literals = size - literalStart;
+        output.push_back(std::min<size_t>(literals, 15) << 4);
+        if (literals >= 15)
+        {
+            WriteLength(output, literals - 15);
+        }
+        output.insert(output.end(), input.begin() + literalStart, input.end());
+    }
+
+    // Compressed form of a chunk whose voxels are all solid or all empty
+    std::vector<uint8_t> PackUniform(bool active)
+    {
+        uint8_t solid[CHUNK_VOXELS];
+        std::memset(solid, active, CHUNK_VOXELS);
+        std::vector<uint8_t> runs, packed;
+        EncodeColumnRuns(solid, runs);
+        LzCompress(runs, packed);
+        return packed;
+    }
+
+    bool ReadLength(const std::vector<uint8_t> &input, size_t &cursor, size_t &length)
+    {
+        uint8_t byte;
+        do
+        {
+            if (cursor >= input.size())
+            {
+                return false;
+            }
+            byte = input[cursor++];
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    bool LzDecompress(const std::vector<uint8_t> &input, std::vector<uint8_t> &output)
+    {
+        output.clear();
+        size_t cursor = 0;
+        while (cursor < input.size())
+        {
+            const uint8_t token = input[cursor++];
+            size_t literals = token >> 4;
+            if (literals == 15 && !ReadLength(input, cursor, literals))
+            {
+                return false;
+            }
+            if (literals > input.size() - cursor)
+            {
+                return false;
+            }
+            output.insert(output.end(), input.begin() + cursor, input.begin() + cursor + literals);
+            cursor += literals;
+            if (cursor == input.size())
+            {
+                return true;
+            }
+
+            if (input.size() - cursor < 2)
+            {
+                return false;
+            }
+            const size_t distance = input[cursor] | (input[cursor + 1] << 8);
+            cursor += 2;
+            size_t length = token & 15;
+            if (length == 15 && !ReadLength(input, cursor, length))
+            {
+                return false;
+            }
+            length += LZ_MIN_MATCH;
+            if (distance == 0 || distance > output.size())
+            {
+                return false;
+            }
+            // Matches may overlap their own output, copy byte by byte
+            size_t from = output.size() - distance;
+            for (size_t i = 0; i < length; i++)
+            {
+                output.push_back(output[from + i]);
+            }
+        }
+        return false;
+    }
+}
+
 Chunk::Chunk()
 {
     m_xOffset = 0;
@@ -10,10 +380,19 @@ Chunk::Chunk()
     m_rightNeighbor = nullptr;
     m_backNeighbor = nullptr;
     m_leftNeighbor = nullptr;
+    m_cullingDirty = true;
+    m_compressed = false;
+    m_accessed = true;
+    m_light.assign(CHUNK_VOXELS, 0);
+    std::fill(std::begin(m_columnMasks), std::end(m_columnMasks), 0);
+    std::fill(std::begin(m_columnHeights), std::end(m_columnHeights), 0);
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    MemoryStats::Add(MEMORY_CHUNK_LIGHT, m_light.size());
 }
 
 Chunk::Chunk(const siv::PerlinNoise perlin, int xOffset, int zOffset)
 {
+    TRACE_SCOPE("Chunk::Generate");
     m_xOffset = xOffset * CHUNK_SIZE;
     m_zOffset = zOffset * CHUNK_SIZE;
     // Initialize the m_Blocks vector
@@ -26,34 +405,70 @@ Chunk::Chunk(const siv::PerlinNoise perlin, int xOffset, int zOffset)
             for (int z = 0; z < CHUNK_SIZE; ++z)
             {
                 // Generate terrain using Perlin noise with offsets
-                const double noise = perlin.noise3D_01(
-                    (y * 0.01),
-                    (x * 0.01) + (xOffset * CHUNK_SIZE * .01),
-                    (z * 0.01) + (zOffset * CHUNK_SIZE * .01));
-
-                // Define the threshold value for terrain generation
-                double threshold = 0.56; // Adjust this value to control the terrain height
+                const double noise = TerrainNoise(perlin, x, y, z, xOffset, zOffset);
 
                 // Create and assign a new Voxel
-                Voxel v(glm::vec3(x + m_xOffset, y, z + m_zOffset), 1, glm::vec2(9, 7));
+                Voxel v(glm::vec3(x + m_xOffset, y, z + m_zOffset), 1, TERRAIN_TEXTURE);
                 m_Voxels[x][y][z] = v;
 
-                if (noise < threshold)
+                if (noise < TERRAIN_THRESHOLD)
                 {
                     m_Voxels[x][y][z].SetActive(false);
                 }
             }
         }
     }
+    // Column index of the new terrain
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        for (int z = 0; z < CHUNK_SIZE; ++z)
+        {
+            uint16_t mask = 0;
+            for (int y = 0; y < CHUNK_SIZE; ++y)
+            {
+                mask |= (uint16_t)m_Voxels[x][y][z].IsActive() << y;
+            }
+            m_columnMasks[x * CHUNK_SIZE + z] = mask;
+            UpdateColumnHeight(x * CHUNK_SIZE + z);
+        }
+    }
+
+    m_frontNeighbor = nullptr;
+    m_rightNeighbor = nullptr;
+    m_backNeighbor = nullptr;
+    m_leftNeighbor = nullptr;
+    m_cullingDirty = true;
+    m_compressed = false;
+    m_accessed = true;
+    m_light.assign(CHUNK_VOXELS, 0);
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    MemoryStats::Add(MEMORY_CHUNK_LIGHT, m_light.size());
+}
+
+Chunk::Chunk(int xOffset, int zOffset)
+{
+    m_xOffset = xOffset * CHUNK_SIZE;
+    m_zOffset = zOffset * CHUNK_SIZE;
+    AllocateVoxels();
 
     m_frontNeighbor = nullptr;
     m_rightNeighbor = nullptr;
     m_backNeighbor = nullptr;
     m_leftNeighbor = nullptr;
+    m_cullingDirty = true;
+    m_compressed = false;
+    m_accessed = true;
+    m_light.assign(CHUNK_VOXELS, 0);
+    std::fill(std::begin(m_columnMasks), std::end(m_columnMasks), (uint16_t)((1 << CHUNK_SIZE) - 1));
+    std::fill(std::begin(m_columnHeights), std::end(m_columnHeights), (uint8_t)CHUNK_SIZE);
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    MemoryStats::Add(MEMORY_CHUNK_LIGHT, m_light.size());
 }
 
 Chunk::~Chunk()
 {
+    MemoryStats::Remove(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    MemoryStats::Remove(MEMORY_CHUNK_LIGHT, m_light.size());
 }
 
 void Chunk::SetFrontNeighbor(Chunk *chunk)
@@ -78,54 +493,540 @@ void Chunk::UpdateBlock(int x, int y, int z, bool isActive)
     x -= m_xOffset;
     z -= m_zOffset;
 
-    std::cout << "Getting Voxel at " << x << ", " << y << ", " << z << std::endl;
-
     if (x >= CHUNK_SIZE || y >= CHUNK_SIZE || z >= CHUNK_SIZE ||
         x < 0 || y < 0 || z < 0)
     {
-        std::cout << "Voxel is out of bounds " << std::endl;
+        std::cout << "Voxel is out of bounds " << std::endl;
+    }
+    else
+    {
+        Touch();
+        m_Voxels[x][y][z].SetActive(isActive);
+        m_cullingDirty = true;
+        const int column = x * CHUNK_SIZE + z;
+        m_columnMasks[column] = isActive ? (m_columnMasks[column] | (1 << y)) : (m_columnMasks[column] & ~(1 << y));
+        UpdateColumnHeight(column);
+    }
+}
+
+const std::vector<GLfloat> Chunk::GetVertexData(int xOffset, int zOffset, std::vector<GLuint> &indices, GLuint &baseIndex)
+{
+    TRACE_SCOPE("Chunk::Mesh");
+    std::vector<GLfloat> vertices;
+
+    xOffset = xOffset * CHUNK_SIZE;
+    zOffset = zOffset * CHUNK_SIZE;
+    Touch();
+
+    // Iterate over the blocks in the chunk
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+                Voxel currBlock = m_Voxels[x][y][z];
+                if (currBlock.IsActive())
+                {
+                    std::vector<GLfloat> cubeVertices = GenerateCubeVertices(x, y, z, indices, baseIndex);
+                    vertices.insert(vertices.end(), cubeVertices.begin(), cubeVertices.end());
+                }
+            }
+        }
+    }
+
+    return vertices;
+}
+
+void Chunk::BuildMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices, int skirtSides)
+{
+    TRACE_SCOPE("Chunk::BuildMesh");
+    vertices.clear();
+    indices.clear();
+
+    // Occupancy with a border, so every neighbor test is a plain array read. Missing neighbor
+    // chunks and the space above and below the chunk count as empty, like HasNeighborOnFace.
+    // Everything comes from the column masks, so neither this chunk nor its neighbors are
+    // decompressed to be meshed
+    uint8_t solid[PADDED_SIZE * PADDED_SIZE * PADDED_SIZE] = {};
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            const uint16_t mask = m_columnMasks[x * CHUNK_SIZE + z];
+            for (int y = 0; y < CHUNK_SIZE; y++)
+            {
+                solid[PaddedIndex(x, y, z)] = (mask >> y) & 1;
+            }
+        }
+    }
+    Chunk *const neighbors[4] = {m_rightNeighbor, m_leftNeighbor, m_backNeighbor, m_frontNeighbor};
+    auto neighborMask = [&](int n, int x, int z)
+    {
+        if (neighbors[n] == nullptr || (skirtSides & (1 << n)))
+        {
+            return (uint16_t)0;
+        }
+        return neighbors[n]->m_columnMasks[x * CHUNK_SIZE + z];
+    };
+    for (int i = 0; i < CHUNK_SIZE; i++)
+    {
+        const uint16_t masks[4] = {neighborMask(0, CHUNK_SIZE - 1, i), neighborMask(1, 0, i),
+                                   neighborMask(2, i, CHUNK_SIZE - 1), neighborMask(3, i, 0)};
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            solid[PaddedIndex(-1, y, i)] = (masks[0] >> y) & 1;
+            solid[PaddedIndex(CHUNK_SIZE, y, i)] = (masks[1] >> y) & 1;
+            solid[PaddedIndex(i, y, -1)] = (masks[2] >> y) & 1;
+            solid[PaddedIndex(i, y, CHUNK_SIZE)] = (masks[3] >> y) & 1;
+        }
+    }
+
+    // The corner columns come from the diagonal chunks, occlusion at the chunk's vertical edges needs them
+    const int diagonals[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+    for (const int *diagonal : diagonals)
+    {
+        Chunk *chunk = GetNeighbor(diagonal[0], diagonal[1]);
+        if (chunk == nullptr)
+        {
+            continue;
+        }
+        const int fromX = diagonal[0] < 0 ? CHUNK_SIZE - 1 : 0;
+        const int fromZ = diagonal[1] < 0 ? CHUNK_SIZE - 1 : 0;
+        const int toX = diagonal[0] < 0 ? -1 : CHUNK_SIZE;
+        const int toZ = diagonal[1] < 0 ? -1 : CHUNK_SIZE;
+        const uint16_t mask = chunk->m_columnMasks[fromX * CHUNK_SIZE + fromZ];
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            solid[PaddedIndex(toX, y, toZ)] = (mask >> y) & 1;
+        }
+    }
+
+    // Light with the same border. Above the chunk and past the loaded window is open sky
+    const uint8_t SKY = Voxel::MAX_LIGHT << 4;
+    uint8_t light[PADDED_SIZE * PADDED_SIZE * PADDED_SIZE];
+    std::memset(light, SKY, sizeof(light));
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int z = 0; z < CHUNK_SIZE; z++)
+        {
+            light[PaddedIndex(x, -1, z)] = 0;
+            for (int y = 0; y < CHUNK_SIZE; y++)
+            {
+                light[PaddedIndex(x, y, z)] = m_light[VoxelIndex(x, y, z)];
+            }
+        }
+    }
+    for (int y = 0; y < CHUNK_SIZE; y++)
+    {
+        for (int i = 0; i < CHUNK_SIZE; i++)
+        {
+            if (neighbors[0] != nullptr)
+            {
+                light[PaddedIndex(-1, y, i)] = neighbors[0]->GetLight(CHUNK_SIZE - 1, y, i);
+            }
+            if (neighbors[1] != nullptr)
+            {
+                light[PaddedIndex(CHUNK_SIZE, y, i)] = neighbors[1]->GetLight(0, y, i);
+            }
+            if (neighbors[2] != nullptr)
+            {
+                light[PaddedIndex(i, y, -1)] = neighbors[2]->GetLight(i, y, CHUNK_SIZE - 1);
+            }
+            if (neighbors[3] != nullptr)
+            {
+                light[PaddedIndex(i, y, CHUNK_SIZE)] = neighbors[3]->GetLight(i, y, 0);
+            }
+        }
+    }
+
+    // First pass finds the exposed faces so the output is sized once
+    int faceOffsets[6];
+    int cornerOffsets[6][4][3];
+    for (int face = 0; face < 6; face++)
+    {
+        faceOffsets[face] = PaddedIndex(FACES[face].dx, FACES[face].dy, FACES[face].dz) - PaddedIndex(0, 0, 0);
+        for (int corner = 0; corner < 4; corner++)
+        {
+            int neighbors[3][3];
+            GetCornerNeighbors(face, corner, neighbors);
+            for (int i = 0; i < 3; i++)
+            {
+                cornerOffsets[face][corner][i] = PaddedIndex(neighbors[i][0], neighbors[i][1], neighbors[i][2]) - PaddedIndex(0, 0, 0);
+            }
+        }
+    }
+    uint8_t exposed[CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE];
+    size_t faceCount = 0;
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+                const int index = PaddedIndex(x, y, z);
+                uint8_t mask = 0;
+                if (solid[index])
+                {
+                    for (int face = 0; face < 6; face++)
+                    {
+                        mask |= (solid[index + faceOffsets[face]] == 0) << face;
+                    }
+                }
+                exposed[(x * CHUNK_SIZE + y) * CHUNK_SIZE + z] = mask;
+                faceCount += __builtin_popcount(mask);
+            }
+        }
+    }
+
+    vertices.resize(faceCount * 4 * Voxel::VERTEX_FLOATS);
+    indices.resize(faceCount * 6);
+    GLfloat *vertex = vertices.data();
+    GLuint *index = indices.data();
+    GLuint baseIndex = 0;
+
+    // Every voxel is a terrain block at its world position, as AllocateVoxels builds them.
+    // Corner order matches the reference: (u0, v1), (u1, v1), (u1, v0), (u0, v0)
+    const glm::vec4 uv = GetTerrainTextureBounds();
+    const GLfloat cornerUVs[4][2] = {{uv.x, uv.w}, {uv.z, uv.w}, {uv.z, uv.y}, {uv.x, uv.y}};
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+                const uint8_t mask = exposed[(x * CHUNK_SIZE + y) * CHUNK_SIZE + z];
+                if (mask == 0)
+                {
+                    continue;
+                }
+                const glm::vec3 position((GLfloat)(x + m_xOffset), (GLfloat)y, (GLfloat)(z + m_zOffset));
+
+                for (int face = 0; face < 6; face++)
+                {
+                    if ((mask & (1 << face)) == 0)
+                    {
+                        continue;
+                    }
+                    const FaceTemplate &tpl = FACES[face];
+                    const int padded = PaddedIndex(x, y, z);
+                    const uint8_t faceLight = light[padded + faceOffsets[face]];
+                    int occlusion[4];
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        const int *neighbors = cornerOffsets[face][corner];
+                        occlusion[corner] = CornerOcclusion(solid[padded + neighbors[0]], solid[padded + neighbors[1]],
+                                                            solid[padded + neighbors[2]]);
+                    }
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        *vertex++ = position.x + tpl.corners[corner][0];
+                        *vertex++ = position.y + tpl.corners[corner][1];
+                        *vertex++ = position.z + tpl.corners[corner][2];
+                        *vertex++ = cornerUVs[corner][0];
+                        *vertex++ = cornerUVs[corner][1];
+                        *vertex++ = tpl.normal[0];
+                        *vertex++ = tpl.normal[1];
+                        *vertex++ = tpl.normal[2];
+                        *vertex++ = faceLight >> 4;
+                        *vertex++ = faceLight & 15;
+                        *vertex++ = occlusion[corner];
+                    }
+                    // Same split as AddFace
+                    const GLuint turn = FlipQuad(occlusion) ? 1 : 0;
+                    *index++ = baseIndex + turn;
+                    *index++ = baseIndex + turn + 1;
+                    *index++ = baseIndex + turn + 2;
+                    *index++ = baseIndex + turn + 2;
+                    *index++ = baseIndex + (turn + 3) % 4;
+                    *index++ = baseIndex + turn;
+                    baseIndex += 4;
+                }
+            }
+        }
+    }
+}
+
+void Chunk::BuildLodMesh(int level, int skirtSides, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices)
+{
+    TRACE_SCOPE("Chunk::BuildLodMesh");
+    vertices.clear();
+    indices.clear();
+    const int scale = 1 << level;
+    const int cells = CHUNK_SIZE / scale;
+    const int padded = cells + 2;
+    auto cellIndex = [&](int x, int y, int z)
+    {
+        return ((x + 1) * padded + (y + 1)) * padded + (z + 1);
+    };
+
+    // Cells with a one cell border taken from the neighbors, downsampled the same way. Skirt sides,
+    // missing neighbors and the space above and below the chunk count as empty
+    std::vector<uint8_t> solid(padded * padded * padded, 0);
+    for (int x = 0; x < cells; x++)
+    {
+        for (int y = 0; y < cells; y++)
+        {
+            for (int z = 0; z < cells; z++)
+            {
+                solid[cellIndex(x, y, z)] = CellSolid(*this, scale, x, y, z);
+            }
+        }
+    }
+    Chunk *const neighbors[4] = {m_rightNeighbor, m_leftNeighbor, m_backNeighbor, m_frontNeighbor};
+    for (int y = 0; y < cells; y++)
+    {
+        for (int i = 0; i < cells; i++)
+        {
+            if (neighbors[0] != nullptr && !(skirtSides & 1))
+            {
+                solid[cellIndex(-1, y, i)] = CellSolid(*neighbors[0], scale, cells - 1, y, i);
+            }
+            if (neighbors[1] != nullptr && !(skirtSides & 2))
+            {
+                solid[cellIndex(cells, y, i)] = CellSolid(*neighbors[1], scale, 0, y, i);
+            }
+            if (neighbors[2] != nullptr && !(skirtSides & 4))
+            {
+                solid[cellIndex(i, y, -1)] = CellSolid(*neighbors[2], scale, i, y, cells - 1);
+            }
+            if (neighbors[3] != nullptr && !(skirtSides & 8))
+            {
+                solid[cellIndex(i, y, cells)] = CellSolid(*neighbors[3], scale, i, y, 0);
+            }
+        }
+    }
+
+    // Light of the cell in front of a face, open sky above the chunk and past the loaded window
+    auto frontLight = [&](int x, int y, int z)
+    {
+        if (y < 0)
+        {
+            return (uint8_t)0;
+        }
+        if (y >= cells)
+        {
+            return (uint8_t)(Voxel::MAX_LIGHT << 4);
+        }
+        const Chunk *chunk = this;
+        if (x < 0 || x >= cells || z < 0 || z >= cells)
+        {
+            chunk = x < 0 ? neighbors[0] : x >= cells ? neighbors[1] : z < 0 ? neighbors[2] : neighbors[3];
+            x = (x + cells) % cells;
+            z = (z + cells) % cells;
+        }
+        return chunk == nullptr ? (uint8_t)(Voxel::MAX_LIGHT << 4) : CellLight(*chunk, scale, x, y, z);
+    };
+
+    const glm::vec4 uv = GetTerrainTextureBounds();
+    const GLfloat cornerUVs[4][2] = {{uv.x, uv.w}, {uv.z, uv.w}, {uv.z, uv.y}, {uv.x, uv.y}};
+    GLuint baseIndex = 0;
+    for (int x = 0; x < cells; x++)
+    {
+        for (int y = 0; y < cells; y++)
+        {
+            for (int z = 0; z < cells; z++)
+            {
+                if (!solid[cellIndex(x, y, z)])
+                {
+                    continue;
+                }
+                for (int face = 0; face < 6; face++)
+                {
+                    const FaceTemplate &tpl = FACES[face];
+                    if (solid[cellIndex(x + tpl.dx, y + tpl.dy, z + tpl.dz)])
+                    {
+                        continue;
+                    }
+                    const uint8_t light = frontLight(x + tpl.dx, y + tpl.dy, z + tpl.dz);
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        vertices.insert(vertices.end(), {(GLfloat)(m_xOffset + (x + tpl.corners[corner][0]) * scale),
+                                                         (GLfloat)((y + tpl.corners[corner][1]) * scale),
+                                                         (GLfloat)(m_zOffset + (z + tpl.corners[corner][2]) * scale),
+                                                         cornerUVs[corner][0], cornerUVs[corner][1],
+                                                         tpl.normal[0], tpl.normal[1], tpl.normal[2],
+                                                         (GLfloat)(light >> 4), (GLfloat)(light & 15), (GLfloat)Voxel::OPEN_CORNER});
+                    }
+                    indices.insert(indices.end(), {baseIndex, baseIndex + 1, baseIndex + 2, baseIndex + 2, baseIndex + 3, baseIndex});
+                    baseIndex += 4;
+                }
+            }
+        }
+    }
+}
+
+uint64_t Chunk::HashMeshInputs(int level, int skirtSides)
+{
+    uint64_t hash = 14695981039346656037ull;
+    const int32_t header[6] = {MESHER_VERSION, m_xOffset, m_zOffset, level, skirtSides, CHUNK_SIZE};
+    HashBytes(hash, header, sizeof(header));
+    HashBytes(hash, m_columnMasks, sizeof(m_columnMasks));
+    HashBytes(hash, m_light.data(), m_light.size());
+
+    // The meshers read a slab of columns from each neighbor: the border voxels at full detail, a
+    // border cell of 2^level columns otherwise
+    const int width = 1 << level;
+    Chunk *const neighbors[4] = {m_rightNeighbor, m_leftNeighbor, m_backNeighbor, m_frontNeighbor};
+    for (int n = 0; n < 4; n++)
+    {
+        const uint8_t present = neighbors[n] != nullptr;
+        HashBytes(hash, &present, 1);
+        if (!present)
+        {
+            continue;
+        }
+        const int fromX = n == 0 ? CHUNK_SIZE - width : 0;
+        const int toX = n == 1 ? width : CHUNK_SIZE;
+        const int fromZ = n == 2 ? CHUNK_SIZE - width : 0;
+        const int toZ = n == 3 ? width : CHUNK_SIZE;
+        for (int x = fromX; x < toX; x++)
+        {
+            for (int z = fromZ; z < toZ; z++)
+            {
+                const uint16_t mask = neighbors[n]->m_columnMasks[x * CHUNK_SIZE + z];
+                HashBytes(hash, &mask, sizeof(mask));
+                for (int y = 0; y < CHUNK_SIZE; y++)
+                {
+                    HashBytes(hash, &neighbors[n]->m_light[VoxelIndex(x, y, z)], 1);
+                }
+            }
+        }
+    }
+
+    // Full detail occlusion also looks at the corner columns of the diagonal chunks
+    if (level == 0)
+    {
+        const int diagonals[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+        for (const int *diagonal : diagonals)
+        {
+            Chunk *chunk = GetNeighbor(diagonal[0], diagonal[1]);
+            const uint16_t mask = chunk == nullptr ? 0 : chunk->GetColumnMask(diagonal[0] < 0 ? CHUNK_SIZE - 1 : 0,
+                                                                              diagonal[1] < 0 ? CHUNK_SIZE - 1 : 0);
+            HashBytes(hash, &mask, sizeof(mask));
+        }
+    }
+    return hash;
+}
+
+bool Chunk::IsInBounds(float x, float y, float z)
+{
+    bool result = (x >= m_xOffset && x < m_xOffset + (CHUNK_SIZE) &&
+                   z >= m_zOffset && z < m_zOffset + (CHUNK_SIZE));
+    int xOffsetTotal = m_xOffset + (CHUNK_SIZE);
+    int zOffsetTotal = m_zOffset + (CHUNK_SIZE);
+
+    return result;
+}
+
+const AABB &Chunk::GetBounds()
+{
+    if (m_cullingDirty)
+    {
+        UpdateCullingData();
     }
-    else
+    return m_bounds;
+}
+
+const std::vector<AABB> &Chunk::GetOccluders()
+{
+    if (m_cullingDirty)
     {
-        m_Voxels[x][y][z].SetActive(isActive);
+        UpdateCullingData();
     }
+    return m_occluders;
 }
 
-const std::vector<GLfloat> Chunk::GetVertexData(int xOffset, int zOffset, std::vector<GLuint> &indices, GLuint &baseIndex)
+size_t Chunk::GetVoxelBytes() const
 {
-    std::vector<GLfloat> vertices;
+    // The nested vectors: one header per row and column plus the voxels themselves
+    size_t bytes = m_compressedVoxels.capacity() + m_Voxels.capacity() * sizeof(std::vector<std::vector<Voxel>>);
+    for (const std::vector<std::vector<Voxel>> &column : m_Voxels)
+    {
+        bytes += column.capacity() * sizeof(std::vector<Voxel>);
+        for (const std::vector<Voxel> &row : column)
+        {
+            bytes += row.capacity() * sizeof(Voxel);
+        }
+    }
+    return bytes;
+}
 
-    xOffset = xOffset * CHUNK_SIZE;
-    zOffset = zOffset * CHUNK_SIZE;
+void Chunk::UpdateCullingData()
+{
+    m_cullingDirty = false;
+    m_occluders.clear();
 
-    // Iterate over the blocks in the chunk
-    for (int x = 0; x < CHUNK_SIZE; x++)
+    // Tight bounds around the active voxels, empty chunks get a zero sized box
+    glm::ivec3 minCell(CHUNK_SIZE), maxCell(-1);
+    for (int x = 0; x < (int)m_Voxels.size(); x++)
     {
         for (int y = 0; y < CHUNK_SIZE; y++)
         {
             for (int z = 0; z < CHUNK_SIZE; z++)
             {
-                Voxel currBlock = m_Voxels[x][y][z];
-                if (currBlock.IsActive())
+                if (m_Voxels[x][y][z].IsActive())
                 {
-                    std::vector<GLfloat> cubeVertices = GenerateCubeVertices(x, y, z, indices, baseIndex);
-                    vertices.insert(vertices.end(), cubeVertices.begin(), cubeVertices.end());
+                    minCell = glm::min(minCell, glm::ivec3(x, y, z));
+                    maxCell = glm::max(maxCell, glm::ivec3(x, y, z));
                 }
             }
         }
     }
+    const glm::vec3 origin(m_xOffset, 0, m_zOffset);
+    if (maxCell.x < 0)
+    {
+        m_bounds = {origin, origin};
+        return;
+    }
+    m_bounds = {origin + glm::vec3(minCell), origin + glm::vec3(maxCell + 1)};
 
-    return vertices;
-}
-
-bool Chunk::IsInBounds(float x, float y, float z)
-{
-    bool result = (x >= m_xOffset && x < m_xOffset + (CHUNK_SIZE) &&
-                   z >= m_zOffset && z < m_zOffset + (CHUNK_SIZE));
-    int xOffsetTotal = m_xOffset + (CHUNK_SIZE);
-    int zOffsetTotal = m_zOffset + (CHUNK_SIZE);
+    // Occluders are the longest fully solid run of layers in each 8x8 column quadrant
+    const int QUAD = CHUNK_SIZE / 2;
+    glm::ivec2 runs[4];
+    for (int q = 0; q < 4; q++)
+    {
+        const int qx = (q & 1) * QUAD;
+        const int qz = (q >> 1) * QUAD;
+        runs[q] = glm::ivec2(0, 0);
+        int runStart = 0;
+        for (int y = 0; y <= CHUNK_SIZE; y++)
+        {
+            bool solid = y < CHUNK_SIZE;
+            for (int x = qx; solid && x < qx + QUAD; x++)
+            {
+                for (int z = qz; solid && z < qz + QUAD; z++)
+                {
+                    solid = m_Voxels[x][y][z].IsActive();
+                }
+            }
+            if (!solid)
+            {
+                if (y - runStart > runs[q].y - runs[q].x)
+                {
+                    runs[q] = glm::ivec2(runStart, y);
+                }
+                runStart = y + 1;
+            }
+        }
+    }
 
-    return result;
+    // Merge the quadrants into a single box when they agree
+    if (runs[0].y > runs[0].x && runs[0] == runs[1] && runs[0] == runs[2] && runs[0] == runs[3])
+    {
+        m_occluders.push_back({origin + glm::vec3(0, runs[0].x, 0),
+                               origin + glm::vec3(CHUNK_SIZE, runs[0].y, CHUNK_SIZE)});
+        return;
+    }
+    for (int q = 0; q < 4; q++)
+    {
+        if (runs[q].y > runs[q].x)
+        {
+            const glm::vec3 corner = origin + glm::vec3((q & 1) * QUAD, 0, (q >> 1) * QUAD);
+            m_occluders.push_back({corner + glm::vec3(0, runs[q].x, 0),
+                                   corner + glm::vec3(QUAD, runs[q].y, QUAD)});
+        }
+    }
 }
 
 std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vector<GLuint> &indices, GLuint &baseIndex)
@@ -140,9 +1041,10 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetFrontVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 0);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     // Back face
@@ -150,9 +1052,10 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetBackVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 1);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     // Left face
@@ -160,9 +1063,10 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetLeftVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 2);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     // Right face
@@ -170,9 +1074,10 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetRightVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 3);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     // Top face
@@ -180,9 +1085,10 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetTopVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 4);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     // Bottom face
@@ -190,23 +1096,63 @@ std::vector<GLfloat> Chunk::GenerateCubeVertices(int x, int y, int z, std::vecto
     {
         std::vector<GLfloat> frontVertices = voxel.GetBottomVertices();
         vertices.insert(vertices.end(), frontVertices.begin(), frontVertices.end());
+        const bool flip = ShadeFace(vertices, x, y, z, 5);
 
         // Add the face indices (update this depending on how your indices are structured)
-        AddFace(indices, baseIndex);
+        AddFace(indices, baseIndex, flip);
     }
 
     return vertices;
 }
 
-void Chunk::AddFace(std::vector<GLuint> &indices, GLuint &baseIndex)
+void Chunk::AddFace(std::vector<GLuint> &indices, GLuint &baseIndex, bool flip)
 {
-    indices.insert(indices.end(), {
-                                      baseIndex, baseIndex + 1, baseIndex + 2, // Triangle 1
-                                      baseIndex + 2, baseIndex + 3, baseIndex  // Triangle 2
-                                  });
+    if (flip)
+    {
+        indices.insert(indices.end(), {
+                                          baseIndex + 1, baseIndex + 2, baseIndex + 3, // Triangle 1
+                                          baseIndex + 3, baseIndex, baseIndex + 1      // Triangle 2
+                                      });
+    }
+    else
+    {
+        indices.insert(indices.end(), {
+                                          baseIndex, baseIndex + 1, baseIndex + 2, // Triangle 1
+                                          baseIndex + 2, baseIndex + 3, baseIndex  // Triangle 2
+                                      });
+    }
     baseIndex += 4;
 }
 
+bool Chunk::ShadeFace(std::vector<GLfloat> &vertices, int x, int y, int z, int face)
+{
+    const FaceTemplate &tpl = FACES[face];
+    int occlusion[4];
+    for (int corner = 0; corner < 4; corner++)
+    {
+        int neighbors[3][3];
+        GetCornerNeighbors(face, corner, neighbors);
+        bool solid[3];
+        for (int i = 0; i < 3; i++)
+        {
+            solid[i] = IsSolidAt(x + neighbors[i][0], y + neighbors[i][1], z + neighbors[i][2]);
+        }
+        occlusion[corner] = CornerOcclusion(solid[0], solid[1], solid[2]);
+    }
+    SetFaceShading(vertices, GetFaceLight(x, y, z, tpl.dx, tpl.dy, tpl.dz), occlusion);
+    return FlipQuad(occlusion);
+}
+
+bool Chunk::IsSolidAt(int x, int y, int z)
+{
+    if (y < 0 || y >= CHUNK_SIZE)
+    {
+        return false;
+    }
+    Chunk *chunk = GetNeighbor(x < 0 ? -1 : (x >= CHUNK_SIZE ? 1 : 0), z < 0 ? -1 : (z >= CHUNK_SIZE ? 1 : 0));
+    return chunk != nullptr && chunk->IsSolid((x + CHUNK_SIZE) % CHUNK_SIZE, y, (z + CHUNK_SIZE) % CHUNK_SIZE);
+}
+
 bool Chunk::HasNeighborOnFace(int x, int y, int z, int offsetX, int offsetY, int offsetZ)
 {
     const bool isDefault = false;
@@ -245,7 +1191,398 @@ bool Chunk::HasNeighborOnFace(int x, int y, int z, int offsetX, int offsetY, int
     return isDefault;
 }
 
+uint8_t Chunk::GetFaceLight(int x, int y, int z, int offsetX, int offsetY, int offsetZ)
+{
+    const int neighborX = x + offsetX;
+    const int neighborY = y + offsetY;
+    const int neighborZ = z + offsetZ;
+    if (neighborY < 0)
+    {
+        return 0;
+    }
+    if (neighborY >= CHUNK_SIZE)
+    {
+        return Voxel::MAX_LIGHT << 4;
+    }
+
+    Chunk *chunk = this;
+    if (neighborX < 0 || neighborX >= CHUNK_SIZE || neighborZ < 0 || neighborZ >= CHUNK_SIZE)
+    {
+        chunk = GetNeighbor(neighborX < 0 ? -1 : (neighborX >= CHUNK_SIZE ? 1 : 0),
+                            neighborZ < 0 ? -1 : (neighborZ >= CHUNK_SIZE ? 1 : 0));
+    }
+    if (chunk == nullptr)
+    {
+        return Voxel::MAX_LIGHT << 4;
+    }
+    return chunk->GetLight((neighborX + CHUNK_SIZE) % CHUNK_SIZE, neighborY, (neighborZ + CHUNK_SIZE) % CHUNK_SIZE);
+}
+
 Voxel *Chunk::GetVoxel(int x, int y, int z)
 {
+    Touch();
     return &m_Voxels[x][y][z];
+}
+
+void Chunk::CopyOccupancy(uint8_t *solid)
+{
+    if (m_compressed)
+    {
+        std::vector<uint8_t> runs;
+        if (!LzDecompress(m_compressedVoxels, runs) || !DecodeColumnRuns(runs, solid))
+        {
+            std::cerr << "Damaged compressed chunk at " << m_xOffset << ", " << m_zOffset << std::endl;
+            std::memset(solid, 0, CHUNK_VOXELS);
+        }
+        return;
+    }
+    std::memset(solid, 0, CHUNK_VOXELS);
+    for (int x = 0; x < (int)m_Voxels.size(); x++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+                solid[VoxelIndex(x, y, z)] = m_Voxels[x][y][z].IsActive();
+            }
+        }
+    }
+}
+
+void Chunk::Compress()
+{
+    if (m_compressed || m_Voxels.empty())
+    {
+        return;
+    }
+    TRACE_SCOPE("Chunk::Compress");
+    // Bounds and occluders are all culling needs while the chunk is cold
+    if (m_cullingDirty)
+    {
+        UpdateCullingData();
+    }
+    uint8_t solid[CHUNK_VOXELS];
+    CopyOccupancy(solid);
+    std::vector<uint8_t> runs, packed;
+    EncodeColumnRuns(solid, runs);
+    LzCompress(runs, packed);
+    packed.shrink_to_fit();
+
+    MemoryStats::Remove(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    std::vector<std::vector<std::vector<Voxel>>>().swap(m_Voxels);
+    m_compressedVoxels.swap(packed);
+    m_compressed = true;
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+}
+
+bool Chunk::IsCompressed() const
+{
+    return m_compressed;
+}
+
+bool Chunk::TakeAccessed()
+{
+    const bool accessed = m_accessed;
+    m_accessed = false;
+    return accessed;
+}
+
+uint8_t Chunk::GetLight(int x, int y, int z) const
+{
+    return m_light[VoxelIndex(x, y, z)];
+}
+
+void Chunk::SetLight(int x, int y, int z, uint8_t light)
+{
+    m_light[VoxelIndex(x, y, z)] = light;
+}
+
+const uint8_t *Chunk::GetLightData() const
+{
+    return m_light.data();
+}
+
+void Chunk::ClearLight()
+{
+    std::fill(m_light.begin(), m_light.end(), 0);
+}
+
+bool Chunk::HasLight() const
+{
+    return std::any_of(m_light.begin(), m_light.end(), [](uint8_t light) { return light != 0; });
+}
+
+uint64_t Chunk::HashLight() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    HashBytes(hash, m_light.data(), m_light.size());
+    return hash;
+}
+
+bool Chunk::IsSolid(int x, int y, int z) const
+{
+    return (m_columnMasks[x * CHUNK_SIZE + z] >> y) & 1;
+}
+
+int Chunk::GetEmission(int x, int y, int z) const
+{
+    const uint16_t index = VoxelIndex(x, y, z);
+    for (const std::pair<uint16_t, uint8_t> &emitter : m_emitters)
+    {
+        if (emitter.first == index)
+        {
+            return emitter.second;
+        }
+    }
+    return 0;
+}
+
+void Chunk::SetEmission(int x, int y, int z, int level)
+{
+    const uint16_t index = VoxelIndex(x, y, z);
+    // Few voxels emit light, a plain list is enough
+    m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(),
+                                    [&](const std::pair<uint16_t, uint8_t> &emitter)
+                                    { return emitter.first == index; }),
+                     m_emitters.end());
+    if (level > 0)
+    {
+        m_emitters.push_back({index, (uint8_t)level});
+    }
+}
+
+const std::vector<std::pair<uint16_t, uint8_t>> &Chunk::GetEmitters() const
+{
+    return m_emitters;
+}
+
+glm::ivec2 Chunk::GetCoordinates() const
+{
+    return glm::ivec2(m_xOffset / CHUNK_SIZE, m_zOffset / CHUNK_SIZE);
+}
+
+int Chunk::GetTerrainHeight(const siv::PerlinNoise &perlin, int x, int z)
+{
+    const int chunkX = (x >= 0 ? x : x - CHUNK_SIZE + 1) / CHUNK_SIZE;
+    const int chunkZ = (z >= 0 ? z : z - CHUNK_SIZE + 1) / CHUNK_SIZE;
+    for (int y = CHUNK_SIZE - 1; y >= 0; y--)
+    {
+        if (TerrainNoise(perlin, x - chunkX * CHUNK_SIZE, y, z - chunkZ * CHUNK_SIZE, chunkX, chunkZ) >= TERRAIN_THRESHOLD)
+        {
+            return y + 1;
+        }
+    }
+    return 0;
+}
+
+glm::vec4 Chunk::GetTerrainTextureBounds()
+{
+    Voxel terrain(glm::vec3(0.0f), 1, TERRAIN_TEXTURE);
+    return terrain.GetTextureBounds();
+}
+
+int Chunk::GetColumnHeight(int x, int z) const
+{
+    return m_columnHeights[x * CHUNK_SIZE + z];
+}
+
+uint16_t Chunk::GetColumnMask(int x, int z) const
+{
+    return m_columnMasks[x * CHUNK_SIZE + z];
+}
+
+void Chunk::RebuildColumns()
+{
+    uint8_t solid[CHUNK_VOXELS];
+    CopyOccupancy(solid);
+    for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        const int x = column / CHUNK_SIZE;
+        const int z = column % CHUNK_SIZE;
+        uint16_t mask = 0;
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            mask |= (uint16_t)solid[VoxelIndex(x, y, z)] << y;
+        }
+        m_columnMasks[column] = mask;
+        UpdateColumnHeight(column);
+    }
+}
+
+int Chunk::SetColumnMasks(const uint16_t *masks, uint16_t *changed)
+{
+    int count = 0;
+    for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        changed[column] = masks[column] ^ m_columnMasks[column];
+        count += __builtin_popcount(changed[column]);
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    Touch();
+    for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        if (changed[column] == 0)
+        {
+            continue;
+        }
+        const int x = column / CHUNK_SIZE;
+        const int z = column % CHUNK_SIZE;
+        for (unsigned bits = changed[column]; bits != 0; bits &= bits - 1)
+        {
+            const int y = __builtin_ctz(bits);
+            m_Voxels[x][y][z].SetActive((masks[column] >> y) & 1);
+        }
+        m_columnMasks[column] = masks[column];
+        UpdateColumnHeight(column);
+    }
+    if (!m_emitters.empty())
+    {
+        m_emitters.erase(std::remove_if(m_emitters.begin(), m_emitters.end(),
+                                        [&](const std::pair<uint16_t, uint8_t> &emitter)
+                                        {
+                                            const int x = emitter.first / (CHUNK_SIZE * CHUNK_SIZE);
+                                            const int y = (emitter.first / CHUNK_SIZE) % CHUNK_SIZE;
+                                            const int z = emitter.first % CHUNK_SIZE;
+                                            return IsSolid(x, y, z);
+                                        }),
+                         m_emitters.end());
+    }
+    m_cullingDirty = true;
+    if (IsUniform())
+    {
+        uint16_t unchanged[CHUNK_SIZE * CHUNK_SIZE];
+        Fill(masks[0] != 0, unchanged);
+    }
+    return count;
+}
+
+int Chunk::Fill(bool active, uint16_t *changed)
+{
+    TRACE_SCOPE("Chunk::Fill");
+    const uint16_t mask = active ? FULL_COLUMN : 0;
+    int count = 0;
+    for (int column = 0; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        changed[column] = mask ^ m_columnMasks[column];
+        count += __builtin_popcount(changed[column]);
+        m_columnMasks[column] = mask;
+        UpdateColumnHeight(column);
+    }
+    if (active)
+    {
+        m_emitters.clear();
+    }
+
+    // Both uniform chunks pack to a few bytes, encoded once
+    static const std::vector<uint8_t> packed[2] = {PackUniform(false), PackUniform(true)};
+    MemoryStats::Remove(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    std::vector<std::vector<std::vector<Voxel>>>().swap(m_Voxels);
+    m_compressedVoxels = packed[active];
+    m_compressedVoxels.shrink_to_fit();
+    m_compressed = true;
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+
+    // The culling data of a full or empty chunk, UpdateCullingData needs the voxels
+    const glm::vec3 origin(m_xOffset, 0, m_zOffset);
+    m_occluders.clear();
+    m_bounds = {origin, active ? origin + glm::vec3(CHUNK_SIZE) : origin};
+    if (active)
+    {
+        m_occluders.push_back(m_bounds);
+    }
+    m_cullingDirty = false;
+    return count;
+}
+
+bool Chunk::IsUniform() const
+{
+    const uint16_t first = m_columnMasks[0];
+    if (first != 0 && first != FULL_COLUMN)
+    {
+        return false;
+    }
+    for (int column = 1; column < CHUNK_SIZE * CHUNK_SIZE; column++)
+    {
+        if (m_columnMasks[column] != first)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Chunk *Chunk::GetNeighbor(int offsetX, int offsetZ)
+{
+    // Diagonal neighbors are reached through a side neighbor
+    Chunk *chunk = this;
+    if (offsetX != 0)
+    {
+        chunk = offsetX < 0 ? chunk->m_rightNeighbor : chunk->m_leftNeighbor;
+    }
+    if (offsetZ != 0 && chunk != nullptr)
+    {
+        chunk = offsetZ < 0 ? chunk->m_backNeighbor : chunk->m_frontNeighbor;
+    }
+    return chunk;
+}
+
+void Chunk::AllocateVoxels()
+{
+    // Construct every voxel in place, this runs for each chunk loaded from disk
+    m_Voxels.resize(CHUNK_SIZE);
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        m_Voxels[x].resize(CHUNK_SIZE);
+        for (int y = 0; y < CHUNK_SIZE; ++y)
+        {
+            std::vector<Voxel> &column = m_Voxels[x][y];
+            column.reserve(CHUNK_SIZE);
+            for (int z = 0; z < CHUNK_SIZE; ++z)
+            {
+                column.emplace_back(glm::vec3(x + m_xOffset, y, z + m_zOffset), 1, TERRAIN_TEXTURE);
+            }
+        }
+    }
+}
+
+void Chunk::Touch()
+{
+    if (m_compressed)
+    {
+        Decompress();
+    }
+    m_accessed = true;
+}
+
+void Chunk::UpdateColumnHeight(int column)
+{
+    const uint16_t mask = m_columnMasks[column];
+    m_columnHeights[column] = mask == 0 ? 0 : (uint8_t)(32 - __builtin_clz(mask));
+}
+
+void Chunk::Decompress()
+{
+    TRACE_SCOPE("Chunk::Decompress");
+    uint8_t solid[CHUNK_VOXELS];
+    CopyOccupancy(solid);
+
+    MemoryStats::Remove(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
+    std::vector<uint8_t>().swap(m_compressedVoxels);
+    m_compressed = false;
+    AllocateVoxels();
+    for (int x = 0; x < CHUNK_SIZE; x++)
+    {
+        for (int y = 0; y < CHUNK_SIZE; y++)
+        {
+            for (int z = 0; z < CHUNK_SIZE; z++)
+            {
+                m_Voxels[x][y][z].SetActive(solid[VoxelIndex(x, y, z)] != 0);
+            }
+        }
+    }
+    MemoryStats::Add(MEMORY_CHUNK_VOXELS, GetVoxelBytes());
 }
\ No newline at end of file
@@ -0,0 +1,438 @@
+#include "ChunkIO.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(LINUX) || defined(MAC)
+#include <unistd.h>
+#endif
+
+#if defined(LINUX)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(LINUX)
+// Submission and completion rings shared with the kernel, set up with the raw system calls so
+// there is no dependency on liburing
+struct ChunkIO::Ring
+{
+    int fd = -1;
+    void *ringMemory = MAP_FAILED;
+    size_t ringSize = 0;
+    void *completionMemory = MAP_FAILED;
+    size_t completionSize = 0;
+    io_uring_sqe *entries = (io_uring_sqe *)MAP_FAILED;
+    size_t entriesSize = 0;
+
+    unsigned *submitTail = nullptr;
+    unsigned *submitMask = nullptr;
+    unsigned *submitArray = nullptr;
+    unsigned *completeHead = nullptr;
+    unsigned *completeTail = nullptr;
+    unsigned *completeMask = nullptr;
+    io_uring_cqe *completions = nullptr;
+
+    bool Open(unsigned depth)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        fd = (int)syscall(__NR_io_uring_setup, depth, &params);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        ringSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        completionSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMapping)
+        {
+            ringSize = completionSize = std::max(ringSize, completionSize);
+        }
+        ringMemory = mmap(nullptr, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (ringMemory == MAP_FAILED)
+        {
+            return false;
+        }
+        if (!singleMapping)
+        {
+            completionMemory = mmap(nullptr, completionSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if (completionMemory == MAP_FAILED)
+            {
+                return false;
+            }
+        }
+        entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+        entries = (io_uring_sqe *)mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (entries == MAP_FAILED)
+        {
+            return false;
+        }
+
+        uint8_t *submit = (uint8_t *)ringMemory;
+        uint8_t *complete = singleMapping ? submit : (uint8_t *)completionMemory;
+        submitTail = (unsigned *)(submit + params.sq_off.tail);
+        submitMask = (unsigned *)(submit + params.sq_off.ring_mask);
+        submitArray = (unsigned *)(submit + params.sq_off.array);
+        completeHead = (unsigned *)(complete + params.cq_off.head);
+        completeTail = (unsigned *)(complete + params.cq_off.tail);
+        completeMask = (unsigned *)(complete + params.cq_off.ring_mask);
+        completions = (io_uring_cqe *)(complete + params.cq_off.cqes);
+        return true;
+    }
+
+    ~Ring()
+    {
+        if (entries != MAP_FAILED)
+        {
+            munmap(entries, entriesSize);
+        }
+        if (completionMemory != MAP_FAILED)
+        {
+            munmap(completionMemory, completionSize);
+        }
+        if (ringMemory != MAP_FAILED)
+        {
+            munmap(ringMemory, ringSize);
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    // Only this thread writes the tail, the kernel reads it after the release store
+    void Push(uint8_t opcode, int file, uint64_t offset, void *buffer, uint32_t length, uint64_t tag)
+    {
+        const unsigned tail = *submitTail;
+        const unsigned index = tail & *submitMask;
+        io_uring_sqe &entry = entries[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = opcode;
+        entry.fd = file;
+        entry.off = offset;
+        entry.addr = (uint64_t)(uintptr_t)buffer;
+        entry.len = length;
+        entry.user_data = tag;
+        submitArray[index] = index;
+        __atomic_store_n(submitTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Submit the pushed entries and wait for at least one completion. Returns how many entries
+    // the kernel took, or -errno
+    int Enter(unsigned toSubmit)
+    {
+        const int result = (int)syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        return result < 0 ? -errno : result;
+    }
+};
+#else
+struct ChunkIO::Ring
+{
+};
+#endif
+
+ChunkIO::ChunkIO(bool useIoUring, int threadCount)
+{
+    m_threadCount = std::max(1, threadCount);
+    m_batch = nullptr;
+    m_batchWrite = false;
+    m_nextRequest = 0;
+    m_remaining = 0;
+    m_stopping = false;
+    m_poolCompletes = std::thread::hardware_concurrency() > 1;
+#if defined(LINUX)
+    if (useIoUring)
+    {
+        // Kernels without io_uring, or sandboxes that block it, fail the setup call
+        m_ring.reset(new Ring());
+        if (!m_ring->Open(QUEUE_DEPTH))
+        {
+            m_ring.reset();
+        }
+    }
+#else
+    (void)useIoUring;
+#endif
+}
+
+ChunkIO::~ChunkIO()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ChunkIO::ReadBatch(std::vector<Request> &requests)
+{
+    TRACE_SCOPE("ChunkIO::ReadBatch");
+    if (m_ring != nullptr)
+    {
+        RunRing(requests, false);
+        return;
+    }
+    RunPool(requests, false);
+}
+
+void ChunkIO::WriteBatch(std::vector<Request> &requests)
+{
+    TRACE_SCOPE("ChunkIO::WriteBatch");
+    if (m_ring != nullptr)
+    {
+        RunRing(requests, true);
+        return;
+    }
+    RunPool(requests, true);
+}
+
+ChunkIO::Backend ChunkIO::GetBackend() const
+{
+    return m_ring != nullptr ? BACKEND_IO_URING : BACKEND_THREAD_POOL;
+}
+
+const char *ChunkIO::GetBackendName() const
+{
+    return m_ring != nullptr ? "io_uring" : "thread-pool";
+}
+
+void ChunkIO::RunRing(std::vector<Request> &requests, bool write)
+{
+#if defined(LINUX)
+    if (requests.empty())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        StartWorkers();
+        m_batchWrite = write;
+        m_remaining = requests.size();
+    }
+    std::vector<std::vector<uint8_t>> buffers(write ? 0 : requests.size());
+    // Requests pushed to the ring in order, the last unsubmitted of them are not taken yet
+    std::vector<size_t> pushed;
+    size_t next = 0;
+    size_t inFlight = 0;
+    unsigned unsubmitted = 0;
+    while (next < requests.size() || inFlight > 0)
+    {
+        while (next < requests.size() && inFlight < QUEUE_DEPTH)
+        {
+            Request &request = requests[next];
+            if (!write && request.data != nullptr)
+            {
+                PushCompletion({&request, {}, false});
+                next++;
+                continue;
+            }
+            void *buffer = (void *)request.data;
+            if (!write)
+            {
+                buffers[next].resize(request.length);
+                buffer = buffers[next].data();
+            }
+            m_ring->Push(write ? IORING_OP_WRITE : IORING_OP_READ, request.fd, request.offset, buffer, request.length, next);
+            pushed.push_back(next);
+            next++;
+            inFlight++;
+            unsubmitted++;
+        }
+        if (inFlight == 0)
+        {
+            break;
+        }
+
+        const int entered = m_ring->Enter(unsubmitted);
+        if (entered < 0 && entered != -EINTR && entered != -EAGAIN && entered != -EBUSY && unsubmitted > 0)
+        {
+            // The kernel refused the entries, take them back and let the pool do them the plain way.
+            // Entries it already took still complete through the ring
+            __atomic_store_n(m_ring->submitTail, *m_ring->submitTail - unsubmitted, __ATOMIC_RELEASE);
+            for (size_t i = pushed.size() - unsubmitted; i < pushed.size(); ++i)
+            {
+                PushCompletion({&requests[pushed[i]], {}, true});
+            }
+            pushed.resize(pushed.size() - unsubmitted);
+            inFlight -= unsubmitted;
+            unsubmitted = 0;
+        }
+        else if (entered > 0)
+        {
+            unsubmitted -= std::min<unsigned>(unsubmitted, entered);
+        }
+
+        unsigned head = *m_ring->completeHead;
+        while (head != __atomic_load_n(m_ring->completeTail, __ATOMIC_ACQUIRE))
+        {
+            const io_uring_cqe &completion = m_ring->completions[head & *m_ring->completeMask];
+            const size_t index = (size_t)completion.user_data;
+            const int result = completion.res;
+            head++;
+            inFlight--;
+
+            // Short transfers and opcodes an older kernel rejects are redone the plain way
+            Request &request = requests[index];
+            PushCompletion({&request, write ? std::vector<uint8_t>() : std::move(buffers[index]),
+                            result != (int)request.length});
+        }
+        __atomic_store_n(m_ring->completeHead, head, __ATOMIC_RELEASE);
+
+        if (!m_poolCompletes)
+        {
+            // Decode here while the kernel works on the reads still in flight
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (!m_completions.empty())
+            {
+                FinishCompletion(lock);
+            }
+        }
+    }
+
+    // Help the pool with the transfers left instead of only waiting for it
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_remaining > 0)
+    {
+        if (m_completions.empty())
+        {
+            m_done.wait(lock);
+            continue;
+        }
+        FinishCompletion(lock);
+    }
+#else
+    RunPool(requests, write);
+#endif
+}
+
+void ChunkIO::RunPool(std::vector<Request> &requests, bool write)
+{
+    if (requests.empty())
+    {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    StartWorkers();
+    m_batch = &requests;
+    m_batchWrite = write;
+    m_nextRequest = 0;
+    m_remaining = requests.size();
+    m_wake.notify_all();
+    m_done.wait(lock, [&]
+                { return m_remaining == 0; });
+    m_batch = nullptr;
+}
+
+void ChunkIO::StartWorkers()
+{
+    if (m_workers.empty())
+    {
+        for (int i = 0; i < m_threadCount; ++i)
+        {
+            m_workers.emplace_back(&ChunkIO::WorkerLoop, this);
+        }
+    }
+}
+
+void ChunkIO::PushCompletion(Completion completion)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_completions.push_back(std::move(completion));
+    }
+    if (m_poolCompletes)
+    {
+        m_wake.notify_one();
+    }
+}
+
+void ChunkIO::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [&]
+                    { return m_stopping || !m_completions.empty() ||
+                             (m_batch != nullptr && m_nextRequest < m_batch->size()); });
+        if (m_stopping)
+        {
+            return;
+        }
+        if (!m_completions.empty())
+        {
+            FinishCompletion(lock);
+            continue;
+        }
+        Request &request = (*m_batch)[m_nextRequest++];
+        const bool write = m_batchWrite;
+        lock.unlock();
+        RunBlocking(request, write);
+        lock.lock();
+        if (--m_remaining == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+void ChunkIO::FinishCompletion(std::unique_lock<std::mutex> &lock)
+{
+    Completion completion = std::move(m_completions.front());
+    m_completions.pop_front();
+    const bool write = m_batchWrite;
+    lock.unlock();
+    Request &request = *completion.request;
+    if (completion.redo)
+    {
+        RunBlocking(request, write);
+    }
+    else
+    {
+        request.complete(completion.buffer.empty() ? request.data : completion.buffer.data(), request.length, true);
+    }
+    lock.lock();
+    if (--m_remaining == 0)
+    {
+        m_done.notify_one();
+    }
+}
+
+void ChunkIO::RunBlocking(Request &request, bool write)
+{
+    if (!write && request.data != nullptr)
+    {
+        request.complete(request.data, request.length, true);
+        return;
+    }
+#if defined(LINUX) || defined(MAC)
+    std::vector<uint8_t> buffer(write ? 0 : request.length);
+    size_t done = 0;
+    while (done < request.length)
+    {
+        const ssize_t result = write ? pwrite(request.fd, request.data + done, request.length - done, request.offset + done)
+                                     : pread(request.fd, buffer.data() + done, request.length - done, request.offset + done);
+        if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result <= 0)
+        {
+            break;
+        }
+        done += result;
+    }
+    request.complete(write ? request.data : buffer.data(), done, done == request.length);
+#else
+    // Other platforms read the whole region file when they open it and never issue requests
+    request.complete(nullptr, 0, false);
+#endif
+}
@@ -1,117 +1,1067 @@
 #include "ChunkManager.hpp"
-#include <iostream>
+#include "MemoryStats.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cmath>
 
-ChunkManager::ChunkManager()
+namespace
 {
-    const siv::PerlinNoise::seed_type seed = 123456u;
-    const siv::PerlinNoise perlin{seed};
+    // Blocks a chunk must be past a level's distance before it switches, either way
+    const float LOD_HYSTERESIS = 6.0f;
+    // Where levels 1 to 3 start. Each level reaches twice as far as the one before, so every ring
+    // costs about the same triangles and the window can grow well past full detail
+    const float DEFAULT_LOD_DISTANCES[ChunkManager::LOD_LEVELS] = {0.0f, 40.0f, 80.0f, 160.0f};
+
+    // Voxel index of the emitter lists, z fastest
+    uint16_t EmitterIndex(int x, int y, int z)
+    {
+        return (uint16_t)((x * Chunk::CHUNK_SIZE + y) * Chunk::CHUNK_SIZE + z);
+    }
+
+    // The light sources of the list whose voxels in the chunk are solid now
+    std::vector<std::pair<uint16_t, uint8_t>> CoveredEmitters(const Chunk *chunk, const std::vector<std::pair<uint16_t, uint8_t>> &emitters)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        std::vector<std::pair<uint16_t, uint8_t>> covered;
+        for (const std::pair<uint16_t, uint8_t> &emitter : emitters)
+        {
+            if (chunk->IsSolid(emitter.first / (size * size), (emitter.first / size) % size, emitter.first % size))
+            {
+                covered.push_back(emitter);
+            }
+        }
+        return covered;
+    }
+}
+
+ChunkManager::ChunkManager(const std::string &saveDirectory, int windowSize) : m_perlin(SEED)
+{
+    m_windowSize = std::max(windowSize, 2);
+    m_originX = 0;
+    m_originZ = 0;
 
     // Initialize the m_ChunkGrid vector
-    m_ChunkGrid.resize(CHUNK_GRID_SIZE, std::vector<Chunk *>(CHUNK_GRID_SIZE));
+    m_ChunkGrid.resize(m_windowSize, std::vector<Chunk *>(m_windowSize));
+    // Every chunk starts without a mesh
+    m_dirtyChunks.assign(m_windowSize * m_windowSize, true);
+    MemoryStats::Add(MEMORY_JOB_QUEUES, (m_dirtyChunks.size() + 7) / 8);
+    m_unsavedChunks.assign(m_windowSize * m_windowSize, false);
+    m_idleFrames.assign(m_windowSize * m_windowSize, 0);
+    m_lods.assign(m_windowSize * m_windowSize, 0);
+    m_meshLods.assign(m_windowSize * m_windowSize, 0);
+    m_transactionDepth = 0;
+    std::copy(std::begin(DEFAULT_LOD_DISTANCES), std::end(DEFAULT_LOD_DISTANCES), m_lodDistances);
+    if (!saveDirectory.empty())
+    {
+        m_regionStore.reset(new RegionStore(saveDirectory));
+        m_journal.reset(new EditJournal(*m_regionStore, m_perlin, saveDirectory + "/edits.vxj"));
+        m_journal->Open();
+        m_meshCache.reset(new MeshCache(saveDirectory + "/meshes.vxm"));
+        m_meshCache->Open();
+    }
 
     // Iterate over x, y coordinates to initialize each chunk
-    for (int x = 0; x < CHUNK_GRID_SIZE; ++x)
+    std::vector<std::pair<int, int>> coordinates;
+    for (int x = 0; x < m_windowSize; ++x)
     {
-        for (int y = 0; y < CHUNK_GRID_SIZE; ++y)
+        for (int y = 0; y < m_windowSize; ++y)
         {
-            // Generate terrain using Perlin noise for each chunk
-            Chunk *chunk = new Chunk(perlin, x, y);
-
-            // Assign the generated chunk to the chunk grid
-            m_ChunkGrid[x][y] = chunk;
+            coordinates.push_back({x, y});
         }
     }
+    // Load the saved chunks or generate terrain using Perlin noise
+    std::vector<Chunk *> chunks = LoadOrGenerateChunks(coordinates);
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        // Assign the chunk to the chunk grid
+        m_ChunkGrid[coordinates[i].first][coordinates[i].second] = chunks[i];
+    }
 
-    // Iterate over x, y coordinates to initialize each chunk
-    for (int x = 0; x < CHUNK_GRID_SIZE; ++x)
+    LinkNeighbors();
+    LightLoadedChunks(chunks);
+    // Every chunk is dirty already, this marks the ones whose light changed to be saved
+    MarkLightDirty();
+}
+
+ChunkManager::~ChunkManager()
+{
+    Save();
+    // Folds the remaining edits into the region files
+    m_journal.reset();
+    for (int x = 0; x < m_windowSize; ++x)
     {
-        for (int y = 0; y < CHUNK_GRID_SIZE; ++y)
+        for (int z = 0; z < m_windowSize; ++z)
         {
-            // Generate terrain using Perlin noise for each chunk
-            Chunk *chunk = m_ChunkGrid[x][y];
+            delete m_ChunkGrid[x][z];
+        }
+    }
+    MemoryStats::Remove(MEMORY_JOB_QUEUES, (m_dirtyChunks.size() + 7) / 8);
+}
+
+void ChunkManager::GenerateChunks()
+{
+}
+
+int ChunkManager::StreamAround(float x, float z)
+{
+    TRACE_SCOPE("ChunkManager::StreamAround");
+    // Keep the window centered on the chunk that contains the position
+    const int originX = FloorDiv((int)std::floor(x), Chunk::CHUNK_SIZE) - m_windowSize / 2;
+    const int originZ = FloorDiv((int)std::floor(z), Chunk::CHUNK_SIZE) - m_windowSize / 2;
+    if (originX == m_originX && originZ == m_originZ)
+    {
+        return 0;
+    }
+
+    const int oldOriginX = m_originX;
+    const int oldOriginZ = m_originZ;
+    m_originX = originX;
+    m_originZ = originZ;
 
-            // Set the pointers to the neighboring chunks
-            if (y > 0)
+    // Only chunks that entered the window are loaded, they take the slot of the chunk that left
+    std::vector<std::pair<int, int>> entered;
+    // Without a store chunks come back as generated terrain, their edits are gone
+    std::vector<std::pair<int, int>> lost;
+    for (int chunkX = originX; chunkX < originX + m_windowSize; ++chunkX)
+    {
+        for (int chunkZ = originZ; chunkZ < originZ + m_windowSize; ++chunkZ)
+        {
+            if (chunkX >= oldOriginX && chunkX < oldOriginX + m_windowSize &&
+                chunkZ >= oldOriginZ && chunkZ < oldOriginZ + m_windowSize)
             {
-                chunk->SetBackNeighbor(m_ChunkGrid[x][y - 1]);
+                continue;
             }
 
-            if (y < CHUNK_GRID_SIZE - 1)
+            const int slot = SlotIndex(chunkX, chunkZ);
+            Chunk *&chunk = m_ChunkGrid[slot / m_windowSize][slot % m_windowSize];
+            // The chunk leaving is the one of the old window that had the same slot
+            const int oldChunkX = oldOriginX + ((chunkX - oldOriginX) % m_windowSize + m_windowSize) % m_windowSize;
+            const int oldChunkZ = oldOriginZ + ((chunkZ - oldOriginZ) % m_windowSize + m_windowSize) % m_windowSize;
+            if (m_regionStore == nullptr)
             {
-                chunk->SetFrontNeighbor(m_ChunkGrid[x][y + 1]);
+                lost.push_back({oldChunkX, oldChunkZ});
             }
-
-            if (x > 0)
+            else if (m_unsavedChunks[slot])
             {
-                chunk->SetRightNeighbor(m_ChunkGrid[x - 1][y]);
+                m_regionStore->StoreChunk(oldChunkX, oldChunkZ, *chunk);
             }
+            if (m_meshCache)
+            {
+                m_meshCache->Release(oldChunkX, oldChunkZ);
+            }
+            delete chunk;
+            chunk = nullptr;
+            entered.push_back({chunkX, chunkZ});
+        }
+    }
 
-            if (x < CHUNK_GRID_SIZE - 1)
+    m_history.DropChunks(lost);
+
+    // One batch of reads for the whole strip, chunks are decoded as their reads complete
+    std::vector<Chunk *> chunks = LoadOrGenerateChunks(entered);
+    for (size_t i = 0; i < entered.size(); ++i)
+    {
+        const int chunkX = entered[i].first;
+        const int chunkZ = entered[i].second;
+        const int slot = SlotIndex(chunkX, chunkZ);
+        m_ChunkGrid[slot / m_windowSize][slot % m_windowSize] = chunks[i];
+        m_idleFrames[slot] = 0;
+
+        // The new chunk and the border faces of its neighbors need meshes
+        MarkDirty(chunkX, chunkZ);
+        MarkDirty(chunkX - 1, chunkZ);
+        MarkDirty(chunkX + 1, chunkZ);
+        MarkDirty(chunkX, chunkZ - 1);
+        MarkDirty(chunkX, chunkZ + 1);
+    }
+
+    // The journal's writer thread flushes the stored chunks
+    LinkNeighbors();
+    LightLoadedChunks(chunks);
+    MarkLightDirty();
+    return (int)entered.size();
+}
+
+bool ChunkManager::Save()
+{
+    if (m_regionStore == nullptr)
+    {
+        return true;
+    }
+    for (int chunkX = m_originX; chunkX < m_originX + m_windowSize; ++chunkX)
+    {
+        for (int chunkZ = m_originZ; chunkZ < m_originZ + m_windowSize; ++chunkZ)
+        {
+            const int slot = SlotIndex(chunkX, chunkZ);
+            if (m_unsavedChunks[slot])
             {
-                chunk->SetLeftNeighbor(m_ChunkGrid[x + 1][y]);
+                m_regionStore->StoreChunk(chunkX, chunkZ, *GetChunk(slot));
+                m_unsavedChunks[slot] = false;
             }
         }
     }
+    return m_regionStore->Flush();
 }
 
-ChunkManager::~ChunkManager()
+std::vector<Chunk *> ChunkManager::LoadOrGenerateChunks(const std::vector<std::pair<int, int>> &coordinates)
 {
-    for (int x = 0; x < CHUNK_GRID_SIZE; ++x)
+    std::vector<Chunk *> chunks;
+    if (m_journal != nullptr)
     {
-        for (int z = 0; z < CHUNK_GRID_SIZE; ++z)
+        // Generated chunks are saved as well, loading them back is cheaper than generating them
+        std::vector<uint8_t> unsaved;
+        m_journal->LoadChunks(coordinates, chunks, unsaved);
+        for (size_t i = 0; i < coordinates.size(); ++i)
         {
-            delete m_ChunkGrid[x][z];
+            m_unsavedChunks[SlotIndex(coordinates[i].first, coordinates[i].second)] = unsaved[i];
         }
+        return chunks;
+    }
+    for (const std::pair<int, int> &coordinate : coordinates)
+    {
+        m_unsavedChunks[SlotIndex(coordinate.first, coordinate.second)] = false;
+        chunks.push_back(new Chunk(m_perlin, coordinate.first, coordinate.second));
     }
+    return chunks;
 }
 
-void ChunkManager::GenerateChunks()
+int ChunkManager::CompressColdChunks()
 {
+    TRACE_SCOPE("ChunkManager::CompressColdChunks");
+    int compressed = 0;
+    for (int slot = 0; slot < GetChunkCount(); ++slot)
+    {
+        Chunk *chunk = GetChunk(slot);
+        if (chunk->TakeAccessed())
+        {
+            m_idleFrames[slot] = 0;
+            continue;
+        }
+        m_idleFrames[slot]++;
+        // The budget spreads the work of a window gone cold over several frames
+        if (m_idleFrames[slot] >= COLD_FRAMES && !chunk->IsCompressed() && compressed < MAX_COMPRESSIONS_PER_FRAME)
+        {
+            chunk->Compress();
+            compressed++;
+        }
+    }
+    return compressed;
 }
 
-const std::vector<GLfloat> ChunkManager::GetVertexData()
+bool ChunkManager::IsChunkLoaded(int chunkX, int chunkZ) const
 {
-    std::vector<GLfloat> vertices;
-    GLuint baseIndex = 0;
+    return chunkX >= m_originX && chunkX < m_originX + m_windowSize &&
+           chunkZ >= m_originZ && chunkZ < m_originZ + m_windowSize;
+}
+
+glm::ivec2 ChunkManager::GetWindowOrigin() const
+{
+    return glm::ivec2(m_originX, m_originZ);
+}
+
+int ChunkManager::GetWindowSize() const
+{
+    return m_windowSize;
+}
+
+int ChunkManager::SlotIndex(int chunkX, int chunkZ) const
+{
+    // Chunks wrap around the grid so a loaded chunk keeps its slot while the window moves
+    const int slotX = ((chunkX % m_windowSize) + m_windowSize) % m_windowSize;
+    const int slotZ = ((chunkZ % m_windowSize) + m_windowSize) % m_windowSize;
+    return slotX * m_windowSize + slotZ;
+}
+
+int ChunkManager::FloorDiv(int value, int divisor)
+{
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
 
-    for (int x = 0; x < CHUNK_GRID_SIZE; ++x)
+void ChunkManager::LinkNeighbors()
+{
+    for (int chunkX = m_originX; chunkX < m_originX + m_windowSize; ++chunkX)
     {
-        for (int z = 0; z < CHUNK_GRID_SIZE; ++z)
+        for (int chunkZ = m_originZ; chunkZ < m_originZ + m_windowSize; ++chunkZ)
         {
-            std::vector<GLfloat> chunkVertices = m_ChunkGrid[x][z]->GetVertexData(x, z, m_indexes, baseIndex);
-            vertices.insert(vertices.end(), chunkVertices.begin(), chunkVertices.end());
+            Chunk *chunk = GetChunk(SlotIndex(chunkX, chunkZ));
+
+            // Set the pointers to the neighboring chunks, chunks on the edge of the window have none
+            chunk->SetBackNeighbor(IsChunkLoaded(chunkX, chunkZ - 1) ? GetChunk(SlotIndex(chunkX, chunkZ - 1)) : nullptr);
+            chunk->SetFrontNeighbor(IsChunkLoaded(chunkX, chunkZ + 1) ? GetChunk(SlotIndex(chunkX, chunkZ + 1)) : nullptr);
+            chunk->SetRightNeighbor(IsChunkLoaded(chunkX - 1, chunkZ) ? GetChunk(SlotIndex(chunkX - 1, chunkZ)) : nullptr);
+            chunk->SetLeftNeighbor(IsChunkLoaded(chunkX + 1, chunkZ) ? GetChunk(SlotIndex(chunkX + 1, chunkZ)) : nullptr);
         }
     }
+}
+
+int ChunkManager::GetChunkCount() const
+{
+    return m_windowSize * m_windowSize;
+}
+
+Chunk *ChunkManager::GetChunk(int index)
+{
+    return m_ChunkGrid[index / m_windowSize][index % m_windowSize];
+}
 
+const std::vector<GLfloat> ChunkManager::GetChunkVertexData(int index, std::vector<GLuint> &indices)
+{
+    std::vector<GLfloat> vertices;
+    Chunk *chunk = GetChunk(index);
+    const int level = m_lods[index];
+    m_meshLods[index] = level;
+    // Same side order as the skirt bits: -x, +x, -z, +z
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int skirtSides = 0;
+    for (int side = 0; side < 4; ++side)
+    {
+        const glm::ivec2 coordinates = chunk->GetCoordinates() + glm::ivec2(offsets[side][0], offsets[side][1]);
+        if (IsChunkLoaded(coordinates.x, coordinates.y) && m_lods[SlotIndex(coordinates.x, coordinates.y)] != level)
+        {
+            skirtSides |= 1 << side;
+        }
+    }
+    uint64_t key = 0;
+    if (m_meshCache)
+    {
+        key = chunk->HashMeshInputs(level, skirtSides);
+        if (m_meshCache->Find(key, vertices, indices))
+        {
+            return vertices;
+        }
+    }
+    if (level == 0)
+    {
+        chunk->BuildMesh(vertices, indices, skirtSides);
+    }
+    else
+    {
+        chunk->BuildLodMesh(level, skirtSides, vertices, indices);
+    }
+    if (m_meshCache)
+    {
+        const glm::ivec2 coordinates = chunk->GetCoordinates();
+        m_meshCache->Store(coordinates.x, coordinates.y, key, vertices, indices);
+    }
     return vertices;
 }
 
-const std::vector<GLuint> ChunkManager::GetIndexData()
+int ChunkManager::UpdateLevelsOfDetail(const glm::vec3 &eye)
+{
+    TRACE_SCOPE("ChunkManager::UpdateLevelsOfDetail");
+    int switched = 0;
+    for (int chunkX = m_originX; chunkX < m_originX + m_windowSize; ++chunkX)
+    {
+        for (int chunkZ = m_originZ; chunkZ < m_originZ + m_windowSize; ++chunkZ)
+        {
+            const glm::vec2 center = (glm::vec2(chunkX, chunkZ) + 0.5f) * (float)Chunk::CHUNK_SIZE;
+            const float distance = glm::length(center - glm::vec2(eye.x, eye.z));
+            const int slot = SlotIndex(chunkX, chunkZ);
+            int level = m_lods[slot];
+            while (level < LOD_LEVELS - 1 && distance > m_lodDistances[level + 1] + LOD_HYSTERESIS)
+            {
+                level++;
+            }
+            while (level > 0 && distance < m_lodDistances[level] - LOD_HYSTERESIS)
+            {
+                level--;
+            }
+            if (level == m_lods[slot])
+            {
+                continue;
+            }
+            m_lods[slot] = level;
+            MarkDirty(chunkX, chunkZ);
+            MarkDirty(chunkX - 1, chunkZ);
+            MarkDirty(chunkX + 1, chunkZ);
+            MarkDirty(chunkX, chunkZ - 1);
+            MarkDirty(chunkX, chunkZ + 1);
+            switched++;
+        }
+    }
+    return switched;
+}
+
+void ChunkManager::SetLodDistance(int level, float distance)
+{
+    if (level > 0 && level < LOD_LEVELS)
+    {
+        m_lodDistances[level] = distance;
+    }
+}
+
+int ChunkManager::GetLevelOfDetail(int index) const
+{
+    return m_lods[index];
+}
+
+void ChunkManager::TakeDirtyChunks(std::vector<int> &dirtyChunks)
+{
+    dirtyChunks.clear();
+    for (int i = 0; i < (int)m_dirtyChunks.size(); ++i)
+    {
+        if (m_dirtyChunks[i])
+        {
+            dirtyChunks.push_back(i);
+            m_dirtyChunks[i] = false;
+        }
+    }
+}
+
+void ChunkManager::MarkDirty(int chunkX, int chunkZ)
+{
+    if (IsChunkLoaded(chunkX, chunkZ))
+    {
+        m_dirtyChunks[SlotIndex(chunkX, chunkZ)] = true;
+    }
+}
+
+void ChunkManager::MarkLightDirty()
+{
+    std::vector<Chunk *> changed;
+    m_lightEngine.TakeChangedChunks(changed);
+    for (Chunk *chunk : changed)
+    {
+        const glm::ivec2 coordinates = chunk->GetCoordinates();
+        MarkDirty(coordinates.x, coordinates.y);
+        // Light is saved with the voxels
+        if (IsChunkLoaded(coordinates.x, coordinates.y))
+        {
+            m_unsavedChunks[SlotIndex(coordinates.x, coordinates.y)] = true;
+        }
+    }
+}
+
+void ChunkManager::LightLoadedChunks(const std::vector<Chunk *> &chunks)
+{
+    // Sorted out before any is lit, lighting a chunk spreads light into its neighbors
+    std::vector<Chunk *> unlit;
+    for (Chunk *chunk : chunks)
+    {
+        const glm::ivec2 coordinates = chunk->GetCoordinates();
+        const int slot = SlotIndex(coordinates.x, coordinates.y);
+        if (!m_unsavedChunks[slot] && chunk->HasLight())
+        {
+            m_savedLightChunks.push_back({coordinates.x, coordinates.y});
+            continue;
+        }
+        m_unsavedChunks[slot] = true;
+        unlit.push_back(chunk);
+    }
+    for (Chunk *chunk : unlit)
+    {
+        m_lightEngine.LightChunk(chunk);
+    }
+}
+
+int ChunkManager::RelightSavedChunks()
+{
+    if (m_savedLightChunks.empty())
+    {
+        return 0;
+    }
+    TRACE_SCOPE("ChunkManager::RelightSavedChunks");
+    // Light changes at most a chunk past a relit one, only those chunks are compared
+    std::vector<Chunk *> batch;
+    std::vector<int> around;
+    while (!m_savedLightChunks.empty() && batch.size() < MAX_RELIGHTS_PER_FRAME)
+    {
+        const std::pair<int, int> coordinates = m_savedLightChunks.back();
+        m_savedLightChunks.pop_back();
+        // Chunks that left the window meanwhile are dropped
+        if (!IsChunkLoaded(coordinates.first, coordinates.second))
+        {
+            continue;
+        }
+        batch.push_back(GetChunk(SlotIndex(coordinates.first, coordinates.second)));
+        for (int x = coordinates.first - 1; x <= coordinates.first + 1; ++x)
+        {
+            for (int z = coordinates.second - 1; z <= coordinates.second + 1; ++z)
+            {
+                if (IsChunkLoaded(x, z))
+                {
+                    around.push_back(SlotIndex(x, z));
+                }
+            }
+        }
+    }
+    std::sort(around.begin(), around.end());
+    around.erase(std::unique(around.begin(), around.end()), around.end());
+    std::vector<uint64_t> hashes;
+    for (int slot : around)
+    {
+        hashes.push_back(GetChunk(slot)->HashLight());
+    }
+
+    m_lightEngine.RelightChunks(batch);
+    // Meshes and saves only need to change where the light did
+    std::vector<Chunk *> changed;
+    m_lightEngine.TakeChangedChunks(changed);
+    for (size_t i = 0; i < around.size(); ++i)
+    {
+        Chunk *chunk = GetChunk(around[i]);
+        if (chunk->HashLight() == hashes[i])
+        {
+            continue;
+        }
+        const glm::ivec2 coordinates = chunk->GetCoordinates();
+        m_unsavedChunks[around[i]] = true;
+        MarkDirty(coordinates.x, coordinates.y);
+        MarkDirty(coordinates.x - 1, coordinates.y);
+        MarkDirty(coordinates.x + 1, coordinates.y);
+        MarkDirty(coordinates.x, coordinates.y - 1);
+        MarkDirty(coordinates.x, coordinates.y + 1);
+    }
+    return (int)m_savedLightChunks.size();
+}
+
+const LightEngine &ChunkManager::GetLightEngine() const
+{
+    return m_lightEngine;
+}
+
+const MeshCache *ChunkManager::GetMeshCache() const
+{
+    return m_meshCache.get();
+}
+
+void ChunkManager::CullChunks(OcclusionCuller &culler, const glm::mat4 &viewProjection, const glm::vec3 &eye,
+                              std::vector<int> &visibleChunks)
 {
+    TRACE_SCOPE("ChunkManager::CullChunks");
+    visibleChunks.clear();
+    culler.BeginFrame(viewProjection);
+
+    // Sort the chunks front to back so the nearest ones become occluders
+    std::vector<std::pair<float, int>> byDistance;
+    std::vector<AABB> cullingBounds(GetChunkCount());
+    for (int i = 0; i < GetChunkCount(); ++i)
+    {
+        cullingBounds[i] = GetCullingBounds(i);
+        const AABB &bounds = cullingBounds[i];
+        const glm::vec3 closest = glm::clamp(eye, bounds.min, bounds.max);
+        byDistance.push_back({glm::dot(closest - eye, closest - eye), i});
+    }
+    std::sort(byDistance.begin(), byDistance.end());
 
-    return m_indexes;
+    int occluderChunks = 0;
+    for (const std::pair<float, int> &entry : byDistance)
+    {
+        if (occluderChunks >= MAX_OCCLUDER_CHUNKS)
+        {
+            break;
+        }
+        Chunk *chunk = GetChunk(entry.second);
+        // A coarse mesh may leave holes where the voxels are solid, only full detail chunks occlude
+        if (std::max(m_lods[entry.second], m_meshLods[entry.second]) > 0 ||
+            !culler.IsInFrustum(chunk->GetBounds()) || chunk->GetOccluders().empty())
+        {
+            continue;
+        }
+        for (const AABB &box : chunk->GetOccluders())
+        {
+            culler.AddOccluder(box);
+        }
+        occluderChunks++;
+    }
+    culler.RasterizeOccluders();
+
+    for (const std::pair<float, int> &entry : byDistance)
+    {
+        const AABB &bounds = cullingBounds[entry.second];
+        // Empty chunks have nothing to draw
+        if (bounds.min == bounds.max)
+        {
+            continue;
+        }
+        if (culler.TestVisibility(bounds))
+        {
+            visibleChunks.push_back(entry.second);
+        }
+    }
+    culler.GetStats().chunksVisible = visibleChunks.size();
+}
+
+AABB ChunkManager::GetCullingBounds(int index)
+{
+    Chunk *chunk = GetChunk(index);
+    AABB bounds = chunk->GetBounds();
+    const int level = std::max(m_lods[index], m_meshLods[index]);
+    if (level == 0 || bounds.min == bounds.max)
+    {
+        return bounds;
+    }
+    // Cells are aligned to the chunk, which is a whole number of them wide
+    const float scale = (float)(1 << level);
+    const glm::ivec2 corner = chunk->GetCoordinates() * Chunk::CHUNK_SIZE;
+    const glm::vec3 origin((float)corner.x, 0.0f, (float)corner.y);
+    bounds.min = origin + glm::floor((bounds.min - origin) / scale) * scale;
+    bounds.max = origin + glm::ceil((bounds.max - origin) / scale) * scale;
+    return bounds;
 }
 
 void ChunkManager::UpdateChunks(int x, int y, int z)
 {
-    bool blockUpdated = false; 
+    SetBlock(x, y, z, false);
+}
+
+void ChunkManager::SetBlock(int x, int y, int z, bool active)
+{
+    TRACE_SCOPE("ChunkManager::SetBlock");
+    const int chunkX = FloorDiv(x, Chunk::CHUNK_SIZE);
+    const int chunkZ = FloorDiv(z, Chunk::CHUNK_SIZE);
+    if (!IsChunkLoaded(chunkX, chunkZ) || y < 0 || y >= Chunk::CHUNK_SIZE)
+    {
+        return;
+    }
+
+    Chunk *chunk = GetChunk(SlotIndex(chunkX, chunkZ));
+    const int localX = x - chunkX * Chunk::CHUNK_SIZE;
+    const int localZ = z - chunkZ * Chunk::CHUNK_SIZE;
+    // Placing onto a solid voxel or breaking air changes nothing, so nothing is journaled, relit or remeshed
+    if (chunk->IsSolid(localX, y, localZ) == active)
+    {
+        return;
+    }
+
+    uint16_t changed[Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE] = {};
+    changed[localX * Chunk::CHUNK_SIZE + localZ] = (uint16_t)(1 << y);
+    BeginTransaction();
+    m_history.Record(chunkX, chunkZ, changed);
+    const int emission = chunk->GetEmission(localX, y, localZ);
+    if (active && emission > 0)
+    {
+        m_history.RecordEmitters(chunkX, chunkZ, {{EmitterIndex(localX, y, localZ), (uint8_t)emission}});
+    }
+    EndTransaction();
+    chunk->UpdateBlock(x, y, z, active);
+    m_lightEngine.UpdateBlock(chunk, localX, y, localZ);
+    MarkLightDirty();
+    MarkDirty(chunkX, chunkZ);
+    m_unsavedChunks[SlotIndex(chunkX, chunkZ)] = true;
+    if (m_journal != nullptr)
+    {
+        m_journal->Append(chunkX, chunkZ, localX, y, localZ, active);
+    }
+
+    // Faces of the neighboring chunk may have been uncovered too
+    if (localX == 0)
+    {
+        MarkDirty(chunkX - 1, chunkZ);
+    }
+    else if (localX == Chunk::CHUNK_SIZE - 1)
+    {
+        MarkDirty(chunkX + 1, chunkZ);
+    }
+    if (localZ == 0)
+    {
+        MarkDirty(chunkX, chunkZ - 1);
+    }
+    else if (localZ == Chunk::CHUNK_SIZE - 1)
+    {
+        MarkDirty(chunkX, chunkZ + 1);
+    }
+}
+
+template <typename ColumnEdit>
+int ChunkManager::EditColumns(const glm::ivec3 &min, const glm::ivec3 &max, int uniform, ColumnEdit edit)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    const int minX = std::max(min.x, m_originX * size);
+    const int maxX = std::min(max.x, (m_originX + m_windowSize) * size);
+    const int minZ = std::max(min.z, m_originZ * size);
+    const int maxZ = std::min(max.z, (m_originZ + m_windowSize) * size);
+    const int minY = std::max(min.y, 0);
+    const int maxY = std::min(max.y, size);
+    if (minX >= maxX || minZ >= maxZ || minY >= maxY)
+    {
+        return 0;
+    }
+    const uint16_t bits = (uint16_t)(((1u << maxY) - 1) & ~((1u << minY) - 1));
+
+    int changedBlocks = 0;
+    std::vector<Chunk *> edited;
+    uint16_t masks[size * size];
+    uint16_t changed[size * size];
+    BeginTransaction();
+    for (int chunkX = FloorDiv(minX, size); chunkX <= FloorDiv(maxX - 1, size); ++chunkX)
+    {
+        for (int chunkZ = FloorDiv(minZ, size); chunkZ <= FloorDiv(maxZ - 1, size); ++chunkZ)
+        {
+            const int slot = SlotIndex(chunkX, chunkZ);
+            Chunk *chunk = GetChunk(slot);
+            const bool covered = minX <= chunkX * size && maxX >= (chunkX + 1) * size &&
+                                 minZ <= chunkZ * size && maxZ >= (chunkZ + 1) * size && bits == Chunk::FULL_COLUMN;
+            const std::vector<std::pair<uint16_t, uint8_t>> emitters = chunk->GetEmitters();
+            int count = 0;
+            if (covered && uniform >= 0)
+            {
+                std::fill(std::begin(masks), std::end(masks), uniform ? Chunk::FULL_COLUMN : 0);
+                count = chunk->Fill(uniform != 0, changed);
+            }
+            else
+            {
+                for (int x = 0; x < size; ++x)
+                {
+                    for (int z = 0; z < size; ++z)
+                    {
+                        const int worldX = chunkX * size + x;
+                        const int worldZ = chunkZ * size + z;
+                        masks[x * size + z] = chunk->GetColumnMask(x, z);
+                        if (worldX >= minX && worldX < maxX && worldZ >= minZ && worldZ < maxZ)
+                        {
+                            masks[x * size + z] = edit(worldX, worldZ, masks[x * size + z], bits);
+                        }
+                    }
+                }
+                count = chunk->SetColumnMasks(masks, changed);
+            }
+            if (count > 0)
+            {
+                changedBlocks += count;
+                edited.push_back(chunk);
+                CommitChunkEdit(chunkX, chunkZ, masks, changed, true);
+                const std::vector<std::pair<uint16_t, uint8_t>> putOut = CoveredEmitters(chunk, emitters);
+                if (!putOut.empty())
+                {
+                    m_history.RecordEmitters(chunkX, chunkZ, putOut);
+                }
+            }
+        }
+    }
+
+    if (!edited.empty())
+    {
+        m_lightEngine.RelightChunks(edited);
+        MarkLightDirty();
+    }
+    EndTransaction();
+    return changedBlocks;
+}
+
+void ChunkManager::CommitChunkEdit(int chunkX, int chunkZ, const uint16_t *masks, const uint16_t *changed, bool record)
+{
+    const int size = Chunk::CHUNK_SIZE;
+    m_unsavedChunks[SlotIndex(chunkX, chunkZ)] = true;
+    MarkDirty(chunkX, chunkZ);
+    if (record)
+    {
+        m_history.Record(chunkX, chunkZ, changed);
+    }
+
+    // Journal the flipped voxels and find the borders they are on
+    std::vector<std::pair<uint16_t, bool>> edits;
+    uint16_t borders[4] = {};
+    for (int x = 0; x < size; ++x)
+    {
+        for (int z = 0; z < size; ++z)
+        {
+            const uint16_t flipped = changed[x * size + z];
+            for (unsigned bit = flipped; bit != 0; bit &= bit - 1)
+            {
+                const int y = __builtin_ctz(bit);
+                edits.push_back({(uint16_t)((x * size + y) * size + z), (bool)((masks[x * size + z] >> y) & 1)});
+            }
+            borders[0] |= x == 0 ? flipped : 0;
+            borders[1] |= x == size - 1 ? flipped : 0;
+            borders[2] |= z == 0 ? flipped : 0;
+            borders[3] |= z == size - 1 ? flipped : 0;
+        }
+    }
+    if (m_journal != nullptr)
+    {
+        m_journal->AppendBatch(chunkX, chunkZ, edits);
+    }
+    // Faces of the neighboring chunks may have been uncovered too
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (int side = 0; side < 4; ++side)
+    {
+        if (borders[side] != 0)
+        {
+            MarkDirty(chunkX + offsets[side][0], chunkZ + offsets[side][1]);
+        }
+    }
+}
+
+bool ChunkManager::ApplyDeltas(const std::vector<EditHistory::ChunkDelta> &deltas, bool undo)
+{
+    // All or nothing, a step whose chunks left the window waits until they are back
+    for (const EditHistory::ChunkDelta &delta : deltas)
+    {
+        if (!IsChunkLoaded(delta.chunkX, delta.chunkZ))
+        {
+            return false;
+        }
+    }
+    const int size = Chunk::CHUNK_SIZE;
+    std::vector<Chunk *> edited;
+    uint16_t masks[size * size];
+    uint16_t changed[size * size];
+    std::vector<std::pair<uint16_t, uint8_t>> emitters;
+    for (const EditHistory::ChunkDelta &delta : deltas)
+    {
+        Chunk *chunk = GetChunk(SlotIndex(delta.chunkX, delta.chunkZ));
+        EditHistory::DecodeDelta(delta, masks);
+        EditHistory::DecodeEmitters(delta, emitters);
+        for (int column = 0; column < size * size; ++column)
+        {
+            masks[column] ^= chunk->GetColumnMask(column / size, column % size);
+        }
+        const bool flipped = chunk->SetColumnMasks(masks, changed) > 0;
+        if (flipped)
+        {
+            CommitChunkEdit(delta.chunkX, delta.chunkZ, masks, changed, false);
+        }
+        // Undo lights the sources the step put out again, redo puts out those the flips left lit
+        for (const std::pair<uint16_t, uint8_t> &emitter : emitters)
+        {
+            const int x = emitter.first / (size * size), y = (emitter.first / size) % size, z = emitter.first % size;
+            if (!chunk->IsSolid(x, y, z))
+            {
+                chunk->SetEmission(x, y, z, undo ? emitter.second : 0);
+                if (m_journal != nullptr)
+                {
+                    m_journal->AppendLight(delta.chunkX, delta.chunkZ, x, y, z, chunk->GetEmission(x, y, z));
+                }
+            }
+        }
+        if (!emitters.empty())
+        {
+            m_unsavedChunks[SlotIndex(delta.chunkX, delta.chunkZ)] = true;
+        }
+        if (flipped || !emitters.empty())
+        {
+            edited.push_back(chunk);
+        }
+    }
+    if (!edited.empty())
+    {
+        m_lightEngine.RelightChunks(edited);
+        MarkLightDirty();
+    }
+    return true;
+}
+
+void ChunkManager::BeginTransaction()
+{
+    m_transactionDepth++;
+}
 
-    for (int j = 0; j < CHUNK_GRID_SIZE; ++j)
+void ChunkManager::EndTransaction()
+{
+    if (m_transactionDepth > 0 && --m_transactionDepth == 0)
     {
-        for (int m = 0; m < CHUNK_GRID_SIZE; ++m)
+        m_history.Commit();
+    }
+}
+
+bool ChunkManager::Undo()
+{
+    TRACE_SCOPE("ChunkManager::Undo");
+    const std::vector<EditHistory::ChunkDelta> *deltas = m_history.GetUndo();
+    if (m_transactionDepth > 0 || deltas == nullptr || !ApplyDeltas(*deltas, true))
+    {
+        return false;
+    }
+    m_history.PopUndo();
+    return true;
+}
+
+bool ChunkManager::Redo()
+{
+    TRACE_SCOPE("ChunkManager::Redo");
+    const std::vector<EditHistory::ChunkDelta> *deltas = m_history.GetRedo();
+    if (m_transactionDepth > 0 || deltas == nullptr || !ApplyDeltas(*deltas, false))
+    {
+        return false;
+    }
+    m_history.PopRedo();
+    return true;
+}
+
+EditHistory &ChunkManager::GetEditHistory()
+{
+    return m_history;
+}
+
+int ChunkManager::FillBox(const glm::ivec3 &min, const glm::ivec3 &max, bool active)
+{
+    TRACE_SCOPE("ChunkManager::FillBox");
+    return EditColumns(min, max, active, [&](int, int, uint16_t mask, uint16_t bits)
+                       { return (uint16_t)(active ? mask | bits : mask & ~bits); });
+}
+
+int ChunkManager::FillSphere(const glm::vec3 &center, float radius, bool active)
+{
+    TRACE_SCOPE("ChunkManager::FillSphere");
+    const glm::ivec3 min = glm::ivec3(glm::floor(center - radius));
+    const glm::ivec3 max = glm::ivec3(glm::floor(center + radius)) + 1;
+    return EditColumns(min, max, -1, [&](int x, int z, uint16_t mask, uint16_t bits)
+                       {
+                           // The run of the column whose block centers are inside the sphere
+                           const float dx = x + 0.5f - center.x;
+                           const float dz = z + 0.5f - center.z;
+                           const float squared = radius * radius - dx * dx - dz * dz;
+                           if (squared < 0.0f)
+                           {
+                               return mask;
+                           }
+                           const float half = std::sqrt(squared);
+                           const int bottom = std::max(0, (int)std::ceil(center.y - half - 0.5f));
+                           const int top = std::min((int)Chunk::CHUNK_SIZE - 1, (int)std::floor(center.y + half - 0.5f));
+                           if (bottom > top)
+                           {
+                               return mask;
+                           }
+                           const uint16_t run = (uint16_t)(((1u << (top + 1)) - 1) & ~((1u << bottom) - 1)) & bits;
+                           return (uint16_t)(active ? mask | run : mask & ~run);
+                       });
+}
+
+int ChunkManager::ReplaceInBox(const glm::ivec3 &min, const glm::ivec3 &max, bool from, bool to)
+{
+    TRACE_SCOPE("ChunkManager::ReplaceInBox");
+    if (from == to)
+    {
+        return 0;
+    }
+    // Every block of a chunk inside the box is either of the kind replaced or already the other
+    return EditColumns(min, max, to, [&](int, int, uint16_t mask, uint16_t bits)
+                       {
+                           const uint16_t matching = bits & (from ? mask : (uint16_t)~mask);
+                           return (uint16_t)(to ? mask | matching : mask & ~matching);
+                       });
+}
+
+void ChunkManager::SetLightSource(int x, int y, int z, int level)
+{
+    const int chunkX = FloorDiv(x, Chunk::CHUNK_SIZE);
+    const int chunkZ = FloorDiv(z, Chunk::CHUNK_SIZE);
+    if (!IsChunkLoaded(chunkX, chunkZ) || y < 0 || y >= Chunk::CHUNK_SIZE)
+    {
+        return;
+    }
+    const int slot = SlotIndex(chunkX, chunkZ);
+    Chunk *chunk = GetChunk(slot);
+    const int localX = x - chunkX * Chunk::CHUNK_SIZE;
+    const int localZ = z - chunkZ * Chunk::CHUNK_SIZE;
+    if (chunk->IsSolid(localX, y, localZ))
+    {
+        return;
+    }
+    m_lightEngine.SetEmitter(chunk, localX, y, localZ, level);
+    MarkLightDirty();
+    m_unsavedChunks[slot] = true;
+    if (m_journal != nullptr)
+    {
+        m_journal->AppendLight(chunkX, chunkZ, localX, y, localZ, chunk->GetEmission(localX, y, localZ));
+    }
+}
+
+int ChunkManager::GetSurfaceHeight(int x, int z)
+{
+    const int chunkX = FloorDiv(x, Chunk::CHUNK_SIZE);
+    const int chunkZ = FloorDiv(z, Chunk::CHUNK_SIZE);
+    if (!IsChunkLoaded(chunkX, chunkZ))
+    {
+        return -1;
+    }
+    return GetChunk(SlotIndex(chunkX, chunkZ))->GetColumnHeight(x - chunkX * Chunk::CHUNK_SIZE, z - chunkZ * Chunk::CHUNK_SIZE);
+}
+
+bool ChunkManager::Raycast(const glm::vec3 &origin, const glm::vec3 &direction, float maxDistance, RaycastHit &hit)
+{
+    TRACE_SCOPE("ChunkManager::Raycast");
+    const int size = Chunk::CHUNK_SIZE;
+    const float length = glm::length(direction);
+    if (!(length > 0.0f))
+    {
+        return false;
+    }
+    const glm::vec3 ray = direction / length;
+
+    // Distance along the ray to the next voxel boundary on each axis, and between boundaries
+    glm::ivec3 voxel = glm::ivec3(glm::floor(origin));
+    glm::ivec3 step(0);
+    glm::vec3 nextBoundary(INFINITY), boundaryDelta(INFINITY);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (ray[axis] > 0.0f)
+        {
+            step[axis] = 1;
+            nextBoundary[axis] = (voxel[axis] + 1 - origin[axis]) / ray[axis];
+            boundaryDelta[axis] = 1.0f / ray[axis];
+        }
+        else if (ray[axis] < 0.0f)
+        {
+            step[axis] = -1;
+            nextBoundary[axis] = (voxel[axis] - origin[axis]) / ray[axis];
+            boundaryDelta[axis] = -1.0f / ray[axis];
+        }
+    }
+
+    // The chunk under the ray and the voxel's position in it, both stepped along with the voxel
+    int chunkX = FloorDiv(voxel.x, size);
+    int chunkZ = FloorDiv(voxel.z, size);
+    int localX = voxel.x - chunkX * size;
+    int localZ = voxel.z - chunkZ * size;
+    Chunk *chunk = nullptr;
+    bool chunkChanged = true;
+
+    glm::ivec3 normal(0);
+    float distance = 0.0f;
+    while (distance <= maxDistance)
+    {
+        if (chunkChanged)
+        {
+            chunkChanged = false;
+            chunk = IsChunkLoaded(chunkX, chunkZ) ? GetChunk(SlotIndex(chunkX, chunkZ)) : nullptr;
+        }
+        if (voxel.y >= 0 && voxel.y < size)
         {
-            if (m_ChunkGrid[j][m]->IsInBounds(x, y, z))
+            // The column masks answer without waking compressed chunks
+            if (chunk != nullptr && chunk->IsSolid(localX, voxel.y, localZ))
             {
-                std::cout << "In Chunk " << j << ", " << m << std::endl;
-                m_ChunkGrid[j][m]->UpdateBlock(x, y, z, false);
-                blockUpdated = true;
-                break;
+                hit.block = voxel;
+                hit.normal = normal;
+                hit.distance = distance;
+                return true;
             }
         }
-        
-        if (blockUpdated)
+        else if ((voxel.y < 0 && step.y <= 0) || (voxel.y >= size && step.y >= 0))
+        {
+            // Left the world through the top or bottom for good
+            return false;
+        }
+
+        // Cross the nearest boundary
+        const int axis = nextBoundary.x < nextBoundary.y ? (nextBoundary.x < nextBoundary.z ? 0 : 2)
+                                                         : (nextBoundary.y < nextBoundary.z ? 1 : 2);
+        distance = nextBoundary[axis];
+        nextBoundary[axis] += boundaryDelta[axis];
+        voxel[axis] += step[axis];
+        normal = glm::ivec3(0);
+        normal[axis] = -step[axis];
+        if (axis == 0)
         {
-            break;  // Break out of the upper for loop
+            localX += step.x;
+            if (localX < 0 || localX >= size)
+            {
+                localX -= step.x * size;
+                chunkX += step.x;
+                chunkChanged = true;
+            }
+        }
+        else if (axis == 2)
+        {
+            localZ += step.z;
+            if (localZ < 0 || localZ >= size)
+            {
+                localZ -= step.z * size;
+                chunkZ += step.z;
+                chunkChanged = true;
+            }
         }
     }
-}
\ No newline at end of file
+    return false;
+}
@@ -0,0 +1,281 @@
+#include "EditHistory.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+
+namespace
+{
+    const int COLUMNS = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+    // Per run: first column and count
+    const size_t RUN_HEADER_BYTES = 2;
+    // Run header of the light sources after the runs, past the last column
+    const uint8_t EMITTER_HEADER = 0xFF;
+    const size_t EMITTER_BYTES = 3;
+
+    void EncodeDelta(const std::vector<uint16_t> &masks, std::vector<uint8_t> &runs)
+    {
+        runs.clear();
+        int column = 0;
+        while (column < COLUMNS)
+        {
+            if (masks[column] == 0)
+            {
+                column++;
+                continue;
+            }
+            int end = column;
+            while (end < COLUMNS && masks[end] != 0)
+            {
+                end++;
+            }
+            runs.push_back((uint8_t)column);
+            runs.push_back((uint8_t)(end - column - 1));
+            for (; column < end; ++column)
+            {
+                runs.push_back(masks[column] & 0xFF);
+                runs.push_back(masks[column] >> 8);
+            }
+        }
+        runs.shrink_to_fit();
+    }
+}
+
+EditHistory::EditHistory()
+{
+    m_bytes = 0;
+    m_budget = DEFAULT_BUDGET_BYTES;
+    m_evicted = 0;
+}
+
+EditHistory::~EditHistory()
+{
+    MemoryStats::Remove(MEMORY_EDIT_HISTORY, m_bytes, m_undo.size() + m_redo.size());
+}
+
+void EditHistory::Record(int chunkX, int chunkZ, const uint16_t *changed)
+{
+    std::vector<uint16_t> &masks = m_open[{chunkX, chunkZ}];
+    masks.resize(COLUMNS, 0);
+    for (int column = 0; column < COLUMNS; ++column)
+    {
+        masks[column] ^= changed[column];
+    }
+}
+
+void EditHistory::RecordEmitters(int chunkX, int chunkZ, const std::vector<std::pair<uint16_t, uint8_t>> &emitters)
+{
+    // Kept with the chunk's flips, even when those cancel out
+    m_open[{chunkX, chunkZ}].resize(COLUMNS, 0);
+    std::vector<std::pair<uint16_t, uint8_t>> &recorded = m_openEmitters[{chunkX, chunkZ}];
+    for (const std::pair<uint16_t, uint8_t> &emitter : emitters)
+    {
+        if (std::none_of(recorded.begin(), recorded.end(), [&](const std::pair<uint16_t, uint8_t> &other)
+                         { return other.first == emitter.first; }))
+        {
+            recorded.push_back(emitter);
+        }
+    }
+}
+
+void EditHistory::Commit()
+{
+    Transaction transaction;
+    for (const auto &chunk : m_open)
+    {
+        ChunkDelta delta = {chunk.first.first, chunk.first.second, {}};
+        EncodeDelta(chunk.second, delta.runs);
+        // A light source stays out even when its voxel was emptied again within the transaction
+        const auto emitters = m_openEmitters.find(chunk.first);
+        if (emitters != m_openEmitters.end() && !emitters->second.empty())
+        {
+            delta.runs.push_back(EMITTER_HEADER);
+            delta.runs.push_back(EMITTER_HEADER);
+            for (const std::pair<uint16_t, uint8_t> &emitter : emitters->second)
+            {
+                delta.runs.push_back(emitter.first & 0xFF);
+                delta.runs.push_back(emitter.first >> 8);
+                delta.runs.push_back(emitter.second);
+            }
+            delta.runs.shrink_to_fit();
+        }
+        if (!delta.runs.empty())
+        {
+            transaction.push_back(std::move(delta));
+        }
+    }
+    m_open.clear();
+    m_openEmitters.clear();
+    if (transaction.empty())
+    {
+        return;
+    }
+
+    while (!m_redo.empty())
+    {
+        Drop(m_redo);
+    }
+    const size_t bytes = GetTransactionBytes(transaction);
+    m_undo.push_back(std::move(transaction));
+    m_bytes += bytes;
+    MemoryStats::Add(MEMORY_EDIT_HISTORY, bytes);
+    Evict();
+}
+
+const std::vector<EditHistory::ChunkDelta> *EditHistory::GetUndo() const
+{
+    return m_undo.empty() ? nullptr : &m_undo.back();
+}
+
+const std::vector<EditHistory::ChunkDelta> *EditHistory::GetRedo() const
+{
+    return m_redo.empty() ? nullptr : &m_redo.back();
+}
+
+void EditHistory::PopUndo()
+{
+    if (!m_undo.empty())
+    {
+        m_redo.push_back(std::move(m_undo.back()));
+        m_undo.pop_back();
+    }
+}
+
+void EditHistory::PopRedo()
+{
+    if (!m_redo.empty())
+    {
+        m_undo.push_back(std::move(m_redo.back()));
+        m_redo.pop_back();
+    }
+}
+
+void EditHistory::DropChunks(const std::vector<std::pair<int, int>> &chunks)
+{
+    const std::set<std::pair<int, int>> lost(chunks.begin(), chunks.end());
+    for (const std::pair<int, int> &chunk : lost)
+    {
+        m_open.erase(chunk);
+        m_openEmitters.erase(chunk);
+    }
+    DropThrough(m_undo, lost);
+    DropThrough(m_redo, lost);
+}
+
+void EditHistory::SetBudget(size_t bytes)
+{
+    m_budget = bytes;
+    Evict();
+}
+
+void EditHistory::DecodeDelta(const ChunkDelta &delta, uint16_t *masks)
+{
+    std::fill(masks, masks + COLUMNS, 0);
+    size_t offset = 0;
+    while (offset + RUN_HEADER_BYTES <= delta.runs.size())
+    {
+        const int first = delta.runs[offset];
+        const int count = delta.runs[offset + 1] + 1;
+        if (first == EMITTER_HEADER && count == EMITTER_HEADER + 1)
+        {
+            return;
+        }
+        offset += RUN_HEADER_BYTES;
+        for (int column = first; column < first + count && column < COLUMNS && offset + 2 <= delta.runs.size(); ++column)
+        {
+            masks[column] = delta.runs[offset] | (delta.runs[offset + 1] << 8);
+            offset += 2;
+        }
+    }
+}
+
+void EditHistory::DecodeEmitters(const ChunkDelta &delta, std::vector<std::pair<uint16_t, uint8_t>> &emitters)
+{
+    emitters.clear();
+    size_t offset = 0;
+    while (offset + RUN_HEADER_BYTES <= delta.runs.size())
+    {
+        const bool header = delta.runs[offset] == EMITTER_HEADER && delta.runs[offset + 1] == EMITTER_HEADER;
+        offset += RUN_HEADER_BYTES;
+        if (header)
+        {
+            for (; offset + EMITTER_BYTES <= delta.runs.size(); offset += EMITTER_BYTES)
+            {
+                emitters.push_back({(uint16_t)(delta.runs[offset] | (delta.runs[offset + 1] << 8)), delta.runs[offset + 2]});
+            }
+            return;
+        }
+        offset += 2 * (delta.runs[offset - 1] + 1);
+    }
+}
+
+size_t EditHistory::GetUndoCount() const
+{
+    return m_undo.size();
+}
+
+size_t EditHistory::GetRedoCount() const
+{
+    return m_redo.size();
+}
+
+size_t EditHistory::GetBytes() const
+{
+    return m_bytes;
+}
+
+size_t EditHistory::GetBudget() const
+{
+    return m_budget;
+}
+
+size_t EditHistory::GetEvictedCount() const
+{
+    return m_evicted;
+}
+
+size_t EditHistory::GetTransactionBytes(const Transaction &transaction)
+{
+    size_t bytes = sizeof(Transaction) + transaction.capacity() * sizeof(ChunkDelta);
+    for (const ChunkDelta &delta : transaction)
+    {
+        bytes += delta.runs.capacity();
+    }
+    return bytes;
+}
+
+void EditHistory::Evict()
+{
+    // The past goes first, the redo steps furthest ahead after it
+    while (m_bytes > m_budget && !(m_undo.empty() && m_redo.empty()))
+    {
+        Drop(m_undo.empty() ? m_redo : m_undo);
+        m_evicted++;
+    }
+}
+
+void EditHistory::Drop(std::deque<Transaction> &steps)
+{
+    const size_t bytes = GetTransactionBytes(steps.front());
+    steps.pop_front();
+    m_bytes -= bytes;
+    MemoryStats::Remove(MEMORY_EDIT_HISTORY, bytes);
+}
+
+void EditHistory::DropThrough(std::deque<Transaction> &steps, const std::set<std::pair<int, int>> &chunks)
+{
+    size_t count = 0;
+    for (size_t i = steps.size(); i > 0 && count == 0; --i)
+    {
+        for (const ChunkDelta &delta : steps[i - 1])
+        {
+            if (chunks.count({delta.chunkX, delta.chunkZ}) > 0)
+            {
+                count = i;
+                break;
+            }
+        }
+    }
+    for (; count > 0; --count)
+    {
+        Drop(steps);
+    }
+}
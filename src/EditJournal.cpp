@@ -0,0 +1,540 @@
+#include "EditJournal.hpp"
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+
+#if defined(LINUX) || defined(MAC)
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char JOURNAL_MAGIC[4] = {'V', 'X', 'J', 'N'};
+    const uint8_t JOURNAL_VERSION = 2;
+    // Journals of this version only hold block records, which read the same
+    const uint8_t BLOCK_JOURNAL_VERSION = 1;
+    const size_t HEADER_BYTES = 8;
+    const size_t COMMIT_HEADER_BYTES = 8;
+
+    void WriteU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out.push_back((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    uint32_t ReadU32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    void WriteVarint(std::vector<uint8_t> &out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+
+    // Bounds checked varint, false once the data runs out
+    bool ReadVarint(const std::vector<uint8_t> &data, size_t &offset, uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (offset >= data.size())
+            {
+                return false;
+            }
+            const uint8_t byte = data[offset++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t ZigZag(int value)
+    {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    int UnZigZag(uint32_t value)
+    {
+        return (int)(value >> 1) ^ -(int)(value & 1);
+    }
+
+    uint32_t Checksum(const uint8_t *data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    bool SyncFile(std::FILE *file)
+    {
+        if (std::fflush(file) != 0)
+        {
+            return false;
+        }
+#if defined(LINUX)
+        return fdatasync(fileno(file)) == 0;
+#elif defined(MAC)
+        return fsync(fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+
+    void ApplyEdits(Chunk &chunk, const std::vector<std::pair<uint16_t, uint8_t>> &edits)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        bool blocks = false, changed = false;
+        for (const std::pair<uint16_t, uint8_t> &edit : edits)
+        {
+            const int x = edit.first / (size * size);
+            const int y = (edit.first / size) % size;
+            const int z = edit.first % size;
+            const int emission = chunk.GetEmission(x, y, z);
+            if (edit.second & EditJournal::LIGHT_EDIT)
+            {
+                chunk.SetEmission(x, y, z, edit.second & ~EditJournal::LIGHT_EDIT);
+                changed = changed || emission != (edit.second & ~EditJournal::LIGHT_EDIT);
+                continue;
+            }
+            // A placed block puts out the light source in it, like LightEngine::UpdateBlock
+            if (edit.second != 0 && emission != 0)
+            {
+                chunk.SetEmission(x, y, z, 0);
+                changed = true;
+            }
+            Voxel *voxel = chunk.GetVoxel(x, y, z);
+            blocks = blocks || voxel->IsActive() != (edit.second != 0);
+            voxel->SetActive(edit.second != 0);
+        }
+        if (blocks)
+        {
+            chunk.RebuildColumns();
+        }
+        // The saved light no longer fits, the chunk is lit again when it is loaded. A saved chunk
+        // that has the edits already keeps it
+        if (blocks || changed)
+        {
+            chunk.ClearLight();
+        }
+    }
+}
+
+EditJournal::EditJournal(RegionStore &store, const siv::PerlinNoise &perlin, const std::string &path)
+    : m_store(store), m_perlin(perlin), m_path(path)
+{
+    m_file = nullptr;
+    m_appended = 0;
+    m_syncRequested = false;
+    m_stopping = false;
+    m_running = false;
+    m_unfolded = 0;
+    m_durable = 0;
+    m_commits = 0;
+    m_compactions = 0;
+    m_failed = false;
+}
+
+EditJournal::~EditJournal()
+{
+    Close();
+}
+
+bool EditJournal::Open()
+{
+    TRACE_SCOPE("EditJournal::Open");
+    // Edits of a previous run go straight into the region files
+    std::vector<Edit> edits;
+    ReadJournal(edits);
+    for (const Edit &edit : edits)
+    {
+        m_index[{edit.chunkX, edit.chunkZ}].push_back({edit.index, edit.value});
+    }
+    m_unfolded = edits.size();
+    if (!edits.empty())
+    {
+        std::cout << "Replaying " << edits.size() << " journaled edits" << std::endl;
+    }
+    if (!(edits.empty() ? Truncate() : Compact()))
+    {
+        std::cerr << "Could not open the edit journal " << m_path << std::endl;
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopping = false;
+        m_running = true;
+    }
+    m_writer = std::thread(&EditJournal::WriterLoop, this);
+    return true;
+}
+
+void EditJournal::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    if (m_writer.joinable())
+    {
+        m_writer.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_running = false;
+    }
+    // Without a writer thread the edits only live in memory, save them with the chunks
+    if (GetUnfoldedCount() > 0)
+    {
+        Compact();
+    }
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+uint64_t EditJournal::Append(int chunkX, int chunkZ, int x, int y, int z, bool active)
+{
+    return AppendRecord(chunkX, chunkZ, (x * Chunk::CHUNK_SIZE + y) * Chunk::CHUNK_SIZE + z, active);
+}
+
+uint64_t EditJournal::AppendLight(int chunkX, int chunkZ, int x, int y, int z, int level)
+{
+    return AppendRecord(chunkX, chunkZ, (x * Chunk::CHUNK_SIZE + y) * Chunk::CHUNK_SIZE + z, LIGHT_EDIT | level);
+}
+
+uint64_t EditJournal::AppendRecord(int chunkX, int chunkZ, uint16_t index, uint8_t value)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        m_index[{chunkX, chunkZ}].push_back({index, value});
+        m_unfolded++;
+    }
+
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_running)
+    {
+        m_queue.push_back({chunkX, chunkZ, index, value});
+        if (m_queue.size() >= MAX_BATCH_EDITS)
+        {
+            m_wake.notify_one();
+        }
+    }
+    return ++m_appended;
+}
+
+uint64_t EditJournal::AppendBatch(int chunkX, int chunkZ, const std::vector<std::pair<uint16_t, bool>> &edits)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        std::vector<std::pair<uint16_t, uint8_t>> &chunkEdits = m_index[{chunkX, chunkZ}];
+        chunkEdits.insert(chunkEdits.end(), edits.begin(), edits.end());
+        m_unfolded += edits.size();
+    }
+
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_running)
+    {
+        for (const std::pair<uint16_t, bool> &edit : edits)
+        {
+            m_queue.push_back({chunkX, chunkZ, edit.first, edit.second});
+        }
+        if (m_queue.size() >= MAX_BATCH_EDITS)
+        {
+            m_wake.notify_one();
+        }
+    }
+    m_appended += edits.size();
+    return m_appended;
+}
+
+void EditJournal::LoadChunks(const std::vector<std::pair<int, int>> &coordinates, std::vector<Chunk *> &chunks,
+                             std::vector<uint8_t> &unsaved)
+{
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    chunks.resize(coordinates.size());
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        chunks[i] = new Chunk(coordinates[i].first, coordinates[i].second);
+    }
+    std::vector<uint8_t> loaded;
+    m_store.LoadChunks(coordinates, chunks, loaded);
+
+    unsaved.assign(coordinates.size(), 0);
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        if (!loaded[i])
+        {
+            delete chunks[i];
+            chunks[i] = new Chunk(m_perlin, coordinates[i].first, coordinates[i].second);
+        }
+        auto found = m_index.find(coordinates[i]);
+        if (found != m_index.end())
+        {
+            ApplyEdits(*chunks[i], found->second);
+        }
+        unsaved[i] = !loaded[i] || found != m_index.end();
+    }
+}
+
+void EditJournal::Sync()
+{
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    if (!m_running)
+    {
+        return;
+    }
+    const uint64_t target = m_appended;
+    m_syncRequested = true;
+    m_wake.notify_one();
+    m_committed.wait(lock, [&]
+                     { return m_durable >= target || m_failed || !m_running; });
+}
+
+uint64_t EditJournal::GetAppendedSequence()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_appended;
+}
+
+uint64_t EditJournal::GetDurableSequence() const
+{
+    return m_durable;
+}
+
+uint64_t EditJournal::GetCommitCount() const
+{
+    return m_commits;
+}
+
+uint64_t EditJournal::GetCompactionCount() const
+{
+    return m_compactions;
+}
+
+size_t EditJournal::GetUnfoldedCount()
+{
+    std::lock_guard<std::mutex> lock(m_indexMutex);
+    return m_unfolded;
+}
+
+void EditJournal::WriterLoop()
+{
+    std::vector<Edit> batch;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    while (true)
+    {
+        m_wake.wait_for(lock, std::chrono::milliseconds((int)COMMIT_INTERVAL_MS), [&]
+                        { return m_stopping || m_syncRequested || m_queue.size() >= MAX_BATCH_EDITS; });
+        batch.swap(m_queue);
+        const uint64_t sequence = m_appended;
+        const bool stopping = m_stopping;
+        m_syncRequested = false;
+        lock.unlock();
+
+        // Every edit queued since the last commit shares one write and one fsync
+        if (!batch.empty())
+        {
+            if (Commit(batch))
+            {
+                m_durable = sequence;
+                m_commits++;
+            }
+            else if (!m_failed.exchange(true))
+            {
+                std::cerr << "Could not write the edit journal " << m_path << std::endl;
+            }
+            batch.clear();
+        }
+
+        if (stopping || GetUnfoldedCount() >= COMPACT_EDITS)
+        {
+            Compact();
+        }
+        else if (m_store.GetPendingCount() >= RegionStore::MAX_PENDING_CHUNKS)
+        {
+            m_store.Flush();
+        }
+
+        // Notified under the lock so a waiting Sync can not miss it
+        lock.lock();
+        if (stopping)
+        {
+            // Appends from now on only go into the index, Close folds them
+            m_running = false;
+            m_committed.notify_all();
+            break;
+        }
+        m_committed.notify_all();
+    }
+}
+
+bool EditJournal::Commit(const std::vector<Edit> &batch)
+{
+    TRACE_SCOPE("EditJournal::Commit");
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+    std::vector<uint8_t> records;
+    for (const Edit &edit : batch)
+    {
+        WriteVarint(records, ZigZag(edit.chunkX));
+        WriteVarint(records, ZigZag(edit.chunkZ));
+        records.push_back(edit.index & 0xFF);
+        records.push_back(edit.index >> 8);
+        records.push_back(edit.value);
+    }
+    std::vector<uint8_t> commit;
+    WriteU32(commit, (uint32_t)batch.size());
+    WriteU32(commit, Checksum(records.data(), records.size()));
+    commit.insert(commit.end(), records.begin(), records.end());
+    return std::fwrite(commit.data(), 1, commit.size(), m_file) == commit.size() && SyncFile(m_file);
+}
+
+bool EditJournal::Compact()
+{
+    TRACE_SCOPE("EditJournal::Compact");
+    EditIndex edits;
+    {
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        edits = m_index;
+    }
+
+    for (const auto &entry : edits)
+    {
+        const int chunkX = entry.first.first;
+        const int chunkZ = entry.first.second;
+        bool generated = false;
+        std::unique_ptr<Chunk> chunk(BuildChunk(chunkX, chunkZ, generated));
+        ApplyEdits(*chunk, entry.second);
+
+        // Swap the new copy in and drop the edits it holds, edits appended meanwhile stay
+        std::lock_guard<std::mutex> lock(m_indexMutex);
+        m_store.StoreChunk(chunkX, chunkZ, *chunk);
+        std::vector<std::pair<uint16_t, uint8_t>> &current = m_index[entry.first];
+        current.erase(current.begin(), current.begin() + entry.second.size());
+        m_unfolded -= entry.second.size();
+        if (current.empty())
+        {
+            m_index.erase(entry.first);
+        }
+    }
+
+    // Only once the region files are on disk may the journal forget the edits. Commits happen
+    // on this thread only, so everything committed so far was part of the fold
+    if (!m_store.Flush())
+    {
+        return false;
+    }
+    m_compactions++;
+    return Truncate();
+}
+
+bool EditJournal::Truncate()
+{
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+    }
+    std::error_code error;
+    const std::filesystem::path parent = std::filesystem::path(m_path).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, error);
+    }
+    m_file = std::fopen(m_path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+    const uint8_t header[HEADER_BYTES] = {(uint8_t)JOURNAL_MAGIC[0], (uint8_t)JOURNAL_MAGIC[1], (uint8_t)JOURNAL_MAGIC[2],
+                                          (uint8_t)JOURNAL_MAGIC[3], JOURNAL_VERSION, 0, 0, 0};
+    return std::fwrite(header, 1, HEADER_BYTES, m_file) == HEADER_BYTES && SyncFile(m_file);
+}
+
+void EditJournal::ReadJournal(std::vector<Edit> &edits)
+{
+    edits.clear();
+    std::ifstream file(m_path, std::ios::binary);
+    if (!file)
+    {
+        return;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < HEADER_BYTES || std::memcmp(data.data(), JOURNAL_MAGIC, 4) != 0 ||
+        (data[4] != JOURNAL_VERSION && data[4] != BLOCK_JOURNAL_VERSION))
+    {
+        return;
+    }
+
+    size_t offset = HEADER_BYTES;
+    std::vector<Edit> commit;
+    while (offset + COMMIT_HEADER_BYTES <= data.size())
+    {
+        const uint32_t count = ReadU32(&data[offset]);
+        const uint32_t checksum = ReadU32(&data[offset + 4]);
+        const size_t start = offset + COMMIT_HEADER_BYTES;
+        size_t cursor = start;
+        commit.clear();
+        bool complete = true;
+        for (uint32_t i = 0; i < count && complete; ++i)
+        {
+            uint32_t chunkX, chunkZ;
+            complete = ReadVarint(data, cursor, chunkX) && ReadVarint(data, cursor, chunkZ) && cursor + 3 <= data.size();
+            if (complete)
+            {
+                const uint16_t index = data[cursor] | (data[cursor + 1] << 8);
+                const uint8_t value = data[cursor + 2];
+                const bool light = (value & EditJournal::LIGHT_EDIT) != 0;
+                complete = index < Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE &&
+                           (light ? (value & ~EditJournal::LIGHT_EDIT) <= Voxel::MAX_LIGHT : value <= 1);
+                commit.push_back({UnZigZag(chunkX), UnZigZag(chunkZ), index, value});
+                cursor += 3;
+            }
+        }
+        // A torn write at the end of the file, everything before it is intact
+        if (!complete || Checksum(&data[start], cursor - start) != checksum)
+        {
+            break;
+        }
+        edits.insert(edits.end(), commit.begin(), commit.end());
+        offset = cursor;
+    }
+}
+
+Chunk *EditJournal::BuildChunk(int chunkX, int chunkZ, bool &generated)
+{
+    Chunk *chunk = new Chunk(chunkX, chunkZ);
+    if (m_store.LoadChunk(chunkX, chunkZ, *chunk))
+    {
+        generated = false;
+        return chunk;
+    }
+    delete chunk;
+    generated = true;
+    return new Chunk(m_perlin, chunkX, chunkZ);
+}
@@ -0,0 +1,281 @@
+#include "FrameTelemetry.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+namespace
+{
+    // log(MAX / MIN) split evenly over the buckets
+    const double LOG_MIN = std::log(FrameHistogram::MIN_MILLISECONDS);
+    const double LOG_RANGE = std::log(FrameHistogram::MAX_MILLISECONDS) - LOG_MIN;
+
+    double BucketUpperEdge(int bucket)
+    {
+        return std::exp(LOG_MIN + LOG_RANGE * (bucket + 1) / FrameHistogram::BUCKET_COUNT);
+    }
+
+    double Milliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+FrameHistogram::FrameHistogram()
+{
+    Clear();
+}
+
+void FrameHistogram::Add(double milliseconds)
+{
+    int bucket = 0;
+    if (milliseconds > MIN_MILLISECONDS)
+    {
+        bucket = (int)((std::log(milliseconds) - LOG_MIN) / LOG_RANGE * BUCKET_COUNT);
+        bucket = std::min(bucket, BUCKET_COUNT - 1);
+    }
+    m_buckets[bucket]++;
+    m_count++;
+    m_max = std::max(m_max, milliseconds);
+}
+
+void FrameHistogram::Clear()
+{
+    std::fill(m_buckets, m_buckets + BUCKET_COUNT, 0);
+    m_count = 0;
+    m_max = 0.0;
+}
+
+double FrameHistogram::Percentile(double p) const
+{
+    if (m_count == 0)
+    {
+        return 0.0;
+    }
+    // Nearest rank, like the benchmark's LatencySamples
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100.0 * m_count));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket)
+    {
+        seen += m_buckets[bucket];
+        if (seen >= rank)
+        {
+            // The top bucket also holds everything past MAX_MILLISECONDS
+            return std::min(BucketUpperEdge(bucket), m_max);
+        }
+    }
+    return m_max;
+}
+
+uint64_t FrameHistogram::GetCount() const
+{
+    return m_count;
+}
+
+double FrameHistogram::GetMax() const
+{
+    return m_max;
+}
+
+FrameTelemetry::FrameTelemetry(double recordSeconds, double hitchMilliseconds)
+{
+    m_recordSeconds = recordSeconds;
+    m_hitchMilliseconds = hitchMilliseconds;
+    m_dumpPrefix = "hitch_";
+    m_start = Clock::now();
+    m_frameStart = m_start;
+    m_phaseStart = m_start;
+    m_recorder.resize(MAX_RECORDED_FRAMES);
+    m_frameIndex = 0;
+    m_hitchCount = 0;
+    m_nextDumpSeconds = 0.0;
+}
+
+void FrameTelemetry::BeginFrame()
+{
+    m_frameStart = Clock::now();
+    m_phaseStart = m_frameStart;
+
+    // Frame indices start at 1 so an empty recorder slot never matches a frame
+    m_current = FrameRecord();
+    m_current.frameIndex = ++m_frameIndex;
+    m_current.startSeconds = Milliseconds(m_frameStart - m_start) / 1000.0;
+}
+
+void FrameTelemetry::EndPhase(FramePhase phase)
+{
+    const Clock::time_point now = Clock::now();
+    m_current.phaseMilliseconds[phase] += (float)Milliseconds(now - m_phaseStart);
+    m_phaseStart = now;
+}
+
+void FrameTelemetry::EndFrame(int chunksDrawn, int chunksUploaded)
+{
+    m_current.frameMilliseconds = (float)Milliseconds(Clock::now() - m_frameStart);
+    m_current.chunksDrawn = chunksDrawn;
+    m_current.chunksUploaded = chunksUploaded;
+    m_recorder[m_current.frameIndex % MAX_RECORDED_FRAMES] = m_current;
+
+    m_frameHistogram.Add(m_current.frameMilliseconds);
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        m_phaseHistograms[phase].Add(m_current.phaseMilliseconds[phase]);
+    }
+
+    if (m_current.frameMilliseconds > m_hitchMilliseconds)
+    {
+        m_hitchCount++;
+        // One dump per window, a burst of slow frames ends up in the same file
+        if (m_current.startSeconds >= m_nextDumpSeconds)
+        {
+            TRACE_SCOPE("FrameTelemetry::DumpFlightRecorder");
+            const std::string path = m_dumpPrefix + std::to_string(m_current.frameIndex) + ".json";
+            if (DumpFlightRecorder(path))
+            {
+                std::cout << "Hitch: frame " << m_current.frameIndex << " took " << m_current.frameMilliseconds
+                          << " ms, wrote " << path << std::endl;
+            }
+            m_nextDumpSeconds = m_current.startSeconds + m_recordSeconds;
+        }
+    }
+}
+
+void FrameTelemetry::RecordGpuTime(uint64_t frameIndex, double milliseconds)
+{
+    m_gpuHistogram.Add(milliseconds);
+    FrameRecord &record = m_recorder[frameIndex % MAX_RECORDED_FRAMES];
+    if (record.frameIndex == frameIndex)
+    {
+        record.gpuMilliseconds = (float)milliseconds;
+    }
+}
+
+bool FrameTelemetry::DumpFlightRecorder(const std::string &path) const
+{
+    if (m_frameIndex == 0)
+    {
+        return false;
+    }
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    // Walk back from the newest frame until the window or the ring runs out
+    const FrameRecord &newest = m_recorder[m_frameIndex % MAX_RECORDED_FRAMES];
+    uint64_t oldest = m_frameIndex;
+    while (oldest > 1 && m_frameIndex - (oldest - 1) < (uint64_t)MAX_RECORDED_FRAMES)
+    {
+        const FrameRecord &previous = m_recorder[(oldest - 1) % MAX_RECORDED_FRAMES];
+        if (previous.frameIndex != oldest - 1 || newest.startSeconds - previous.startSeconds > m_recordSeconds)
+        {
+            break;
+        }
+        oldest--;
+    }
+
+    out << "{\n  \"hitch_threshold_ms\": " << m_hitchMilliseconds << ",\n  \"frames\": [\n";
+    for (uint64_t index = oldest; index <= m_frameIndex; ++index)
+    {
+        const FrameRecord &record = m_recorder[index % MAX_RECORDED_FRAMES];
+        out << "    {\"frame\": " << record.frameIndex << ", \"start_s\": " << record.startSeconds
+            << ", \"frame_ms\": " << record.frameMilliseconds;
+        for (int phase = 0; phase < PHASE_COUNT; ++phase)
+        {
+            out << ", \"" << GetPhaseName((FramePhase)phase) << "_ms\": " << record.phaseMilliseconds[phase];
+        }
+        if (record.gpuMilliseconds >= 0.0f)
+        {
+            out << ", \"gpu_ms\": " << record.gpuMilliseconds;
+        }
+        out << ", \"chunks_drawn\": " << record.chunksDrawn << ", \"chunks_uploaded\": " << record.chunksUploaded
+            << "}" << (index < m_frameIndex ? ",\n" : "\n");
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+void FrameTelemetry::PrintSummary(std::ostream &out) const
+{
+    const std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(2);
+    out << "Frames: " << m_frameHistogram.GetCount() << ", hitches (>" << m_hitchMilliseconds << " ms): " << m_hitchCount
+        << "\n";
+    out << std::left << std::setw(10) << "Phase" << std::right << std::setw(10) << "p50" << std::setw(10) << "p95"
+        << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+
+    auto printRow = [&out](const char *name, const FrameHistogram &histogram)
+    {
+        out << std::left << std::setw(10) << name << std::right << std::setw(10) << histogram.Percentile(50.0)
+            << std::setw(10) << histogram.Percentile(95.0) << std::setw(10) << histogram.Percentile(99.0)
+            << std::setw(10) << histogram.GetMax() << "\n";
+    };
+    printRow("frame", m_frameHistogram);
+    for (int phase = 0; phase < PHASE_COUNT; ++phase)
+    {
+        printRow(GetPhaseName((FramePhase)phase), m_phaseHistograms[phase]);
+    }
+    if (m_gpuHistogram.GetCount() > 0)
+    {
+        printRow("gpu", m_gpuHistogram);
+    }
+    out.flags(flags);
+}
+
+uint64_t FrameTelemetry::GetFrameIndex() const
+{
+    return m_frameIndex;
+}
+
+const FrameHistogram &FrameTelemetry::GetFrameHistogram() const
+{
+    return m_frameHistogram;
+}
+
+const FrameHistogram &FrameTelemetry::GetPhaseHistogram(FramePhase phase) const
+{
+    return m_phaseHistograms[phase];
+}
+
+const FrameHistogram &FrameTelemetry::GetGpuHistogram() const
+{
+    return m_gpuHistogram;
+}
+
+uint64_t FrameTelemetry::GetHitchCount() const
+{
+    return m_hitchCount;
+}
+
+const char *FrameTelemetry::GetPhaseName(FramePhase phase)
+{
+    switch (phase)
+    {
+    case PHASE_INPUT:
+        return "input";
+    case PHASE_UPLOAD:
+        return "upload";
+    case PHASE_PREDRAW:
+        return "predraw";
+    case PHASE_DRAW:
+        return "draw";
+    case PHASE_SWAP:
+        return "swap";
+    default:
+        return "unknown";
+    }
+}
+
+void FrameTelemetry::SetHitchThreshold(double milliseconds)
+{
+    m_hitchMilliseconds = milliseconds;
+}
+
+void FrameTelemetry::SetDumpPrefix(const std::string &prefix)
+{
+    m_dumpPrefix = prefix;
+}
@@ -0,0 +1,25 @@
+#include "FrameUniforms.hpp"
+#include "MemoryStats.hpp"
+
+FrameUniformBuffer::FrameUniformBuffer()
+{
+    glGenBuffers(1, &m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, m_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    MemoryStats::Add(MEMORY_GPU_BUFFERS, sizeof(FrameUniforms));
+}
+
+FrameUniformBuffer::~FrameUniformBuffer()
+{
+    glDeleteBuffers(1, &m_ubo);
+    MemoryStats::Remove(MEMORY_GPU_BUFFERS, sizeof(FrameUniforms));
+}
+
+void FrameUniformBuffer::Update(const FrameUniforms &uniforms)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &uniforms);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,336 @@
+#include "GpuBufferArena.hpp"
+#include "MemoryStats.hpp"
+#include "Trace.hpp"
+#include "Voxel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <unordered_map>
+
+namespace
+{
+    const GLsizeiptr VERTEX_BYTES = sizeof(GLfloat) * Voxel::VERTEX_FLOATS;
+    const GLsizeiptr INDEX_BYTES = sizeof(GLuint);
+}
+
+GpuBufferArena::GpuBufferArena(GLuint vertexCapacity, GLuint indexCapacity)
+    : m_vertexAllocator(vertexCapacity), m_indexAllocator(indexCapacity)
+{
+    glGenVertexArrays(1, &m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertexCapacity * VERTEX_BYTES, nullptr, GL_DYNAMIC_DRAW);
+
+    glGenBuffers(1, &m_ibo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+    glBufferData(GL_COPY_WRITE_BUFFER, indexCapacity * INDEX_BYTES, nullptr, GL_DYNAMIC_DRAW);
+    MemoryStats::Add(MEMORY_GPU_BUFFERS, vertexCapacity * VERTEX_BYTES + indexCapacity * INDEX_BYTES, 2);
+
+    SetupVertexArray();
+}
+
+GpuBufferArena::~GpuBufferArena()
+{
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ibo);
+    glDeleteVertexArrays(1, &m_vao);
+    MemoryStats::Remove(MEMORY_GPU_BUFFERS, m_vertexAllocator.GetCapacity() * VERTEX_BYTES +
+                                                m_indexAllocator.GetCapacity() * INDEX_BYTES,
+                        2);
+}
+
+int GpuBufferArena::Upload(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices)
+{
+    TRACE_SCOPE("GpuBufferArena::Upload");
+    const int handle = Allocate(vertices.size() / Voxel::VERTEX_FLOATS, indices.size());
+    const Mesh &mesh = m_meshes[handle];
+
+    if (mesh.indexCount > 0)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.vertexOffset * VERTEX_BYTES,
+                        mesh.vertexCount * VERTEX_BYTES, vertices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, mesh.indexOffset * INDEX_BYTES,
+                        mesh.indexCount * INDEX_BYTES, indices.data());
+    }
+    return handle;
+}
+
+int GpuBufferArena::Upload(const std::vector<GLfloat> &vertices, const std::vector<GLuint> &indices, StagingRing &ring)
+{
+    TRACE_SCOPE("GpuBufferArena::StagedUpload");
+    const GLsizeiptr vertexBytes = vertices.size() * sizeof(GLfloat);
+    const GLsizeiptr indexBytes = indices.size() * sizeof(GLuint);
+
+    // Meshes that could never fit in the ring fall back to a direct upload
+    if (vertexBytes + indexBytes + 32 > ring.GetCapacity())
+    {
+        return Upload(vertices, indices);
+    }
+    // Reserve both parts up front so a mesh is never left half written
+    if (!ring.Reserve(vertexBytes + indexBytes, 2))
+    {
+        return -1;
+    }
+
+    const int handle = Allocate(vertices.size() / Voxel::VERTEX_FLOATS, indices.size());
+    const Mesh &mesh = m_meshes[handle];
+
+    if (mesh.indexCount > 0 &&
+        (!ring.Stage(m_vbo, mesh.vertexOffset * VERTEX_BYTES, vertices.data(), vertexBytes) ||
+         !ring.Stage(m_ibo, mesh.indexOffset * INDEX_BYTES, indices.data(), indexBytes)))
+    {
+        // Only a failed mapping gets here, the mesh is retried on a later frame
+        Free(handle);
+        return -1;
+    }
+    return handle;
+}
+
+int GpuBufferArena::Allocate(uint32_t vertexCount, uint32_t indexCount)
+{
+    Mesh mesh = {0, vertexCount, 0, indexCount, true};
+
+    if (mesh.vertexCount > 0 && mesh.indexCount > 0)
+    {
+        Reserve(mesh.vertexCount, mesh.indexCount);
+        mesh.vertexOffset = m_vertexAllocator.Allocate(mesh.vertexCount);
+        mesh.indexOffset = m_indexAllocator.Allocate(mesh.indexCount);
+    }
+    else
+    {
+        mesh.vertexCount = 0;
+        mesh.indexCount = 0;
+    }
+
+    // Reuse a released handle if there is one
+    if (!m_freeHandles.empty())
+    {
+        const int handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        m_meshes[handle] = mesh;
+        return handle;
+    }
+    m_meshes.push_back(mesh);
+    return (int)m_meshes.size() - 1;
+}
+
+void GpuBufferArena::Free(int handle)
+{
+    if (handle < 0 || handle >= (int)m_meshes.size() || !m_meshes[handle].live)
+    {
+        return;
+    }
+
+    Mesh &mesh = m_meshes[handle];
+    if (mesh.indexCount > 0)
+    {
+        m_vertexAllocator.Free(mesh.vertexOffset);
+        m_indexAllocator.Free(mesh.indexOffset);
+    }
+    mesh.live = false;
+    m_freeHandles.push_back(handle);
+}
+
+bool GpuBufferArena::GetDrawRange(int handle, MeshDrawRange &range) const
+{
+    if (handle < 0 || handle >= (int)m_meshes.size() || !m_meshes[handle].live ||
+        m_meshes[handle].indexCount == 0)
+    {
+        return false;
+    }
+
+    const Mesh &mesh = m_meshes[handle];
+    range.baseVertex = mesh.vertexOffset;
+    range.firstIndex = mesh.indexOffset;
+    range.indexCount = mesh.indexCount;
+    return true;
+}
+
+bool GpuBufferArena::DefragmentIfNeeded(float threshold)
+{
+    if (m_vertexAllocator.GetFragmentation() <= threshold && m_indexAllocator.GetFragmentation() <= threshold)
+    {
+        return false;
+    }
+    Defragment();
+    return true;
+}
+
+void GpuBufferArena::Bind() const
+{
+    glBindVertexArray(m_vao);
+}
+
+void GpuBufferArena::DrawMeshes(const std::vector<int> &handles, FrameStats &stats)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    m_drawCounts.clear();
+    m_drawOffsets.clear();
+    m_drawBaseVertices.clear();
+    for (int handle : handles)
+    {
+        MeshDrawRange range;
+        if (GetDrawRange(handle, range))
+        {
+            m_drawCounts.push_back(range.indexCount);
+            m_drawOffsets.push_back((const GLvoid *)(range.firstIndex * sizeof(GLuint)));
+            m_drawBaseVertices.push_back(range.baseVertex);
+            stats.trianglesSubmitted += range.indexCount / 3;
+        }
+    }
+
+    if (!m_drawCounts.empty())
+    {
+        // Chunk vertices are already in world space, so the draws only differ by their ranges
+        glBindVertexArray(m_vao);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, m_drawCounts.data(), GL_UNSIGNED_INT,
+                                      m_drawOffsets.data(), m_drawCounts.size(), m_drawBaseVertices.data());
+        stats.drawCalls++;
+        stats.chunksDrawn += m_drawCounts.size();
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    stats.submitMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+GLuint GpuBufferArena::GetVertexArray() const
+{
+    return m_vao;
+}
+
+GLuint GpuBufferArena::GetVertexBuffer() const
+{
+    return m_vbo;
+}
+
+GLuint GpuBufferArena::GetIndexBuffer() const
+{
+    return m_ibo;
+}
+
+const BufferAllocator &GpuBufferArena::GetVertexAllocator() const
+{
+    return m_vertexAllocator;
+}
+
+const BufferAllocator &GpuBufferArena::GetIndexAllocator() const
+{
+    return m_indexAllocator;
+}
+
+void GpuBufferArena::Reserve(uint32_t vertexCount, uint32_t indexCount)
+{
+    // Compacting is enough when the space exists but is split into holes
+    if ((m_vertexAllocator.GetLargestFreeBlock() < vertexCount &&
+         m_vertexAllocator.GetCapacity() - m_vertexAllocator.GetUsed() >= vertexCount) ||
+        (m_indexAllocator.GetLargestFreeBlock() < indexCount &&
+         m_indexAllocator.GetCapacity() - m_indexAllocator.GetUsed() >= indexCount))
+    {
+        Defragment();
+    }
+
+    // Otherwise double the buffer until it fits
+    if (m_vertexAllocator.GetLargestFreeBlock() < vertexCount)
+    {
+        const uint32_t oldCapacity = m_vertexAllocator.GetCapacity();
+        uint32_t newCapacity = std::max(oldCapacity * 2, 1024u);
+        while (newCapacity - m_vertexAllocator.GetUsed() < vertexCount)
+        {
+            newCapacity *= 2;
+        }
+        m_vertexAllocator.Grow(newCapacity);
+        Relocate(m_vbo, VERTEX_BYTES, newCapacity, {{0, 0, oldCapacity}});
+        MemoryStats::Add(MEMORY_GPU_BUFFERS, (newCapacity - oldCapacity) * VERTEX_BYTES, 0);
+    }
+    if (m_indexAllocator.GetLargestFreeBlock() < indexCount)
+    {
+        const uint32_t oldCapacity = m_indexAllocator.GetCapacity();
+        uint32_t newCapacity = std::max(oldCapacity * 2, 1024u);
+        while (newCapacity - m_indexAllocator.GetUsed() < indexCount)
+        {
+            newCapacity *= 2;
+        }
+        m_indexAllocator.Grow(newCapacity);
+        Relocate(m_ibo, INDEX_BYTES, newCapacity, {{0, 0, oldCapacity}});
+        MemoryStats::Add(MEMORY_GPU_BUFFERS, (newCapacity - oldCapacity) * INDEX_BYTES, 0);
+    }
+}
+
+void GpuBufferArena::Defragment()
+{
+    const std::vector<BufferAllocator::Move> vertexMoves = m_vertexAllocator.Defragment();
+    const std::vector<BufferAllocator::Move> indexMoves = m_indexAllocator.Defragment();
+
+    Relocate(m_vbo, VERTEX_BYTES, m_vertexAllocator.GetCapacity(), vertexMoves);
+    Relocate(m_ibo, INDEX_BYTES, m_indexAllocator.GetCapacity(), indexMoves);
+
+    // Point every mesh at its new offsets
+    std::unordered_map<uint32_t, uint32_t> vertexRemap, indexRemap;
+    for (const BufferAllocator::Move &move : vertexMoves)
+    {
+        vertexRemap[move.from] = move.to;
+    }
+    for (const BufferAllocator::Move &move : indexMoves)
+    {
+        indexRemap[move.from] = move.to;
+    }
+    for (Mesh &mesh : m_meshes)
+    {
+        if (mesh.live && mesh.indexCount > 0)
+        {
+            mesh.vertexOffset = vertexRemap[mesh.vertexOffset];
+            mesh.indexOffset = indexRemap[mesh.indexOffset];
+        }
+    }
+}
+
+void GpuBufferArena::Relocate(GLuint &buffer, GLsizeiptr elementSize, GLsizeiptr newCapacity,
+                              const std::vector<BufferAllocator::Move> &moves)
+{
+    // Copy into a fresh buffer so overlapping moves never read data that was already overwritten
+    GLuint newBuffer;
+    glGenBuffers(1, &newBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+
+    for (const BufferAllocator::Move &move : moves)
+    {
+        if (move.size > 0)
+        {
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                move.from * elementSize, move.to * elementSize, move.size * elementSize);
+        }
+    }
+
+    glDeleteBuffers(1, &buffer);
+    buffer = newBuffer;
+    SetupVertexArray();
+}
+
+void GpuBufferArena::SetupVertexArray()
+{
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+
+    glEnableVertexAttribArray(0); // Position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void *)0);
+
+    glEnableVertexAttribArray(1); // Texture coordinates
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (GLvoid *)(sizeof(GLfloat) * 3));
+
+    glEnableVertexAttribArray(2); // Normals
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (GLvoid *)(sizeof(GLfloat) * 5));
+
+    glEnableVertexAttribArray(3); // Sky and block light
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (GLvoid *)(sizeof(GLfloat) * 8));
+
+    glEnableVertexAttribArray(4); // Ambient occlusion
+    glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (GLvoid *)(sizeof(GLfloat) * 10));
+
+    glBindVertexArray(0);
+}
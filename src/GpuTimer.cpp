@@ -0,0 +1,84 @@
+#include "GpuTimer.hpp"
+
+GpuTimer::GpuTimer()
+{
+    // Timer queries are core since OpenGL 3.3
+    m_supported = GLAD_GL_VERSION_3_3 != 0;
+    m_next = 0;
+    m_active = -1;
+    for (Query &query : m_queries)
+    {
+        query.id = 0;
+        query.frameIndex = 0;
+        query.pending = false;
+        if (m_supported)
+        {
+            glGenQueries(1, &query.id);
+        }
+    }
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (Query &query : m_queries)
+    {
+        if (query.id != 0)
+        {
+            glDeleteQueries(1, &query.id);
+        }
+    }
+}
+
+void GpuTimer::Begin(uint64_t frameIndex)
+{
+    // Skip the frame rather than wait when the GPU is far behind
+    Query &query = m_queries[m_next];
+    if (!m_supported || query.pending)
+    {
+        return;
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+    query.frameIndex = frameIndex;
+    m_active = m_next;
+}
+
+void GpuTimer::End()
+{
+    if (m_active < 0)
+    {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_queries[m_active].pending = true;
+    m_next = (m_active + 1) % QUERY_COUNT;
+    m_active = -1;
+}
+
+void GpuTimer::Poll(std::vector<Result> &results)
+{
+    results.clear();
+    // Queries finish in submission order, start from the oldest one
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        Query &query = m_queries[(m_next + i) % QUERY_COUNT];
+        if (!query.pending)
+        {
+            continue;
+        }
+        GLint available = 0;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+        query.pending = false;
+        results.push_back({query.frameIndex, nanoseconds / 1.0e6});
+    }
+}
+
+bool GpuTimer::IsSupported() const
+{
+    return m_supported;
+}
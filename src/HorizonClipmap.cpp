@@ -0,0 +1,225 @@
+#include "HorizonClipmap.hpp"
+#include "Chunk.hpp"
+#include "MemoryStats.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int SAMPLES = HorizonClipmap::GRID_SIZE + 1;
+    // Skirts sit this far inside their cell so they do not z-fight the border faces of the loaded chunks
+    const float SKIRT_INSET = 0.05f;
+
+    int FloorDiv(int value, int divisor)
+    {
+        return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+}
+
+HorizonClipmap::HorizonClipmap(siv::PerlinNoise::seed_type seed) : m_perlin(seed)
+{
+    for (int level = 0; level < LEVELS; ++level)
+    {
+        m_levels[level].spacing = BASE_SPACING << level;
+        m_levels[level].origin = glm::ivec2(0);
+        m_levels[level].valid = false;
+        m_levels[level].heights.assign(SAMPLES * SAMPLES, 0);
+    }
+    m_holeMin = glm::ivec2(0);
+    m_holeSize = 0;
+    m_dirty = true;
+    m_sampledColumns = 0;
+    MemoryStats::Add(MEMORY_CPU_MESHES, LEVELS * SAMPLES * SAMPLES);
+}
+
+HorizonClipmap::~HorizonClipmap()
+{
+    MemoryStats::Remove(MEMORY_CPU_MESHES, LEVELS * SAMPLES * SAMPLES);
+}
+
+int HorizonClipmap::Update(float x, float z, const glm::ivec2 &holeMin, int holeSize)
+{
+    TRACE_SCOPE("HorizonClipmap::Update");
+    if (holeMin != m_holeMin || holeSize != m_holeSize)
+    {
+        m_holeMin = holeMin;
+        m_holeSize = holeSize;
+        m_dirty = true;
+    }
+
+    int sampled = 0;
+    for (int index = 0; index < LEVELS; ++index)
+    {
+        Level &level = m_levels[index];
+        // Origins snap to every other sample, so each level's edges fall on the samples of the
+        // level around it
+        const glm::ivec2 origin(FloorDiv((int)std::floor(x), 2 * level.spacing) * 2 - GRID_SIZE / 2,
+                                FloorDiv((int)std::floor(z), 2 * level.spacing) * 2 - GRID_SIZE / 2);
+        if (level.valid && origin == level.origin)
+        {
+            continue;
+        }
+
+        // Only samples that came into range are taken, they reuse the slots of the ones that left
+        for (int sampleX = origin.x; sampleX <= origin.x + GRID_SIZE; ++sampleX)
+        {
+            for (int sampleZ = origin.y; sampleZ <= origin.y + GRID_SIZE; ++sampleZ)
+            {
+                if (level.valid && sampleX >= level.origin.x && sampleX <= level.origin.x + GRID_SIZE &&
+                    sampleZ >= level.origin.y && sampleZ <= level.origin.y + GRID_SIZE)
+                {
+                    continue;
+                }
+                level.heights[SampleSlot(sampleX) * SAMPLES + SampleSlot(sampleZ)] =
+                    (uint8_t)Chunk::GetTerrainHeight(m_perlin, sampleX * level.spacing, sampleZ * level.spacing);
+                sampled++;
+            }
+        }
+        level.origin = origin;
+        level.valid = true;
+        m_dirty = true;
+    }
+    m_sampledColumns += sampled;
+    return sampled;
+}
+
+bool HorizonClipmap::IsDirty() const
+{
+    return m_dirty;
+}
+
+void HorizonClipmap::BuildMesh(std::vector<GLfloat> &vertices, std::vector<GLuint> &indices)
+{
+    TRACE_SCOPE("HorizonClipmap::BuildMesh");
+    vertices.clear();
+    indices.clear();
+    m_dirty = false;
+
+    // Every vertex samples the middle of the terrain texture, the horizon shows its colour only
+    const glm::vec4 uv = Chunk::GetTerrainTextureBounds();
+    const GLfloat u = (uv.x + uv.z) * 0.5f;
+    const GLfloat v = (uv.y + uv.w) * 0.5f;
+    auto addVertex = [&](GLfloat x, GLfloat y, GLfloat z, const glm::vec3 &normal)
+    {
+        vertices.insert(vertices.end(), {x, y, z, u, v, normal.x, normal.y, normal.z,
+                                         (GLfloat)Voxel::MAX_LIGHT, 0.0f, (GLfloat)Voxel::OPEN_CORNER});
+    };
+    // Cell sides in the order -x, +x, -z, +z, as the corners they run between
+    const int sides[4][2][2] = {{{0, 0}, {0, 1}}, {{1, 0}, {1, 1}}, {{0, 0}, {1, 0}}, {{0, 1}, {1, 1}}};
+    const int sideOffsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+
+    for (int index = 0; index < LEVELS; ++index)
+    {
+        const Level &level = m_levels[index];
+        if (!level.valid)
+        {
+            continue;
+        }
+        const GLfloat spacing = (GLfloat)level.spacing;
+        auto height = [&](int sampleX, int sampleZ)
+        {
+            sampleX = std::max(level.origin.x, std::min(sampleX, level.origin.x + GRID_SIZE));
+            sampleZ = std::max(level.origin.y, std::min(sampleZ, level.origin.y + GRID_SIZE));
+            return (GLfloat)level.heights[SampleSlot(sampleX) * SAMPLES + SampleSlot(sampleZ)];
+        };
+
+        // The grid's vertices, normals from the slope to the samples around
+        const GLuint first = vertices.size() / Voxel::VERTEX_FLOATS;
+        for (int i = 0; i <= GRID_SIZE; ++i)
+        {
+            for (int j = 0; j <= GRID_SIZE; ++j)
+            {
+                const int sampleX = level.origin.x + i;
+                const int sampleZ = level.origin.y + j;
+                const glm::vec3 normal = glm::normalize(glm::vec3(height(sampleX - 1, sampleZ) - height(sampleX + 1, sampleZ),
+                                                                  2.0f * spacing,
+                                                                  height(sampleX, sampleZ - 1) - height(sampleX, sampleZ + 1)));
+                addVertex(sampleX * spacing, height(sampleX, sampleZ), sampleZ * spacing, normal);
+            }
+        }
+
+        for (int i = 0; i < GRID_SIZE; ++i)
+        {
+            for (int j = 0; j < GRID_SIZE; ++j)
+            {
+                const int cellX = level.origin.x + i;
+                const int cellZ = level.origin.y + j;
+                if (!IsCellDrawn(index, cellX, cellZ))
+                {
+                    continue;
+                }
+                // Same corner order and split as the top faces of the chunk meshes
+                const GLuint corner = first + i * SAMPLES + j;
+                indices.insert(indices.end(), {corner, corner + SAMPLES, corner + SAMPLES + 1,
+                                               corner + SAMPLES + 1, corner + 1, corner});
+
+                for (int side = 0; side < 4; ++side)
+                {
+                    if (IsCellDrawn(index, cellX + sideOffsets[side][0], cellZ + sideOffsets[side][1]))
+                    {
+                        continue;
+                    }
+                    const glm::vec3 normal((GLfloat)sideOffsets[side][0], 0.0f, (GLfloat)sideOffsets[side][1]);
+                    const GLuint skirt = vertices.size() / Voxel::VERTEX_FLOATS;
+                    for (int end = 0; end < 2; ++end)
+                    {
+                        const int sampleX = cellX + sides[side][end][0];
+                        const int sampleZ = cellZ + sides[side][end][1];
+                        const GLfloat x = sampleX * spacing - sideOffsets[side][0] * SKIRT_INSET;
+                        const GLfloat z = sampleZ * spacing - sideOffsets[side][1] * SKIRT_INSET;
+                        addVertex(x, height(sampleX, sampleZ), z, normal);
+                        addVertex(x, 0.0f, z, normal);
+                    }
+                    indices.insert(indices.end(), {skirt, skirt + 2, skirt + 3, skirt + 3, skirt + 1, skirt});
+                }
+            }
+        }
+    }
+}
+
+int HorizonClipmap::GetHeight(int level, int sampleX, int sampleZ) const
+{
+    return m_levels[level].heights[SampleSlot(sampleX) * SAMPLES + SampleSlot(sampleZ)];
+}
+
+glm::ivec2 HorizonClipmap::GetOrigin(int level) const
+{
+    return m_levels[level].origin;
+}
+
+int HorizonClipmap::GetReach() const
+{
+    return GRID_SIZE / 2 * (BASE_SPACING << (LEVELS - 1));
+}
+
+size_t HorizonClipmap::GetSampledColumns() const
+{
+    return m_sampledColumns;
+}
+
+int HorizonClipmap::SampleSlot(int sample)
+{
+    return ((sample % SAMPLES) + SAMPLES) % SAMPLES;
+}
+
+bool HorizonClipmap::IsCellDrawn(int level, int cellX, int cellZ) const
+{
+    const Level &current = m_levels[level];
+    if (cellX < current.origin.x || cellX >= current.origin.x + GRID_SIZE ||
+        cellZ < current.origin.y || cellZ >= current.origin.y + GRID_SIZE)
+    {
+        return false;
+    }
+    // The square covered by the level inside, or by the loaded chunks inside the finest level
+    glm::ivec2 innerMin = m_holeMin;
+    int innerSize = m_holeSize;
+    if (level > 0 && m_levels[level - 1].valid)
+    {
+        innerMin = m_levels[level - 1].origin * m_levels[level - 1].spacing;
+        innerSize = GRID_SIZE * m_levels[level - 1].spacing;
+    }
+    const glm::ivec2 cellMin = glm::ivec2(cellX, cellZ) * current.spacing;
+    return !(cellMin.x >= innerMin.x && cellMin.x + current.spacing <= innerMin.x + innerSize &&
+             cellMin.y >= innerMin.y && cellMin.y + current.spacing <= innerMin.y + innerSize);
+}
@@ -0,0 +1,350 @@
+#include "LightEngine.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+namespace
+{
+    const int SIZE = Chunk::CHUNK_SIZE;
+
+    // +x, -x, +y, -y, +z, -z
+    const int DIRECTIONS[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    const int DOWN = 3;
+}
+
+LightEngine::LightEngine()
+{
+    m_updatedVoxels = 0;
+}
+
+void LightEngine::LightChunk(Chunk *chunk)
+{
+    TRACE_SCOPE("LightEngine::LightChunk");
+    // Sky light fills each column down to its first solid voxel, light sources seed block light
+    for (int x = 0; x < SIZE; ++x)
+    {
+        for (int z = 0; z < SIZE; ++z)
+        {
+            const int height = chunk->GetColumnHeight(x, z);
+            for (int y = SIZE - 1; y >= 0; --y)
+            {
+                const bool open = y >= height;
+                const int emission = chunk->GetEmission(x, y, z);
+                chunk->SetLight(x, y, z, (uint8_t)(((open ? Voxel::MAX_LIGHT : 0) << 4) | emission));
+                if (open)
+                {
+                    m_addQueue[LIGHT_SKY].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+                }
+                if (emission > 0)
+                {
+                    m_addQueue[LIGHT_BLOCK].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+                }
+            }
+        }
+    }
+    m_updatedVoxels += SIZE * SIZE * SIZE;
+    MarkChanged(chunk);
+
+    // Light already on the neighbors' borders flows in, the flood carries the chunk's own light out
+    const int offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const int *offset : offsets)
+    {
+        Chunk *neighbor = chunk->GetNeighbor(offset[0], offset[1]);
+        if (neighbor == nullptr)
+        {
+            continue;
+        }
+        MarkChanged(neighbor);
+        for (int y = 0; y < SIZE; ++y)
+        {
+            for (int i = 0; i < SIZE; ++i)
+            {
+                // The neighbor's voxel touching this chunk
+                const int x = offset[0] == 0 ? i : (offset[0] < 0 ? SIZE - 1 : 0);
+                const int z = offset[1] == 0 ? i : (offset[1] < 0 ? SIZE - 1 : 0);
+                const uint8_t light = neighbor->GetLight(x, y, z);
+                for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; ++channel)
+                {
+                    if (GetLevel(light, channel) > 0)
+                    {
+                        m_addQueue[channel].push_back({neighbor, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+                    }
+                }
+            }
+        }
+    }
+
+    Propagate(LIGHT_SKY);
+    Propagate(LIGHT_BLOCK);
+}
+
+void LightEngine::UpdateBlock(Chunk *chunk, int x, int y, int z)
+{
+    TRACE_SCOPE("LightEngine::UpdateBlock");
+    if (chunk->IsSolid(x, y, z))
+    {
+        // A placed block puts out its own light source and takes away the light that went through it
+        chunk->SetEmission(x, y, z, 0);
+        const uint8_t light = chunk->GetLight(x, y, z);
+        for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; ++channel)
+        {
+            const int level = GetLevel(light, channel);
+            if (level > 0)
+            {
+                Store(chunk, x, y, z, channel, 0);
+                m_removeQueue[channel].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, (uint8_t)level});
+            }
+            Unpropagate(channel);
+            Propagate(channel);
+        }
+        return;
+    }
+
+    // A removed block lets the light around it back in
+    for (int direction = 0; direction < 6; ++direction)
+    {
+        LightNode neighbor = {chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0};
+        if (!Step(neighbor, direction))
+        {
+            continue;
+        }
+        const uint8_t light = neighbor.chunk->GetLight(neighbor.x, neighbor.y, neighbor.z);
+        for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; ++channel)
+        {
+            if (GetLevel(light, channel) > 0)
+            {
+                m_addQueue[channel].push_back(neighbor);
+            }
+        }
+    }
+    if (y == SIZE - 1)
+    {
+        Store(chunk, x, y, z, LIGHT_SKY, Voxel::MAX_LIGHT);
+        m_addQueue[LIGHT_SKY].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+    }
+    Propagate(LIGHT_SKY);
+    Propagate(LIGHT_BLOCK);
+}
+
+void LightEngine::RelightChunks(const std::vector<Chunk *> &chunks)
+{
+    TRACE_SCOPE("LightEngine::RelightChunks");
+    // Every chunk goes dark before the darkness spreads, so none of them is taken for a source
+    for (Chunk *chunk : chunks)
+    {
+        for (int x = 0; x < SIZE; ++x)
+        {
+            for (int y = 0; y < SIZE; ++y)
+            {
+                for (int z = 0; z < SIZE; ++z)
+                {
+                    const uint8_t light = chunk->GetLight(x, y, z);
+                    for (int channel = 0; channel < LIGHT_CHANNEL_COUNT; ++channel)
+                    {
+                        const int level = GetLevel(light, channel);
+                        if (level > 0)
+                        {
+                            Store(chunk, x, y, z, channel, 0);
+                            m_removeQueue[channel].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, (uint8_t)level});
+                        }
+                    }
+                }
+            }
+        }
+    }
+    Unpropagate(LIGHT_SKY);
+    Unpropagate(LIGHT_BLOCK);
+
+    // Same seeds as LightChunk, the light around came back through the add queues
+    for (Chunk *chunk : chunks)
+    {
+        for (int x = 0; x < SIZE; ++x)
+        {
+            for (int z = 0; z < SIZE; ++z)
+            {
+                for (int y = chunk->GetColumnHeight(x, z); y < SIZE; ++y)
+                {
+                    Store(chunk, x, y, z, LIGHT_SKY, Voxel::MAX_LIGHT);
+                    m_addQueue[LIGHT_SKY].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+                }
+                for (int y = 0; y < SIZE; ++y)
+                {
+                    const int emission = chunk->GetEmission(x, y, z);
+                    if (emission > GetLevel(chunk->GetLight(x, y, z), LIGHT_BLOCK))
+                    {
+                        Store(chunk, x, y, z, LIGHT_BLOCK, emission);
+                        m_addQueue[LIGHT_BLOCK].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+                    }
+                }
+            }
+        }
+    }
+    Propagate(LIGHT_SKY);
+    Propagate(LIGHT_BLOCK);
+}
+
+void LightEngine::SetEmitter(Chunk *chunk, int x, int y, int z, int level)
+{
+    TRACE_SCOPE("LightEngine::SetEmitter");
+    if (chunk->IsSolid(x, y, z))
+    {
+        return;
+    }
+    level = std::max(0, std::min(level, (int)Voxel::MAX_LIGHT));
+    chunk->SetEmission(x, y, z, level);
+
+    const int current = GetLevel(chunk->GetLight(x, y, z), LIGHT_BLOCK);
+    if (level < current)
+    {
+        Store(chunk, x, y, z, LIGHT_BLOCK, 0);
+        m_removeQueue[LIGHT_BLOCK].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, (uint8_t)current});
+        Unpropagate(LIGHT_BLOCK);
+    }
+    if (level > GetLevel(chunk->GetLight(x, y, z), LIGHT_BLOCK))
+    {
+        Store(chunk, x, y, z, LIGHT_BLOCK, level);
+        m_addQueue[LIGHT_BLOCK].push_back({chunk, (int8_t)x, (int8_t)y, (int8_t)z, 0});
+    }
+    Propagate(LIGHT_BLOCK);
+}
+
+void LightEngine::TakeChangedChunks(std::vector<Chunk *> &chunks)
+{
+    chunks.clear();
+    chunks.swap(m_changedChunks);
+}
+
+size_t LightEngine::GetUpdatedVoxels() const
+{
+    return m_updatedVoxels;
+}
+
+int LightEngine::GetLevel(uint8_t light, int channel)
+{
+    return channel == LIGHT_SKY ? light >> 4 : light & 15;
+}
+
+void LightEngine::Propagate(int channel)
+{
+    std::vector<LightNode> &queue = m_addQueue[channel];
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        // Copied, pushing may move the queue
+        const LightNode node = queue[i];
+        const int level = GetLevel(node.chunk->GetLight(node.x, node.y, node.z), channel);
+        for (int direction = 0; direction < 6; ++direction)
+        {
+            const int spread = (channel == LIGHT_SKY && direction == DOWN && level == Voxel::MAX_LIGHT) ? level : level - 1;
+            LightNode neighbor = node;
+            if (spread <= 0 || !Step(neighbor, direction))
+            {
+                continue;
+            }
+            if (GetLevel(neighbor.chunk->GetLight(neighbor.x, neighbor.y, neighbor.z), channel) >= spread ||
+                neighbor.chunk->IsSolid(neighbor.x, neighbor.y, neighbor.z))
+            {
+                continue;
+            }
+            Store(neighbor.chunk, neighbor.x, neighbor.y, neighbor.z, channel, spread);
+            queue.push_back(neighbor);
+        }
+    }
+    queue.clear();
+}
+
+void LightEngine::Unpropagate(int channel)
+{
+    // Darken every voxel the removed light reached. Voxels lit at least as brightly from
+    // elsewhere are the edge of the dark area, they are queued to flood back into it
+    std::vector<LightNode> &queue = m_removeQueue[channel];
+    for (size_t i = 0; i < queue.size(); ++i)
+    {
+        const LightNode node = queue[i];
+        for (int direction = 0; direction < 6; ++direction)
+        {
+            LightNode neighbor = node;
+            if (!Step(neighbor, direction))
+            {
+                continue;
+            }
+            const int level = GetLevel(neighbor.chunk->GetLight(neighbor.x, neighbor.y, neighbor.z), channel);
+            if (level == 0)
+            {
+                continue;
+            }
+            const bool litByNode = level < node.level ||
+                                   (channel == LIGHT_SKY && direction == DOWN && node.level == Voxel::MAX_LIGHT && level == Voxel::MAX_LIGHT);
+            if (!litByNode)
+            {
+                m_addQueue[channel].push_back(neighbor);
+                continue;
+            }
+            Store(neighbor.chunk, neighbor.x, neighbor.y, neighbor.z, channel, 0);
+            neighbor.level = (uint8_t)level;
+            queue.push_back(neighbor);
+            // Light sources in the darkened area shine again
+            const int emission = channel == LIGHT_BLOCK ? neighbor.chunk->GetEmission(neighbor.x, neighbor.y, neighbor.z) : 0;
+            if (emission > 0)
+            {
+                Store(neighbor.chunk, neighbor.x, neighbor.y, neighbor.z, channel, emission);
+                m_addQueue[channel].push_back(neighbor);
+            }
+        }
+    }
+    queue.clear();
+}
+
+void LightEngine::Store(Chunk *chunk, int x, int y, int z, int channel, int level)
+{
+    const uint8_t light = chunk->GetLight(x, y, z);
+    chunk->SetLight(x, y, z, channel == LIGHT_SKY ? (uint8_t)((light & 15) | (level << 4)) : (uint8_t)((light & 0xF0) | level));
+    m_updatedVoxels++;
+
+    // Faces of the neighboring chunk look into voxels on the border
+    MarkChanged(chunk);
+    if (x == 0 || x == SIZE - 1)
+    {
+        MarkChanged(chunk->GetNeighbor(x == 0 ? -1 : 1, 0));
+    }
+    if (z == 0 || z == SIZE - 1)
+    {
+        MarkChanged(chunk->GetNeighbor(0, z == 0 ? -1 : 1));
+    }
+}
+
+void LightEngine::MarkChanged(Chunk *chunk)
+{
+    // Floods stay in one chunk for long stretches, the last entry catches most repeats
+    if (chunk == nullptr || (!m_changedChunks.empty() && m_changedChunks.back() == chunk))
+    {
+        return;
+    }
+    if (std::find(m_changedChunks.begin(), m_changedChunks.end(), chunk) == m_changedChunks.end())
+    {
+        m_changedChunks.push_back(chunk);
+    }
+}
+
+bool LightEngine::Step(LightNode &node, int direction)
+{
+    int x = node.x + DIRECTIONS[direction][0];
+    const int y = node.y + DIRECTIONS[direction][1];
+    int z = node.z + DIRECTIONS[direction][2];
+    if (y < 0 || y >= SIZE)
+    {
+        return false;
+    }
+    if (x < 0 || x >= SIZE)
+    {
+        node.chunk = node.chunk->GetNeighbor(x < 0 ? -1 : 1, 0);
+        x = (x + SIZE) % SIZE;
+    }
+    else if (z < 0 || z >= SIZE)
+    {
+        node.chunk = node.chunk->GetNeighbor(0, z < 0 ? -1 : 1);
+        z = (z + SIZE) % SIZE;
+    }
+    node.x = (int8_t)x;
+    node.y = (int8_t)y;
+    node.z = (int8_t)z;
+    return node.chunk != nullptr;
+}
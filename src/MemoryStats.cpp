@@ -0,0 +1,85 @@
+#include "MemoryStats.hpp"
+
+#include <iomanip>
+
+MemoryStats::Counters MemoryStats::s_counters[MEMORY_CATEGORY_COUNT] = {};
+
+void MemoryStats::Add(MemoryCategory category, int64_t bytes, int64_t count)
+{
+    Counters &counters = s_counters[category];
+    const int64_t total = counters.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    counters.count.fetch_add(count, std::memory_order_relaxed);
+
+    // Raise the peak unless another thread already raised it further
+    int64_t peak = counters.peakBytes.load(std::memory_order_relaxed);
+    while (total > peak && !counters.peakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed))
+    {
+    }
+}
+
+void MemoryStats::Remove(MemoryCategory category, int64_t bytes, int64_t count)
+{
+    Counters &counters = s_counters[category];
+    counters.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    counters.count.fetch_sub(count, std::memory_order_relaxed);
+}
+
+void MemoryStats::Dump(std::ostream &out)
+{
+    const std::ios::fmtflags flags = out.flags();
+    out << std::left << std::setw(14) << "Category" << std::right << std::setw(14) << "KiB"
+        << std::setw(14) << "Peak KiB" << std::setw(10) << "Count" << "\n";
+    out << std::fixed << std::setprecision(1);
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+    {
+        const MemoryUsage usage = Get((MemoryCategory)i);
+        out << std::left << std::setw(14) << GetCategoryName((MemoryCategory)i) << std::right
+            << std::setw(14) << usage.bytes / 1024.0 << std::setw(14) << usage.peakBytes / 1024.0
+            << std::setw(10) << usage.count << "\n";
+    }
+    out << std::left << std::setw(14) << "total" << std::right << std::setw(14) << GetTotalBytes() / 1024.0 << "\n";
+    out.flags(flags);
+}
+
+MemoryUsage MemoryStats::Get(MemoryCategory category)
+{
+    const Counters &counters = s_counters[category];
+    MemoryUsage usage;
+    usage.bytes = counters.bytes.load(std::memory_order_relaxed);
+    usage.count = counters.count.load(std::memory_order_relaxed);
+    usage.peakBytes = counters.peakBytes.load(std::memory_order_relaxed);
+    return usage;
+}
+
+int64_t MemoryStats::GetTotalBytes()
+{
+    int64_t total = 0;
+    for (int i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+    {
+        total += s_counters[i].bytes.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const char *MemoryStats::GetCategoryName(MemoryCategory category)
+{
+    switch (category)
+    {
+    case MEMORY_CHUNK_VOXELS:
+        return "chunk_voxels";
+    case MEMORY_CHUNK_LIGHT:
+        return "chunk_light";
+    case MEMORY_CPU_MESHES:
+        return "cpu_meshes";
+    case MEMORY_GPU_BUFFERS:
+        return "gpu_buffers";
+    case MEMORY_TEXTURES:
+        return "textures";
+    case MEMORY_JOB_QUEUES:
+        return "job_queues";
+    case MEMORY_EDIT_HISTORY:
+        return "edit_history";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,364 @@
+#include "MeshCache.hpp"
+#include "Chunk.hpp"
+#include "Trace.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace
+{
+    const char CACHE_MAGIC[4] = {'V', 'X', 'M', 'C'};
+    const size_t HEADER_BYTES = 8;
+    const size_t ENTRY_HEADER_BYTES = 20;
+
+    uint32_t ReadU32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    void WriteU32(uint8_t *data, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            data[i] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+
+    uint32_t Checksum(uint32_t hash, const void *data, size_t size)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    size_t EntryBytes(uint32_t vertexFloats, uint32_t indexCount)
+    {
+        return ENTRY_HEADER_BYTES + (size_t)vertexFloats * sizeof(GLfloat) + (size_t)indexCount * sizeof(GLuint);
+    }
+}
+
+MeshCache::MeshCache(const std::string &path) : m_path(path)
+{
+    m_open = false;
+    m_hits = 0;
+    m_misses = 0;
+    m_stopping = false;
+    m_writtenCount = 0;
+    m_file = nullptr;
+    m_fileSize = 0;
+}
+
+MeshCache::~MeshCache()
+{
+    Close();
+}
+
+bool MeshCache::Open()
+{
+    TRACE_SCOPE("MeshCache::Open");
+    Close();
+    const bool valid = m_mapping.Open(m_path) && m_mapping.GetSize() >= HEADER_BYTES &&
+                       std::memcmp(m_mapping.GetData(), CACHE_MAGIC, 4) == 0 &&
+                       ReadU32(m_mapping.GetData() + 4) == (uint32_t)Chunk::MESHER_VERSION;
+    bool opened = false;
+    if (valid)
+    {
+        m_fileSize = IndexEntries();
+        opened = true;
+        if (m_fileSize < m_mapping.GetSize())
+        {
+            // A mesh torn by a crash, appends continue where the last whole one ends
+            m_mapping.Close();
+            std::error_code error;
+            std::filesystem::resize_file(m_path, m_fileSize, error);
+            opened = !error && m_mapping.Open(m_path);
+        }
+        m_file = opened ? std::fopen(m_path.c_str(), "ab") : nullptr;
+        opened = m_file != nullptr;
+    }
+    if (!opened && !Truncate())
+    {
+        std::cerr << "Could not open the mesh cache " << m_path << std::endl;
+        return false;
+    }
+
+    m_open = true;
+    m_stopping = false;
+    m_writer = std::thread(&MeshCache::WriterLoop, this);
+    return true;
+}
+
+void MeshCache::Close()
+{
+    if (m_writer.joinable())
+    {
+        // The meshes of the chunks still loaded are written on the way out
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            for (auto &pending : m_pending)
+            {
+                m_queue.push_back(std::move(pending.second));
+            }
+            m_stopping = true;
+        }
+        m_wake.notify_one();
+        m_writer.join();
+    }
+    m_pending.clear();
+    m_open = false;
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+        m_entries.insert(m_written.begin(), m_written.end());
+        Compact();
+    }
+    m_mapping.Close();
+    m_entries.clear();
+    m_written.clear();
+    m_usedKeys.clear();
+}
+
+bool MeshCache::Find(uint64_t key, std::vector<GLfloat> &vertices, std::vector<GLuint> &indices)
+{
+    TRACE_SCOPE("MeshCache::Find");
+    const auto found = m_entries.find(key);
+    if (found == m_entries.end())
+    {
+        m_misses++;
+        return false;
+    }
+    const Entry entry = found->second;
+    if (entry.offset + EntryBytes(entry.vertexFloats, entry.indexCount) > m_mapping.GetSize())
+    {
+        m_misses++;
+        return false;
+    }
+
+    const uint8_t *data = m_mapping.GetData() + entry.offset + ENTRY_HEADER_BYTES;
+    const size_t vertexBytes = (size_t)entry.vertexFloats * sizeof(GLfloat);
+    const size_t indexBytes = (size_t)entry.indexCount * sizeof(GLuint);
+    // Checked on first use rather than on open, a restart only reads the headers
+    if (Checksum(Checksum(2166136261u, data, vertexBytes), data + vertexBytes, indexBytes) !=
+        ReadU32(m_mapping.GetData() + entry.offset + 16))
+    {
+        m_entries.erase(found);
+        m_misses++;
+        return false;
+    }
+    vertices.resize(entry.vertexFloats);
+    indices.resize(entry.indexCount);
+    std::memcpy(vertices.data(), data, vertexBytes);
+    std::memcpy(indices.data(), data + vertexBytes, indexBytes);
+    m_usedKeys.insert(key);
+    m_hits++;
+    return true;
+}
+
+void MeshCache::Store(int chunkX, int chunkZ, uint64_t key, const std::vector<GLfloat> &vertices,
+                      const std::vector<GLuint> &indices)
+{
+    TRACE_SCOPE("MeshCache::Store");
+    if (!m_open)
+    {
+        return;
+    }
+    m_usedKeys.insert(key);
+    // A chunk edited many times only writes its last mesh
+    if (m_entries.count(key) > 0)
+    {
+        m_pending.erase({chunkX, chunkZ});
+        return;
+    }
+    Mesh &mesh = m_pending[{chunkX, chunkZ}];
+    mesh.key = key;
+    mesh.vertices = vertices;
+    mesh.indices = indices;
+}
+
+void MeshCache::Release(int chunkX, int chunkZ)
+{
+    const auto found = m_pending.find({chunkX, chunkZ});
+    if (found == m_pending.end())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(std::move(found->second));
+    }
+    m_pending.erase(found);
+    m_wake.notify_one();
+}
+
+void MeshCache::WriterLoop()
+{
+    std::vector<Mesh> batch;
+    std::unique_lock<std::mutex> lock(m_queueMutex);
+    while (true)
+    {
+        m_wake.wait(lock, [&] { return m_stopping || !m_queue.empty(); });
+        batch.swap(m_queue);
+        const bool stopping = m_stopping;
+        lock.unlock();
+
+        for (const Mesh &mesh : batch)
+        {
+            if (m_file != nullptr && m_written.count(mesh.key) == 0 && !Write(mesh))
+            {
+                // Stop appending, the torn mesh is cut off on the next open
+                std::cerr << "Could not write the mesh cache " << m_path << std::endl;
+                std::fclose(m_file);
+                m_file = nullptr;
+            }
+        }
+        batch.clear();
+
+        lock.lock();
+        if (stopping && m_queue.empty())
+        {
+            break;
+        }
+    }
+}
+
+bool MeshCache::Write(const Mesh &mesh)
+{
+    TRACE_SCOPE("MeshCache::Write");
+    const size_t vertexBytes = mesh.vertices.size() * sizeof(GLfloat);
+    const size_t indexBytes = mesh.indices.size() * sizeof(GLuint);
+    // A full file drops new meshes until Close compacts it
+    if (m_fileSize + ENTRY_HEADER_BYTES + vertexBytes + indexBytes > MAX_FILE_BYTES)
+    {
+        return true;
+    }
+    uint8_t header[ENTRY_HEADER_BYTES];
+    WriteU32(header, (uint32_t)mesh.key);
+    WriteU32(header + 4, (uint32_t)(mesh.key >> 32));
+    WriteU32(header + 8, (uint32_t)mesh.vertices.size());
+    WriteU32(header + 12, (uint32_t)mesh.indices.size());
+    WriteU32(header + 16, Checksum(Checksum(2166136261u, mesh.vertices.data(), vertexBytes), mesh.indices.data(), indexBytes));
+    if (std::fwrite(header, 1, ENTRY_HEADER_BYTES, m_file) != ENTRY_HEADER_BYTES ||
+        std::fwrite(mesh.vertices.data(), 1, vertexBytes, m_file) != vertexBytes ||
+        std::fwrite(mesh.indices.data(), 1, indexBytes, m_file) != indexBytes)
+    {
+        return false;
+    }
+    m_written[mesh.key] = {m_fileSize, (uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size()};
+    m_fileSize += ENTRY_HEADER_BYTES + vertexBytes + indexBytes;
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    m_writtenCount++;
+    return true;
+}
+
+size_t MeshCache::GetHits() const
+{
+    return m_hits;
+}
+
+size_t MeshCache::GetMisses() const
+{
+    return m_misses;
+}
+
+size_t MeshCache::GetEntryCount() const
+{
+    return m_entries.size();
+}
+
+size_t MeshCache::GetWrittenCount()
+{
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_writtenCount;
+}
+
+size_t MeshCache::IndexEntries()
+{
+    m_entries.clear();
+    const uint8_t *data = m_mapping.GetData();
+    const size_t size = m_mapping.GetSize();
+    size_t offset = HEADER_BYTES;
+    while (offset + ENTRY_HEADER_BYTES <= size)
+    {
+        const uint64_t key = ReadU32(data + offset) | ((uint64_t)ReadU32(data + offset + 4) << 32);
+        const uint32_t vertexFloats = ReadU32(data + offset + 8);
+        const uint32_t indexCount = ReadU32(data + offset + 12);
+        const size_t bytes = EntryBytes(vertexFloats, indexCount);
+        if (bytes > size - offset)
+        {
+            break;
+        }
+        m_entries[key] = {offset, vertexFloats, indexCount};
+        offset += bytes;
+    }
+    return offset;
+}
+
+bool MeshCache::Truncate()
+{
+    m_mapping.Close();
+    m_entries.clear();
+    std::error_code error;
+    const std::filesystem::path parent = std::filesystem::path(m_path).parent_path();
+    if (!parent.empty())
+    {
+        std::filesystem::create_directories(parent, error);
+    }
+    m_file = std::fopen(m_path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        return false;
+    }
+    uint8_t header[HEADER_BYTES];
+    std::memcpy(header, CACHE_MAGIC, 4);
+    WriteU32(header + 4, (uint32_t)Chunk::MESHER_VERSION);
+    m_fileSize = HEADER_BYTES;
+    return std::fwrite(header, 1, HEADER_BYTES, m_file) == HEADER_BYTES;
+}
+
+void MeshCache::Compact()
+{
+    if (m_fileSize <= MAX_FILE_BYTES / 2 || !m_mapping.Open(m_path))
+    {
+        return;
+    }
+    TRACE_SCOPE("MeshCache::Compact");
+    // Meshes of chunks not seen this run are dropped, the file is replaced in one rename
+    const std::string temporaryPath = m_path + ".tmp";
+    std::FILE *file = std::fopen(temporaryPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return;
+    }
+    bool ok = std::fwrite(m_mapping.GetData(), 1, HEADER_BYTES, file) == HEADER_BYTES;
+    for (uint64_t key : m_usedKeys)
+    {
+        const auto found = m_entries.find(key);
+        if (found == m_entries.end())
+        {
+            continue;
+        }
+        const Entry &entry = found->second;
+        const size_t bytes = EntryBytes(entry.vertexFloats, entry.indexCount);
+        if (entry.offset + bytes <= m_mapping.GetSize())
+        {
+            ok = ok && std::fwrite(m_mapping.GetData() + entry.offset, 1, bytes, file) == bytes;
+        }
+    }
+    ok = std::fclose(file) == 0 && ok;
+    m_mapping.Close();
+    std::error_code error;
+    if (ok)
+    {
+        std::filesystem::rename(temporaryPath, m_path, error);
+    }
+    if (!ok || error)
+    {
+        std::cerr << "Could not compact the mesh cache " << m_path << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
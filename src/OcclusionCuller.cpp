@@ -0,0 +1,439 @@
+#include "OcclusionCuller.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE 1
+#endif
+
+namespace
+{
+    // Anything closer than this to the eye plane is treated as crossing the near plane
+    const float NEAR_W = 1e-3f;
+    // Rows are handed out to worker threads in bands of this many pixels
+    const int TILE_ROWS = 16;
+
+    // Corner i of a box has x from bit 0, y from bit 1 and z from bit 2
+    glm::vec3 BoxCorner(const AABB &box, int i)
+    {
+        return glm::vec3((i & 1) ? box.max.x : box.min.x,
+                         (i & 2) ? box.max.y : box.min.y,
+                         (i & 4) ? box.max.z : box.min.z);
+    }
+
+    // Box faces as quads, wound counter clockwise when seen from outside
+    const int BOX_FACES[6][4] = {
+        {0, 4, 6, 2}, // -X
+        {1, 3, 7, 5}, // +X
+        {0, 1, 5, 4}, // -Y
+        {2, 6, 7, 3}, // +Y
+        {0, 2, 3, 1}, // -Z
+        {4, 5, 7, 6}, // +Z
+    };
+}
+
+float CullStats::OcclusionRate() const
+{
+    const int survivors = chunksTested - frustumCulled;
+    if (survivors <= 0)
+    {
+        return 0.0f;
+    }
+    return (float)occlusionCulled / (float)survivors;
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, int threadCount)
+{
+    m_width = (std::max(width, 4) + 3) & ~3;
+    m_height = std::max(height, 1);
+    m_threadCount = std::max(threadCount, 1);
+    m_viewProjection = glm::mat4(1.0f);
+    m_depth.assign(m_width * m_height, 1.0f);
+    m_frame = 0;
+    m_bands = 1;
+    m_tilesPerBand = 0;
+    m_remaining = 0;
+    m_stopping = false;
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    StopWorkers();
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4 &viewProjection)
+{
+    m_viewProjection = viewProjection;
+    m_occluders.clear();
+    m_triangles.clear();
+    m_stats = CullStats();
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+
+    // Extract the clip planes from the combined matrix (Gribb/Hartmann)
+    const glm::mat4 &m = viewProjection;
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+    m_frustumPlanes[0] = row3 + row0; // Left
+    m_frustumPlanes[1] = row3 - row0; // Right
+    m_frustumPlanes[2] = row3 + row1; // Bottom
+    m_frustumPlanes[3] = row3 - row1; // Top
+    m_frustumPlanes[4] = row3 + row2; // Near
+    m_frustumPlanes[5] = row3 - row2; // Far
+}
+
+void OcclusionCuller::AddOccluder(const AABB &box)
+{
+    m_occluders.push_back(box);
+}
+
+void OcclusionCuller::RasterizeOccluders()
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Transform every occluder and set up its front facing triangles
+    for (const AABB &box : m_occluders)
+    {
+        glm::vec4 clip[8];
+        for (int i = 0; i < 8; i++)
+        {
+            clip[i] = m_viewProjection * glm::vec4(BoxCorner(box, i), 1.0f);
+        }
+
+        for (const int *face : BOX_FACES)
+        {
+            SetupTriangle(clip[face[0]], clip[face[1]], clip[face[2]]);
+            SetupTriangle(clip[face[0]], clip[face[2]], clip[face[3]]);
+        }
+    }
+    m_stats.occluderBoxes = (int)m_occluders.size();
+    m_stats.occluderTriangles = (int)m_triangles.size();
+
+    // Split the buffer into bands of tile rows and rasterize them in parallel
+    const int tileRows = (m_height + TILE_ROWS - 1) / TILE_ROWS;
+    const int threadCount = std::min(m_threadCount, tileRows);
+    if (threadCount <= 1 || (int)m_triangles.size() < MIN_PARALLEL_TRIANGLES)
+    {
+        RasterizeRows(0, m_height);
+    }
+    else
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if ((int)m_workers.size() != threadCount - 1)
+        {
+            lock.unlock();
+            StopWorkers();
+            lock.lock();
+            m_stopping = false;
+            for (int band = 1; band < threadCount; band++)
+            {
+                m_workers.emplace_back(&OcclusionCuller::WorkerLoop, this, band);
+            }
+        }
+        m_bands = threadCount;
+        m_tilesPerBand = (tileRows + threadCount - 1) / threadCount;
+        m_remaining = threadCount - 1;
+        m_frame++;
+        lock.unlock();
+        m_wake.notify_all();
+
+        int rowBegin, rowEnd;
+        GetBand(0, rowBegin, rowEnd);
+        RasterizeRows(rowBegin, rowEnd);
+        lock.lock();
+        m_done.wait(lock, [this] { return m_remaining == 0; });
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    m_stats.rasterMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void OcclusionCuller::GetBand(int band, int &rowBegin, int &rowEnd) const
+{
+    rowBegin = std::min(band * m_tilesPerBand * TILE_ROWS, m_height);
+    rowEnd = std::min((band + 1) * m_tilesPerBand * TILE_ROWS, m_height);
+}
+
+void OcclusionCuller::WorkerLoop(int band)
+{
+    unsigned frame = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+        m_wake.wait(lock, [&] { return m_stopping || m_frame != frame; });
+        if (m_stopping)
+        {
+            return;
+        }
+        frame = m_frame;
+        int rowBegin, rowEnd;
+        GetBand(band, rowBegin, rowEnd);
+        lock.unlock();
+        RasterizeRows(rowBegin, rowEnd);
+        lock.lock();
+        if (--m_remaining == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
+
+void OcclusionCuller::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void OcclusionCuller::SetupTriangle(const glm::vec4 &a, const glm::vec4 &b, const glm::vec4 &c)
+{
+    // Triangles crossing the near plane are skipped, which only makes the buffer more conservative
+    if (a.w <= NEAR_W || b.w <= NEAR_W || c.w <= NEAR_W)
+    {
+        return;
+    }
+
+    const glm::vec3 p[3] = {glm::vec3(a) / a.w, glm::vec3(b) / b.w, glm::vec3(c) / c.w};
+    glm::vec2 s[3];
+    for (int i = 0; i < 3; i++)
+    {
+        s[i] = glm::vec2((p[i].x * 0.5f + 0.5f) * m_width, (p[i].y * 0.5f + 0.5f) * m_height);
+    }
+
+    // Back facing (or degenerate) triangles are always behind a front face of the same box
+    const float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[2].x - s[0].x) * (s[1].y - s[0].y);
+    if (area <= 0.0f)
+    {
+        return;
+    }
+
+    ScreenTriangle tri;
+    tri.v0 = s[0];
+    tri.v1 = s[1];
+    tri.v2 = s[2];
+    tri.minX = std::max(0, (int)std::floor(std::min({s[0].x, s[1].x, s[2].x})));
+    tri.minY = std::max(0, (int)std::floor(std::min({s[0].y, s[1].y, s[2].y})));
+    tri.maxX = std::min(m_width - 1, (int)std::ceil(std::max({s[0].x, s[1].x, s[2].x})));
+    tri.maxY = std::min(m_height - 1, (int)std::ceil(std::max({s[0].y, s[1].y, s[2].y})));
+    if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+    {
+        return;
+    }
+
+    // Depth varies linearly in screen space, store it as a plane
+    const float dz1 = p[1].z - p[0].z;
+    const float dz2 = p[2].z - p[0].z;
+    tri.zStepX = (dz1 * (s[2].y - s[0].y) - dz2 * (s[1].y - s[0].y)) / area;
+    tri.zStepY = (dz2 * (s[1].x - s[0].x) - dz1 * (s[2].x - s[0].x)) / area;
+    tri.zBase = p[0].z - tri.zStepX * s[0].x - tri.zStepY * s[0].y;
+
+    m_triangles.push_back(tri);
+}
+
+void OcclusionCuller::RasterizeRows(int rowBegin, int rowEnd)
+{
+    TRACE_SCOPE("OcclusionCuller::RasterizeRows");
+    for (const ScreenTriangle &tri : m_triangles)
+    {
+        if (tri.maxY >= rowBegin && tri.minY < rowEnd)
+        {
+            RasterizeTriangle(tri, rowBegin, rowEnd);
+        }
+    }
+}
+
+void OcclusionCuller::RasterizeTriangle(const ScreenTriangle &tri, int rowBegin, int rowEnd)
+{
+    // Edge functions E(p) = dx * (p.y - a.y) - dy * (p.x - a.x), positive inside a CCW triangle
+    const glm::vec2 a[3] = {tri.v0, tri.v1, tri.v2};
+    const glm::vec2 b[3] = {tri.v1, tri.v2, tri.v0};
+    float stepX[3], stepY[3], base[3];
+    for (int e = 0; e < 3; e++)
+    {
+        stepX[e] = -(b[e].y - a[e].y);
+        stepY[e] = b[e].x - a[e].x;
+        base[e] = -stepX[e] * a[e].x - stepY[e] * a[e].y;
+    }
+
+    const int yBegin = std::max(tri.minY, rowBegin);
+    const int yEnd = std::min(tri.maxY + 1, rowEnd);
+    // Start on a multiple of 4 so every group of pixels stays inside the row
+    const int xBegin = tri.minX & ~3;
+    const int xEnd = tri.maxX + 1;
+
+    for (int y = yBegin; y < yEnd; y++)
+    {
+        const float py = y + 0.5f;
+        float *row = &m_depth[y * m_width];
+        float rowEdge[3];
+        for (int e = 0; e < 3; e++)
+        {
+            rowEdge[e] = base[e] + stepY[e] * py;
+        }
+        const float rowZ = tri.zBase + tri.zStepY * py;
+
+#ifdef OCCLUSION_USE_SSE
+        const __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        const __m128 zero = _mm_setzero_ps();
+        for (int x = xBegin; x < xEnd; x += 4)
+        {
+            const __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+            __m128 inside = _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(rowEdge[0]), _mm_mul_ps(_mm_set1_ps(stepX[0]), px)), zero);
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(rowEdge[1]), _mm_mul_ps(_mm_set1_ps(stepX[1]), px)), zero));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(_mm_set1_ps(rowEdge[2]), _mm_mul_ps(_mm_set1_ps(stepX[2]), px)), zero));
+            if (_mm_movemask_ps(inside) == 0)
+            {
+                continue;
+            }
+            const __m128 z = _mm_add_ps(_mm_set1_ps(rowZ), _mm_mul_ps(_mm_set1_ps(tri.zStepX), px));
+            const __m128 current = _mm_loadu_ps(row + x);
+            const __m128 nearest = _mm_min_ps(current, z);
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, current)));
+        }
+#else
+        for (int x = xBegin; x < xEnd; x++)
+        {
+            const float px = x + 0.5f;
+            if (rowEdge[0] + stepX[0] * px > 0.0f &&
+                rowEdge[1] + stepX[1] * px > 0.0f &&
+                rowEdge[2] + stepX[2] * px > 0.0f)
+            {
+                row[x] = std::min(row[x], rowZ + tri.zStepX * px);
+            }
+        }
+#endif
+    }
+}
+
+bool OcclusionCuller::IsInFrustum(const AABB &box) const
+{
+    for (const glm::vec4 &plane : m_frustumPlanes)
+    {
+        // Test the corner furthest along the plane normal
+        const glm::vec3 positive(plane.x >= 0.0f ? box.max.x : box.min.x,
+                                 plane.y >= 0.0f ? box.max.y : box.min.y,
+                                 plane.z >= 0.0f ? box.max.z : box.min.z);
+        if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool OcclusionCuller::IsOccluded(const AABB &box) const
+{
+    float minX = (float)m_width, minY = (float)m_height;
+    float maxX = 0.0f, maxY = 0.0f;
+    float nearestZ = 1.0f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        const glm::vec4 clip = m_viewProjection * glm::vec4(BoxCorner(box, i), 1.0f);
+        // A box reaching the near plane is treated as visible
+        if (clip.w <= NEAR_W)
+        {
+            return false;
+        }
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        const float sx = (ndc.x * 0.5f + 0.5f) * m_width;
+        const float sy = (ndc.y * 0.5f + 0.5f) * m_height;
+        minX = std::min(minX, sx);
+        minY = std::min(minY, sy);
+        maxX = std::max(maxX, sx);
+        maxY = std::max(maxY, sy);
+        nearestZ = std::min(nearestZ, ndc.z);
+    }
+
+    const int x0 = std::max(0, (int)std::floor(minX));
+    const int y0 = std::max(0, (int)std::floor(minY));
+    const int x1 = std::min(m_width - 1, (int)std::ceil(maxX));
+    const int y1 = std::min(m_height - 1, (int)std::ceil(maxY));
+    if (x0 > x1 || y0 > y1)
+    {
+        return false;
+    }
+
+    // Occluded only if every covered pixel already holds something nearer than the box
+    for (int y = y0; y <= y1; y++)
+    {
+        const float *row = &m_depth[y * m_width];
+        int x = x0;
+#ifdef OCCLUSION_USE_SSE
+        const __m128 boxZ = _mm_set1_ps(nearestZ);
+        for (; x + 3 <= x1; x += 4)
+        {
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxZ)) != 0)
+            {
+                return false;
+            }
+        }
+#endif
+        for (; x <= x1; x++)
+        {
+            if (row[x] >= nearestZ)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool OcclusionCuller::TestVisibility(const AABB &box)
+{
+    m_stats.chunksTested++;
+    if (!IsInFrustum(box))
+    {
+        m_stats.frustumCulled++;
+        return false;
+    }
+    if (IsOccluded(box))
+    {
+        m_stats.occlusionCulled++;
+        return false;
+    }
+    return true;
+}
+
+const CullStats &OcclusionCuller::GetStats() const
+{
+    return m_stats;
+}
+
+CullStats &OcclusionCuller::GetStats()
+{
+    return m_stats;
+}
+
+const std::vector<float> &OcclusionCuller::GetDepthBuffer() const
+{
+    return m_depth;
+}
+
+int OcclusionCuller::GetWidth() const
+{
+    return m_width;
+}
+
+int OcclusionCuller::GetHeight() const
+{
+    return m_height;
+}
+
+void OcclusionCuller::SetThreadCount(int threadCount)
+{
+    m_threadCount = std::max(threadCount, 1);
+}
@@ -0,0 +1,813 @@
+#include "RegionFile.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#if defined(LINUX) || defined(MAC)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const char REGION_MAGIC[4] = {'V', 'X', 'R', 'G'};
+    const uint8_t REGION_VERSION = 1;
+    const int REGION_CHUNKS = RegionStore::REGION_SIZE * RegionStore::REGION_SIZE;
+    const size_t TABLE_OFFSET = 8;
+    const size_t HEADER_BYTES = TABLE_OFFSET + REGION_CHUNKS * 8;
+
+    const int CHUNK_VOXELS = Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE * Chunk::CHUNK_SIZE;
+    const size_t RAW_BYTES = CHUNK_VOXELS / 8;
+
+    enum PayloadEncoding : uint8_t
+    {
+        ENCODING_RAW = 0,
+        ENCODING_RLE = 1
+    };
+    // Set on the encoding byte when light sources come before the voxels
+    const uint8_t PAYLOAD_EMITTERS = 0x80;
+    const size_t EMITTER_BYTES = 3;
+    // Set when the light of the voxels comes before them
+    const uint8_t PAYLOAD_LIGHT = 0x40;
+    const uint8_t PAYLOAD_FLAGS = PAYLOAD_EMITTERS | PAYLOAD_LIGHT;
+
+    int FloorDiv(int value, int divisor)
+    {
+        return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    // Region of a chunk and its index in the offset table
+    void LocateChunk(int chunkX, int chunkZ, int &regionX, int &regionZ, int &index)
+    {
+        const int size = RegionStore::REGION_SIZE;
+        regionX = FloorDiv(chunkX, size);
+        regionZ = FloorDiv(chunkZ, size);
+        index = (chunkX - regionX * size) * size + (chunkZ - regionZ * size);
+    }
+
+    uint32_t ReadU32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+
+    void WriteU32(uint8_t *data, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            data[i] = (value >> (8 * i)) & 0xFF;
+        }
+    }
+
+    void WriteVarint(std::vector<uint8_t> &out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+
+    // Varint of up to 3 bytes at the offset, false if it runs past the end
+    bool ReadVarint(const uint8_t *data, size_t size, size_t &offset, uint32_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift <= 14; shift += 7)
+        {
+            if (offset >= size)
+            {
+                return false;
+            }
+            const uint8_t byte = data[offset++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool IsValidRegion(const MappedFile &file)
+    {
+        const uint8_t *data = file.GetData();
+        return file.GetSize() >= HEADER_BYTES && std::memcmp(data, REGION_MAGIC, 4) == 0 &&
+               data[4] == REGION_VERSION && data[5] == Chunk::CHUNK_SIZE;
+    }
+
+    // Make a written file (or a rename in a directory) durable
+    void SyncPath(const std::string &path)
+    {
+#if defined(LINUX) || defined(MAC)
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd >= 0)
+        {
+            fsync(fd);
+            close(fd);
+        }
+#endif
+    }
+
+    // Voxel index to chunk coordinates, x, y, z order
+    Voxel *VoxelAt(Chunk &chunk, int index)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        return chunk.GetVoxel(index / (size * size), (index / size) % size, index % size);
+    }
+
+    // Light source at a voxel index, x, y, z order
+    void SetEmissionAt(Chunk &chunk, int index, int level)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        chunk.SetEmission(index / (size * size), (index / size) % size, index % size, level);
+    }
+
+    void SetLightAt(Chunk &chunk, int index, uint8_t light)
+    {
+        const int size = Chunk::CHUNK_SIZE;
+        chunk.SetLight(index / (size * size), (index / size) % size, index % size, light);
+    }
+}
+
+MappedFile::MappedFile()
+{
+    m_data = nullptr;
+    m_fd = -1;
+    m_size = 0;
+    m_mapped = false;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::string &path)
+{
+    Close();
+#if defined(LINUX) || defined(MAC)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        close(fd);
+        return false;
+    }
+    m_data = (const uint8_t *)data;
+    m_fd = fd;
+    m_size = info.st_size;
+    m_mapped = true;
+    return true;
+#else
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file || file.tellg() <= 0)
+    {
+        return false;
+    }
+    m_copy.resize(file.tellg());
+    file.seekg(0);
+    file.read((char *)m_copy.data(), m_copy.size());
+    if (!file)
+    {
+        m_copy.clear();
+        return false;
+    }
+    m_data = m_copy.data();
+    m_size = m_copy.size();
+    return true;
+#endif
+}
+
+void MappedFile::Close()
+{
+#if defined(LINUX) || defined(MAC)
+    if (m_mapped)
+    {
+        munmap((void *)m_data, m_size);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+#endif
+    m_fd = -1;
+    m_copy.clear();
+    m_data = nullptr;
+    m_size = 0;
+    m_mapped = false;
+}
+
+bool MappedFile::IsResident(size_t offset, size_t length) const
+{
+#if defined(LINUX) || defined(MAC)
+    if (!m_mapped || length == 0)
+    {
+        return true;
+    }
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t first = offset / page * page;
+    const size_t bytes = offset + length - first;
+#if defined(MAC)
+    std::vector<char> pages((bytes + page - 1) / page);
+#else
+    std::vector<unsigned char> pages((bytes + page - 1) / page);
+#endif
+    if (mincore((void *)(m_data + first), bytes, pages.data()) != 0)
+    {
+        return false;
+    }
+    for (auto state : pages)
+    {
+        if ((state & 1) == 0)
+        {
+            return false;
+        }
+    }
+#else
+    (void)offset;
+    (void)length;
+#endif
+    return true;
+}
+
+const uint8_t *MappedFile::GetData() const
+{
+    return m_data;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return m_size;
+}
+
+int MappedFile::GetDescriptor() const
+{
+    return m_fd;
+}
+
+RegionStore::RegionStore(const std::string &directory, bool useIoUring)
+{
+    m_directory = directory;
+    m_pendingCount = 0;
+    m_diskReads = 0;
+    m_reader.reset(new ChunkIO(useIoUring));
+    m_writer.reset(new ChunkIO(useIoUring));
+}
+
+bool RegionStore::LoadChunk(int chunkX, int chunkZ, Chunk &chunk)
+{
+    TRACE_SCOPE("RegionStore::LoadChunk");
+    PayloadSource source;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (!FindPayload(chunkX, chunkZ, lock, source))
+        {
+            return false;
+        }
+    }
+    // Page faults on a cold file happen here, without the lock
+    if (source.file != nullptr)
+    {
+        return DecodeChunk(source.file->mapping.GetData() + source.offset, source.length, chunk);
+    }
+    return DecodeChunk(source.copy.data(), source.copy.size(), chunk);
+}
+
+void RegionStore::LoadChunks(const std::vector<std::pair<int, int>> &coordinates, const std::vector<Chunk *> &chunks,
+                             std::vector<uint8_t> &loaded)
+{
+    TRACE_SCOPE("RegionStore::LoadChunks");
+    loaded.assign(coordinates.size(), 0);
+    // The sources keep their files open until the reads completed
+    std::vector<PayloadSource> sources(coordinates.size());
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (size_t i = 0; i < coordinates.size(); ++i)
+        {
+            FindPayload(coordinates[i].first, coordinates[i].second, lock, sources[i]);
+        }
+    }
+
+    std::vector<ChunkIO::Request> requests;
+    size_t diskReads = 0;
+    for (size_t i = 0; i < coordinates.size(); ++i)
+    {
+        const PayloadSource &source = sources[i];
+        ChunkIO::Request request = {-1, source.offset, source.length, nullptr, nullptr};
+        if (source.file != nullptr)
+        {
+            // Only ranges not in memory are read, the others skip the I/O
+            request.fd = source.file->mapping.GetDescriptor();
+            if (request.fd < 0 || source.file->mapping.IsResident(source.offset, source.length))
+            {
+                request.data = source.file->mapping.GetData() + source.offset;
+            }
+        }
+        else if (!source.copy.empty())
+        {
+            request.data = source.copy.data();
+            request.length = (uint32_t)source.copy.size();
+        }
+        else
+        {
+            continue;
+        }
+        diskReads += request.data == nullptr;
+        Chunk *chunk = chunks[i];
+        uint8_t *result = &loaded[i];
+        request.complete = [chunk, result](const uint8_t *data, size_t size, bool ok)
+        { *result = ok && DecodeChunk(data, size, *chunk); };
+        requests.push_back(std::move(request));
+    }
+    std::lock_guard<std::mutex> readLock(m_readMutex);
+    m_reader->ReadBatch(requests);
+    m_diskReads += diskReads;
+}
+
+bool RegionStore::HasChunk(int chunkX, int chunkZ)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    PayloadSource source;
+    return FindPayload(chunkX, chunkZ, lock, source);
+}
+
+void RegionStore::StoreChunk(int chunkX, int chunkZ, Chunk &chunk)
+{
+    int regionX, regionZ, index;
+    LocateChunk(chunkX, chunkZ, regionX, regionZ, index);
+
+    std::vector<uint8_t> encoded;
+    EncodeChunk(chunk, encoded);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::vector<uint8_t> &payload = GetRegion(regionX, regionZ, lock).pending[index];
+    if (payload.empty())
+    {
+        m_pendingCount++;
+    }
+    payload.swap(encoded);
+}
+
+bool RegionStore::Flush()
+{
+    TRACE_SCOPE("RegionStore::Flush");
+    // One flush at a time. The disk writes happen outside m_mutex so loads never wait for them
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+    std::vector<RegionWrite> writes;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &entry : m_regions)
+        {
+            if (!entry.second.pending.empty())
+            {
+                writes.push_back({entry.first.first, entry.first.second, {}, {}, false});
+            }
+        }
+    }
+    if (writes.empty())
+    {
+        return true;
+    }
+
+    // Write next to the old files and swap them in, so a failed write or a crash never loses saved
+    // chunks. Readers keep using the old mappings meanwhile
+    for (RegionWrite &write : writes)
+    {
+        AssembleRegion(write);
+    }
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    WriteFiles(writes);
+    bool written = true;
+    for (RegionWrite &write : writes)
+    {
+        written = InstallRegion(write) && written;
+    }
+    // Makes the renames durable
+    SyncPath(m_directory);
+    return written;
+}
+
+void RegionStore::EncodeChunk(Chunk &chunk, std::vector<uint8_t> &payload)
+{
+    // Read from the packed copy when the chunk is compressed, saving a cold chunk keeps it cold
+    uint8_t solid[CHUNK_VOXELS];
+    chunk.CopyOccupancy(solid);
+    payload.clear();
+    payload.push_back(ENCODING_RLE);
+    const std::vector<std::pair<uint16_t, uint8_t>> &emitters = chunk.GetEmitters();
+    if (!emitters.empty())
+    {
+        payload[0] |= PAYLOAD_EMITTERS;
+        payload.push_back(emitters.size() & 0xFF);
+        payload.push_back(emitters.size() >> 8);
+        for (const std::pair<uint16_t, uint8_t> &emitter : emitters)
+        {
+            payload.push_back(emitter.first & 0xFF);
+            payload.push_back(emitter.first >> 8);
+            payload.push_back(emitter.second);
+        }
+    }
+    if (chunk.HasLight())
+    {
+        // Runs of equal light, most of a chunk is open sky or dark rock
+        const uint8_t *light = chunk.GetLightData();
+        std::vector<uint8_t> runs;
+        int first = 0;
+        for (int i = 1; i <= CHUNK_VOXELS; ++i)
+        {
+            if (i == CHUNK_VOXELS || light[i] != light[first])
+            {
+                runs.push_back(light[first]);
+                WriteVarint(runs, i - first);
+                first = i;
+            }
+        }
+        payload[0] |= PAYLOAD_LIGHT;
+        WriteVarint(payload, (uint32_t)runs.size());
+        payload.insert(payload.end(), runs.begin(), runs.end());
+    }
+    const size_t voxelsStart = payload.size();
+    bool value = solid[0] != 0;
+    payload.push_back(value);
+    uint32_t run = 0;
+    for (int i = 0; i < CHUNK_VOXELS; ++i)
+    {
+        if ((solid[i] != 0) != value)
+        {
+            WriteVarint(payload, run);
+            value = !value;
+            run = 0;
+        }
+        run++;
+    }
+    WriteVarint(payload, run);
+
+    // Noisy chunks are smaller as a plain bitmap
+    if (payload.size() - voxelsStart > RAW_BYTES)
+    {
+        payload[0] = (payload[0] & PAYLOAD_FLAGS) | ENCODING_RAW;
+        payload.resize(voxelsStart);
+        payload.insert(payload.end(), RAW_BYTES, 0);
+        for (int i = 0; i < CHUNK_VOXELS; ++i)
+        {
+            payload[voxelsStart + i / 8] |= (solid[i] != 0) << (i % 8);
+        }
+    }
+}
+
+bool RegionStore::DecodeChunk(const uint8_t *payload, size_t size, Chunk &chunk)
+{
+    // Everything is decoded and checked first, a damaged payload leaves the chunk as it was
+    if (size == 0)
+    {
+        return false;
+    }
+    const uint8_t encoding = payload[0] & ~PAYLOAD_FLAGS;
+    const size_t emitterCount = (payload[0] & PAYLOAD_EMITTERS) && size >= 3 ? payload[1] | (payload[2] << 8) : 0;
+    // Past the light sources
+    size_t start = (payload[0] & PAYLOAD_EMITTERS) ? 3 + emitterCount * EMITTER_BYTES : 1;
+    if (start >= size)
+    {
+        return false;
+    }
+    std::vector<std::pair<uint16_t, uint8_t>> emitters;
+    for (size_t i = 0; i < emitterCount; ++i)
+    {
+        const uint8_t *emitter = payload + 3 + i * EMITTER_BYTES;
+        const int index = emitter[0] | (emitter[1] << 8);
+        if (index >= CHUNK_VOXELS || emitter[2] > Voxel::MAX_LIGHT)
+        {
+            return false;
+        }
+        emitters.push_back({(uint16_t)index, emitter[2]});
+    }
+
+    std::vector<uint8_t> light(CHUNK_VOXELS, 0);
+    if (payload[0] & PAYLOAD_LIGHT)
+    {
+        uint32_t bytes = 0;
+        if (!ReadVarint(payload, size, start, bytes) || bytes >= size - start)
+        {
+            return false;
+        }
+        const size_t end = start + bytes;
+        int voxel = 0;
+        while (start < end)
+        {
+            const uint8_t level = payload[start++];
+            uint32_t run = 0;
+            if (!ReadVarint(payload, end, start, run) || run == 0 || run > (uint32_t)(CHUNK_VOXELS - voxel))
+            {
+                return false;
+            }
+            std::fill(light.begin() + voxel, light.begin() + voxel + run, level);
+            voxel += run;
+        }
+        if (voxel != CHUNK_VOXELS)
+        {
+            return false;
+        }
+    }
+    // The voxels are read as if their first byte followed the encoding
+    payload += start - 1;
+    size -= start - 1;
+
+    std::vector<uint8_t> solid(CHUNK_VOXELS, 0);
+    if (encoding == ENCODING_RAW)
+    {
+        if (size != 1 + RAW_BYTES)
+        {
+            return false;
+        }
+        for (int i = 0; i < CHUNK_VOXELS; ++i)
+        {
+            solid[i] = (payload[1 + i / 8] >> (i % 8)) & 1;
+        }
+    }
+    else
+    {
+        if (encoding != ENCODING_RLE || size < 2)
+        {
+            return false;
+        }
+        bool value = payload[1] != 0;
+        size_t offset = 2;
+        int voxel = 0;
+        while (offset < size)
+        {
+            uint32_t run = 0;
+            if (!ReadVarint(payload, size, offset, run))
+            {
+                return false;
+            }
+            // Runs are never empty and must cover the chunk exactly
+            if (run == 0 || run > (uint32_t)(CHUNK_VOXELS - voxel))
+            {
+                return false;
+            }
+            std::fill(solid.begin() + voxel, solid.begin() + voxel + run, value);
+            voxel += run;
+            value = !value;
+        }
+        if (voxel != CHUNK_VOXELS)
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < CHUNK_VOXELS; i += Chunk::CHUNK_SIZE)
+    {
+        Voxel *column = VoxelAt(chunk, i);
+        for (int z = 0; z < Chunk::CHUNK_SIZE; ++z)
+        {
+            column[z].SetActive(solid[i + z] != 0);
+        }
+    }
+    chunk.RebuildColumns();
+    const std::vector<std::pair<uint16_t, uint8_t>> previous = chunk.GetEmitters();
+    for (const std::pair<uint16_t, uint8_t> &emitter : previous)
+    {
+        SetEmissionAt(chunk, emitter.first, 0);
+    }
+    for (const std::pair<uint16_t, uint8_t> &emitter : emitters)
+    {
+        SetEmissionAt(chunk, emitter.first, emitter.second);
+    }
+    for (int i = 0; i < CHUNK_VOXELS; ++i)
+    {
+        SetLightAt(chunk, i, light[i]);
+    }
+    return true;
+}
+
+std::string RegionStore::GetRegionPath(int regionX, int regionZ) const
+{
+    return m_directory + "/r." + std::to_string(regionX) + "." + std::to_string(regionZ) + ".vxr";
+}
+
+int RegionStore::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pendingCount;
+}
+
+const char *RegionStore::GetIOBackendName() const
+{
+    return m_reader->GetBackendName();
+}
+
+size_t RegionStore::GetDiskReadCount() const
+{
+    std::lock_guard<std::mutex> lock(m_readMutex);
+    return m_diskReads;
+}
+
+std::shared_ptr<const RegionStore::RegionFile> RegionStore::OpenRegionFile(const std::string &path)
+{
+    std::shared_ptr<RegionFile> file(new RegionFile());
+    if (!file->mapping.Open(path) || !IsValidRegion(file->mapping))
+    {
+        return nullptr;
+    }
+    const uint8_t *data = file->mapping.GetData();
+    file->table.resize(REGION_CHUNKS);
+    for (int index = 0; index < REGION_CHUNKS; ++index)
+    {
+        const uint32_t offset = ReadU32(data + TABLE_OFFSET + index * 8);
+        const uint32_t length = ReadU32(data + TABLE_OFFSET + index * 8 + 4);
+        // Ranges outside the file count as not stored
+        if (length != 0 && offset >= HEADER_BYTES && (uint64_t)offset + length <= file->mapping.GetSize())
+        {
+            file->table[index] = {offset, length};
+        }
+    }
+    return file;
+}
+
+RegionStore::Region &RegionStore::GetRegion(int regionX, int regionZ, std::unique_lock<std::mutex> &lock)
+{
+    auto found = m_regions.find({regionX, regionZ});
+    if (found != m_regions.end())
+    {
+        return found->second;
+    }
+    // The file is opened without the lock, another thread may have added the region meanwhile
+    lock.unlock();
+    std::shared_ptr<const RegionFile> file = OpenRegionFile(GetRegionPath(regionX, regionZ));
+    lock.lock();
+    auto inserted = m_regions.emplace(std::make_pair(regionX, regionZ), Region());
+    if (inserted.second)
+    {
+        inserted.first->second.file = file;
+    }
+    return inserted.first->second;
+}
+
+bool RegionStore::FindPayload(int chunkX, int chunkZ, std::unique_lock<std::mutex> &lock, PayloadSource &source)
+{
+    int regionX, regionZ, index;
+    LocateChunk(chunkX, chunkZ, regionX, regionZ, index);
+    const Region &region = GetRegion(regionX, regionZ, lock);
+    // A pending copy is newer than the file
+    auto pending = region.pending.find(index);
+    if (pending != region.pending.end())
+    {
+        source.copy = pending->second;
+        return true;
+    }
+    if (region.file == nullptr || region.file->table[index].second == 0)
+    {
+        return false;
+    }
+    source.file = region.file;
+    source.offset = region.file->table[index].first;
+    source.length = region.file->table[index].second;
+    return true;
+}
+
+void RegionStore::AssembleRegion(RegionWrite &write)
+{
+    // Only Flush replaces files and it is serialized, so the snapshot stays current while the old
+    // payloads are copied without the lock
+    std::shared_ptr<const RegionFile> file;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const Region &region = GetRegion(write.regionX, write.regionZ, lock);
+        write.written = region.pending;
+        file = region.file;
+    }
+
+    std::vector<uint8_t> &data = write.data;
+    data.assign(HEADER_BYTES, 0);
+    std::memcpy(data.data(), REGION_MAGIC, 4);
+    data[4] = REGION_VERSION;
+    data[5] = Chunk::CHUNK_SIZE;
+    for (int index = 0; index < REGION_CHUNKS; ++index)
+    {
+        const uint8_t *payload = nullptr;
+        size_t size = 0;
+        auto pending = write.written.find(index);
+        if (pending != write.written.end())
+        {
+            payload = pending->second.data();
+            size = pending->second.size();
+        }
+        else if (file != nullptr && file->table[index].second != 0)
+        {
+            payload = file->mapping.GetData() + file->table[index].first;
+            size = file->table[index].second;
+        }
+        if (payload == nullptr)
+        {
+            continue;
+        }
+        WriteU32(&data[TABLE_OFFSET + index * 8], (uint32_t)data.size());
+        WriteU32(&data[TABLE_OFFSET + index * 8 + 4], (uint32_t)size);
+        data.insert(data.end(), payload, payload + size);
+    }
+}
+
+void RegionStore::WriteFiles(std::vector<RegionWrite> &writes)
+{
+#if defined(LINUX) || defined(MAC)
+    // Every region goes out in one batch, then each file is synced
+    std::vector<int> files(writes.size(), -1);
+    std::vector<ChunkIO::Request> requests;
+    for (size_t i = 0; i < writes.size(); ++i)
+    {
+        RegionWrite *write = &writes[i];
+        const std::string temporaryPath = GetRegionPath(write->regionX, write->regionZ) + ".tmp";
+        files[i] = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (files[i] < 0)
+        {
+            std::cerr << "Could not write " << temporaryPath << std::endl;
+            continue;
+        }
+        requests.push_back({files[i], 0, (uint32_t)write->data.size(), write->data.data(),
+                            [write](const uint8_t *, size_t, bool ok)
+                            { write->ok = ok; }});
+    }
+    m_writer->WriteBatch(requests);
+    for (size_t i = 0; i < writes.size(); ++i)
+    {
+        if (files[i] < 0)
+        {
+            continue;
+        }
+        writes[i].ok = writes[i].ok && fsync(files[i]) == 0;
+        close(files[i]);
+        if (!writes[i].ok)
+        {
+            std::cerr << "Could not write " << GetRegionPath(writes[i].regionX, writes[i].regionZ) << ".tmp" << std::endl;
+        }
+    }
+#else
+    for (RegionWrite &write : writes)
+    {
+        const std::string temporaryPath = GetRegionPath(write.regionX, write.regionZ) + ".tmp";
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write((const char *)write.data.data(), write.data.size());
+        write.ok = (bool)file;
+        if (!write.ok)
+        {
+            std::cerr << "Could not write " << temporaryPath << std::endl;
+        }
+    }
+#endif
+}
+
+bool RegionStore::InstallRegion(RegionWrite &write)
+{
+    if (!write.ok)
+    {
+        return false;
+    }
+    const std::string path = GetRegionPath(write.regionX, write.regionZ);
+    std::error_code error;
+    std::filesystem::rename(path + ".tmp", path, error);
+    if (error)
+    {
+        std::cerr << "Could not replace " << path << std::endl;
+        return false;
+    }
+    std::shared_ptr<const RegionFile> file = OpenRegionFile(path);
+    if (file == nullptr)
+    {
+        // The old mapping still holds the chunks that were on disk, the pending ones are kept
+        std::cerr << "Could not map " << path << std::endl;
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    Region &region = GetRegion(write.regionX, write.regionZ, lock);
+    // Readers still holding the old file finish with it, it is unmapped after the last one
+    region.file = file;
+    // Chunks stored again while the file was written stay pending
+    for (const auto &entry : write.written)
+    {
+        auto pending = region.pending.find(entry.first);
+        if (pending != region.pending.end() && pending->second == entry.second)
+        {
+            region.pending.erase(pending);
+            m_pendingCount--;
+        }
+    }
+    return true;
+}
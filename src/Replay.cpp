@@ -0,0 +1,338 @@
+#include "Replay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    const char REPLAY_MAGIC[4] = {'V', 'X', 'R', 'P'};
+    const uint8_t REPLAY_VERSION = 1;
+    const size_t HEADER_BYTES = 12;
+
+    void WriteU16(std::vector<uint8_t> &out, uint16_t value)
+    {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+
+    void WriteU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out.push_back((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    void WriteVarint(std::vector<uint8_t> &out, uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(value);
+    }
+
+    void WriteFloat(std::vector<uint8_t> &out, float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        WriteU32(out, bits);
+    }
+
+    // Small negative and positive coordinates both stay short
+    uint32_t ZigZag(int value)
+    {
+        return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+    }
+
+    int UnZigZag(uint32_t value)
+    {
+        return (int)(value >> 1) ^ -(int)(value & 1);
+    }
+
+    // Bounds checked reads over the loaded bytes, every read fails once the data runs out
+    class Reader
+    {
+    public:
+        Reader(const std::vector<uint8_t> &data, size_t offset) : m_data(data), m_offset(offset), m_ok(true) {}
+
+        uint8_t U8()
+        {
+            if (m_offset >= m_data.size())
+            {
+                m_ok = false;
+                return 0;
+            }
+            return m_data[m_offset++];
+        }
+
+        uint32_t U32()
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                value |= (uint32_t)U8() << (8 * i);
+            }
+            return value;
+        }
+
+        uint32_t Varint()
+        {
+            uint32_t value = 0;
+            for (int shift = 0; shift < 35; shift += 7)
+            {
+                const uint8_t byte = U8();
+                value |= (uint32_t)(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0)
+                {
+                    return value;
+                }
+            }
+            m_ok = false;
+            return 0;
+        }
+
+        float Float()
+        {
+            const uint32_t bits = U32();
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        bool Ok() const { return m_ok; }
+
+    private:
+        const std::vector<uint8_t> &m_data;
+        size_t m_offset;
+        bool m_ok;
+    };
+}
+
+ReplayRecorder::ReplayRecorder(uint16_t tickRate)
+{
+    m_tickRate = tickRate;
+    m_hasCamera = false;
+    m_lastPosition = glm::vec3(0.0f);
+    m_lastDirection = glm::vec3(0.0f);
+}
+
+void ReplayRecorder::RecordCamera(uint32_t tick, const glm::vec3 &position, const glm::vec3 &direction)
+{
+    if (m_hasCamera && position == m_lastPosition && direction == m_lastDirection)
+    {
+        return;
+    }
+    ReplayEvent event;
+    event.type = ReplayEvent::CAMERA;
+    event.tick = tick;
+    event.position = position;
+    event.direction = direction;
+    m_events.push_back(event);
+
+    m_hasCamera = true;
+    m_lastPosition = position;
+    m_lastDirection = direction;
+}
+
+void ReplayRecorder::RecordEdit(uint32_t tick, int x, int y, int z, bool active)
+{
+    ReplayEvent event;
+    event.type = active ? ReplayEvent::PLACE : ReplayEvent::EDIT;
+    event.tick = tick;
+    event.block = glm::ivec3(x, y, z);
+    m_events.push_back(event);
+}
+
+void ReplayRecorder::RecordLight(uint32_t tick, int x, int y, int z, int level)
+{
+    ReplayEvent event;
+    event.type = ReplayEvent::LIGHT;
+    event.tick = tick;
+    event.block = glm::ivec3(x, y, z);
+    event.level = (uint8_t)std::max(0, std::min(level, 255));
+    m_events.push_back(event);
+}
+
+std::vector<uint8_t> ReplayRecorder::Encode() const
+{
+    std::vector<uint8_t> out(REPLAY_MAGIC, REPLAY_MAGIC + 4);
+    out.push_back(REPLAY_VERSION);
+    out.push_back(0);
+    WriteU16(out, m_tickRate);
+    WriteU32(out, (uint32_t)m_events.size());
+
+    uint32_t previousTick = 0;
+    for (const ReplayEvent &event : m_events)
+    {
+        out.push_back(event.type);
+        // Ticks only move forward, a late event is clamped to the previous one
+        const uint32_t tick = std::max(event.tick, previousTick);
+        WriteVarint(out, tick - previousTick);
+        previousTick = tick;
+
+        if (event.type == ReplayEvent::CAMERA)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                WriteFloat(out, event.position[i]);
+            }
+            for (int i = 0; i < 3; ++i)
+            {
+                WriteFloat(out, event.direction[i]);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                WriteVarint(out, ZigZag(event.block[i]));
+            }
+            if (event.type == ReplayEvent::LIGHT)
+            {
+                out.push_back(event.level);
+            }
+        }
+    }
+    return out;
+}
+
+bool ReplayRecorder::Save(const std::string &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    const std::vector<uint8_t> data = Encode();
+    file.write((const char *)data.data(), data.size());
+    return (bool)file;
+}
+
+uint16_t ReplayRecorder::GetTickRate() const
+{
+    return m_tickRate;
+}
+
+size_t ReplayRecorder::GetEventCount() const
+{
+    return m_events.size();
+}
+
+ReplayPlayer::ReplayPlayer()
+{
+    m_tickRate = ReplayRecorder::DEFAULT_TICK_RATE;
+    m_next = 0;
+}
+
+bool ReplayPlayer::Load(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return Decode(data);
+}
+
+bool ReplayPlayer::Decode(const std::vector<uint8_t> &data)
+{
+    m_events.clear();
+    m_next = 0;
+    if (data.size() < HEADER_BYTES || std::memcmp(data.data(), REPLAY_MAGIC, 4) != 0 || data[4] != REPLAY_VERSION)
+    {
+        return false;
+    }
+    const uint16_t tickRate = data[6] | (data[7] << 8);
+    if (tickRate == 0)
+    {
+        return false;
+    }
+
+    Reader reader(data, 8);
+    const uint32_t eventCount = reader.U32();
+    uint32_t tick = 0;
+    std::vector<ReplayEvent> events;
+    for (uint32_t i = 0; i < eventCount && reader.Ok(); ++i)
+    {
+        ReplayEvent event;
+        const uint8_t type = reader.U8();
+        tick += reader.Varint();
+        event.tick = tick;
+        if (type == ReplayEvent::CAMERA)
+        {
+            event.type = ReplayEvent::CAMERA;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                event.position[axis] = reader.Float();
+            }
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                event.direction[axis] = reader.Float();
+            }
+        }
+        else if (type == ReplayEvent::EDIT || type == ReplayEvent::PLACE || type == ReplayEvent::LIGHT)
+        {
+            event.type = (ReplayEvent::Type)type;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                event.block[axis] = UnZigZag(reader.Varint());
+            }
+            if (type == ReplayEvent::LIGHT)
+            {
+                event.level = reader.U8();
+            }
+        }
+        else
+        {
+            return false;
+        }
+        events.push_back(event);
+    }
+    if (!reader.Ok())
+    {
+        return false;
+    }
+
+    m_tickRate = tickRate;
+    m_events.swap(events);
+    return true;
+}
+
+void ReplayPlayer::TakeEvents(uint32_t tick, std::vector<ReplayEvent> &events)
+{
+    events.clear();
+    while (m_next < m_events.size() && m_events[m_next].tick <= tick)
+    {
+        events.push_back(m_events[m_next++]);
+    }
+}
+
+void ReplayPlayer::Rewind()
+{
+    m_next = 0;
+}
+
+bool ReplayPlayer::IsFinished() const
+{
+    return m_next >= m_events.size();
+}
+
+uint16_t ReplayPlayer::GetTickRate() const
+{
+    return m_tickRate;
+}
+
+uint32_t ReplayPlayer::GetLastTick() const
+{
+    return m_events.empty() ? 0 : m_events.back().tick;
+}
+
+const std::vector<ReplayEvent> &ReplayPlayer::GetEvents() const
+{
+    return m_events;
+}
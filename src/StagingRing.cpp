@@ -0,0 +1,175 @@
+#include "StagingRing.hpp"
+#include "MemoryStats.hpp"
+#include <cstring>
+
+namespace
+{
+    // Offsets inside the ring are kept aligned so mapped writes start on a nice boundary
+    const GLsizeiptr RING_ALIGNMENT = 16;
+
+    GLsizeiptr AlignUp(GLsizeiptr size)
+    {
+        return (size + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+    }
+}
+
+StagingRing::StagingRing(GLsizeiptr capacity, GLsizeiptr frameBudget)
+{
+    m_capacity = AlignUp(capacity);
+    m_frameBudget = frameBudget;
+    m_bytesThisFrame = 0;
+    m_reserved = 0;
+    m_head = 0;
+    m_tail = 0;
+    m_inUse = false;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    glBufferData(GL_COPY_READ_BUFFER, m_capacity, nullptr, GL_STREAM_DRAW);
+    MemoryStats::Add(MEMORY_GPU_BUFFERS, m_capacity);
+}
+
+StagingRing::~StagingRing()
+{
+    for (Region &region : m_regions)
+    {
+        glDeleteSync(region.fence);
+    }
+    glDeleteBuffers(1, &m_buffer);
+    MemoryStats::Remove(MEMORY_GPU_BUFFERS, m_capacity);
+}
+
+void StagingRing::BeginFrame()
+{
+    // Retire regions in order until one is still being copied. Never blocks: a zero timeout only polls
+    while (!m_regions.empty())
+    {
+        const GLenum status = glClientWaitSync(m_regions.front().fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        {
+            break;
+        }
+        glDeleteSync(m_regions.front().fence);
+        m_tail = m_regions.front().end;
+        m_regions.pop_front();
+    }
+
+    if (m_regions.empty())
+    {
+        m_inUse = false;
+        m_head = 0;
+        m_tail = 0;
+    }
+    m_bytesThisFrame = 0;
+    m_reserved = 0;
+}
+
+void StagingRing::EndFrame()
+{
+    if (m_bytesThisFrame > 0)
+    {
+        m_regions.push_back({glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), m_head});
+    }
+}
+
+bool StagingRing::CanStage(GLsizeiptr size) const
+{
+    // The first upload of a frame may go over budget so a large mesh is never starved
+    if (m_bytesThisFrame > 0 && m_bytesThisFrame + size > m_frameBudget)
+    {
+        return false;
+    }
+    return FindSpace(AlignUp(size)) >= 0;
+}
+
+bool StagingRing::Reserve(GLsizeiptr size, int parts)
+{
+    // Each part after the first can lose up to one alignment step of room to padding
+    if ((m_bytesThisFrame > 0 && m_bytesThisFrame + size > m_frameBudget) ||
+        FindSpace(AlignUp(size) + (parts - 1) * RING_ALIGNMENT) < 0)
+    {
+        return false;
+    }
+    m_reserved = size;
+    m_bytesThisFrame += size;
+    return true;
+}
+
+bool StagingRing::Stage(GLuint destination, GLintptr destinationOffset, const void *data, GLsizeiptr size)
+{
+    const bool reserved = size <= m_reserved;
+    if (size <= 0 || (!reserved && !CanStage(size)))
+    {
+        return false;
+    }
+
+    const GLsizeiptr alignedSize = AlignUp(size);
+    const GLintptr offset = FindSpace(alignedSize);
+    if (offset < 0)
+    {
+        return false;
+    }
+
+    // The fences guarantee the GPU is done with this range, so the driver does not need to sync
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    void *mapped = glMapBufferRange(GL_COPY_READ_BUFFER, offset, size,
+                                    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (mapped == nullptr)
+    {
+        return false;
+    }
+    std::memcpy(mapped, data, size);
+    glUnmapBuffer(GL_COPY_READ_BUFFER);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, destination);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, destinationOffset, size);
+
+    m_head = offset + alignedSize;
+    if (reserved)
+    {
+        m_reserved -= size;
+    }
+    else
+    {
+        m_bytesThisFrame += size;
+    }
+    m_inUse = true;
+    return true;
+}
+
+GLsizeiptr StagingRing::GetCapacity() const
+{
+    return m_capacity;
+}
+
+GLsizeiptr StagingRing::GetBytesThisFrame() const
+{
+    return m_bytesThisFrame;
+}
+
+GLsizeiptr StagingRing::GetFrameBudget() const
+{
+    return m_frameBudget;
+}
+
+GLintptr StagingRing::FindSpace(GLsizeiptr size) const
+{
+    if (!m_inUse)
+    {
+        return size <= m_capacity ? 0 : -1;
+    }
+
+    // Live data is [tail, head), free space is after head and before tail
+    if (m_head >= m_tail)
+    {
+        if (m_capacity - m_head >= size)
+        {
+            return m_head;
+        }
+        // Wrap around, staying strictly behind the tail so head never catches up with it
+        return size < m_tail ? 0 : -1;
+    }
+
+    // Live data wraps: [tail, capacity) and [0, head)
+    return m_head + size < m_tail ? m_head : -1;
+}
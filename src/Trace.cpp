@@ -0,0 +1,121 @@
+#include "Trace.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // Written only by its owning thread. The count is published with release so Export()
+    // sees complete events, the buffer itself outlives the thread so nothing is lost on exit
+    struct ThreadBuffer
+    {
+        uint32_t threadId;
+        std::unique_ptr<TraceEvent[]> events;
+        std::atomic<uint64_t> count;
+    };
+
+    // Only touched when a thread records its first event and on export
+    std::mutex gRegistryMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> gThreadBuffers;
+
+    const std::chrono::steady_clock::time_point gTraceEpoch = std::chrono::steady_clock::now();
+
+    ThreadBuffer *RegisterThread()
+    {
+        std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+        buffer->events.reset(new TraceEvent[Tracer::EVENTS_PER_THREAD]);
+        buffer->count.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(gRegistryMutex);
+        buffer->threadId = (uint32_t)gThreadBuffers.size() + 1;
+        gThreadBuffers.push_back(std::move(buffer));
+        return gThreadBuffers.back().get();
+    }
+
+    void WriteJsonString(std::ostream &out, const char *text)
+    {
+        out << '"';
+        for (const char *c = text; *c != '\0'; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+}
+
+std::atomic<bool> Tracer::s_enabled(true);
+
+uint64_t Tracer::NowNanoseconds()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - gTraceEpoch)
+        .count();
+}
+
+void Tracer::Record(const char *name, uint64_t startNs, uint64_t endNs)
+{
+    thread_local ThreadBuffer *buffer = RegisterThread();
+
+    const uint64_t count = buffer->count.load(std::memory_order_relaxed);
+    buffer->events[count % EVENTS_PER_THREAD] = {name, startNs, endNs};
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+bool Tracer::Export(const std::string &path)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(gRegistryMutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"voxel-engine\"}}";
+    for (const std::unique_ptr<ThreadBuffer> &buffer : gThreadBuffers)
+    {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"thread " << buffer->threadId << "\"}}";
+
+        // Oldest surviving event first. Events still being overwritten by a busy thread may be
+        // torn, which only affects the oldest few entries of a full buffer
+        const uint64_t count = buffer->count.load(std::memory_order_acquire);
+        const uint64_t first = count > EVENTS_PER_THREAD ? count - EVENTS_PER_THREAD : 0;
+        for (uint64_t i = first; i < count; ++i)
+        {
+            const TraceEvent event = buffer->events[i % EVENTS_PER_THREAD];
+            // Chrome traces use microseconds
+            out << ",\n{\"name\":";
+            WriteJsonString(out, event.name);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                << ",\"ts\":" << event.start / 1000.0
+                << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+void Tracer::SetEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Tracer::IsEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
@@ -13,6 +13,11 @@ glm::vec3 Voxel::GetPosition()
     return m_position;
 }
 
+glm::vec4 Voxel::GetTextureBounds()
+{
+    return GetTextureCoordinates(m_texture_position.x, m_texture_position.y);
+}
+
 glm::vec4 Voxel::GetTextureCoordinates(int x, int y)
 {
     const int PPB = 16; // Pixels per block
@@ -39,50 +44,50 @@ std::vector<GLfloat> Voxel::GetVertexData()
 
     vertices.insert(vertices.end(), {
                                         // Front face
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v1, 0.0f, 0.0f, 1.0f,           // Vertex 0
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v1, 0.0f, 0.0f, 1.0f, // Vertex 1
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v0, 0.0f, 0.0f, 1.0f,           // Vertex 2
-                                        m_position.x, m_position.y, m_position.z + m_width, u0, v0, 0.0f, 0.0f, 1.0f,                     // Vertex 3
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v1, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 0
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v1, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f, // Vertex 1
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v0, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 2
+                                        m_position.x, m_position.y, m_position.z + m_width, u0, v0, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 3
                                     });
 
     // Back face
     vertices.insert(vertices.end(), {
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 0.0f, -1.0f, // Vertex 4
-                                        m_position.x, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 0.0f, -1.0f,           // Vertex 5
-                                        m_position.x, m_position.y, m_position.z, u1, v0, 0.0f, 0.0f, -1.0f,                     // Vertex 6
-                                        m_position.x + m_width, m_position.y, m_position.z, u0, v0, 0.0f, 0.0f, -1.0f,           // Vertex 7
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f, // Vertex 4
+                                        m_position.x, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 5
+                                        m_position.x, m_position.y, m_position.z, u1, v0, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 6
+                                        m_position.x + m_width, m_position.y, m_position.z, u0, v0, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 7
                                     });
 
     // Left face (normal: -1, 0, 0)
     vertices.insert(vertices.end(), {
-                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, -1.0f, 0.0f, 0.0f,           // Vertex 8
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u1, v1, -1.0f, 0.0f, 0.0f, // Vertex 9
-                                        m_position.x, m_position.y, m_position.z + m_width, u1, v0, -1.0f, 0.0f, 0.0f,           // Vertex 10
-                                        m_position.x, m_position.y, m_position.z, u0, v0, -1.0f, 0.0f, 0.0f,                     // Vertex 11
+                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 8
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u1, v1, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 9
+                                        m_position.x, m_position.y, m_position.z + m_width, u1, v0, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 10
+                                        m_position.x, m_position.y, m_position.z, u0, v0, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 11
                                     });
 
     // Right face (normal: 1, 0, 0)
     vertices.insert(vertices.end(), {
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u0, v1, 1.0f, 0.0f, 0.0f, // Vertex 12
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 1.0f, 0.0f, 0.0f,           // Vertex 13
-                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 1.0f, 0.0f, 0.0f,                     // Vertex 14
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u0, v0, 1.0f, 0.0f, 0.0f,           // Vertex 15
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u0, v1, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 12
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 13
+                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 14
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u0, v0, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 15
                                     });
 
     // Top face (normal: 0, 1, 0)
     vertices.insert(vertices.end(), {
-                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 1.0f, 0.0f,                     // Vertex 16
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 1.0f, 0.0f,           // Vertex 17
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v0, 0.0f, 1.0f, 0.0f, // Vertex 18
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v0, 0.0f, 1.0f, 0.0f,           // Vertex 19
+                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 16
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 17
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v0, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 18
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v0, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 19
                                     });
 
     // Bottom face (normal: 0, -1, 0)
     vertices.insert(vertices.end(), {
-                                        m_position.x, m_position.y, m_position.z + m_width, u0, v1, 0.0f, -1.0f, 0.0f,           // Vertex 20
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v1, 0.0f, -1.0f, 0.0f, // Vertex 21
-                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 0.0f, -1.0f, 0.0f,           // Vertex 22
-                                        m_position.x, m_position.y, m_position.z, u0, v0, 0.0f, -1.0f, 0.0f,                     // Vertex 23
+                                        m_position.x, m_position.y, m_position.z + m_width, u0, v1, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 20
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v1, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 21
+                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 22
+                                        m_position.x, m_position.y, m_position.z, u0, v0, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 23
                                     });
 
     return vertices;
@@ -112,10 +117,10 @@ std::vector<GLfloat> Voxel::GetFrontVertices()
 
     vertices.insert(vertices.end(), {
                                         // Front face
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v1, 0.0f, 0.0f, 1.0f,           // Vertex 0
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v1, 0.0f, 0.0f, 1.0f, // Vertex 1
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v0, 0.0f, 0.0f, 1.0f,           // Vertex 2
-                                        m_position.x, m_position.y, m_position.z + m_width, u0, v0, 0.0f, 0.0f, 1.0f,                     // Vertex 3
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v1, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 0
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v1, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f, // Vertex 1
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v0, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 2
+                                        m_position.x, m_position.y, m_position.z + m_width, u0, v0, 0.0f, 0.0f, 1.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 3
                                     });
 
     return vertices;
@@ -132,10 +137,10 @@ std::vector<GLfloat> Voxel::GetBackVertices()
 
     vertices.insert(vertices.end(), {
                                         // Back face
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 0.0f, -1.0f, // Vertex 4
-                                        m_position.x, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 0.0f, -1.0f,           // Vertex 5
-                                        m_position.x, m_position.y, m_position.z, u1, v0, 0.0f, 0.0f, -1.0f,                     // Vertex 6
-                                        m_position.x + m_width, m_position.y, m_position.z, u0, v0, 0.0f, 0.0f, -1.0f,           // Vertex 7
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f, // Vertex 4
+                                        m_position.x, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 5
+                                        m_position.x, m_position.y, m_position.z, u1, v0, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 6
+                                        m_position.x + m_width, m_position.y, m_position.z, u0, v0, 0.0f, 0.0f, -1.0f, 15.0f, 0.0f, 3.0f,           // Vertex 7
                                     });
 
     return vertices;
@@ -152,10 +157,10 @@ std::vector<GLfloat> Voxel::GetLeftVertices()
 
     vertices.insert(vertices.end(), {
                                         // Left face
-                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, -1.0f, 0.0f, 0.0f,           // Vertex 8
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u1, v1, -1.0f, 0.0f, 0.0f, // Vertex 9
-                                        m_position.x, m_position.y, m_position.z + m_width, u1, v0, -1.0f, 0.0f, 0.0f,           // Vertex 10
-                                        m_position.x, m_position.y, m_position.z, u0, v0, -1.0f, 0.0f, 0.0f,                     // Vertex 11
+                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 8
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u1, v1, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 9
+                                        m_position.x, m_position.y, m_position.z + m_width, u1, v0, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 10
+                                        m_position.x, m_position.y, m_position.z, u0, v0, -1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 11
                                     });
 
     return vertices;
@@ -172,10 +177,10 @@ std::vector<GLfloat> Voxel::GetRightVertices()
 
     vertices.insert(vertices.end(), {
                                         // Right face
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u0, v1, 1.0f, 0.0f, 0.0f, // Vertex 12
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 1.0f, 0.0f, 0.0f,           // Vertex 13
-                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 1.0f, 0.0f, 0.0f,                     // Vertex 14
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u0, v0, 1.0f, 0.0f, 0.0f,           // Vertex 15
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u0, v1, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 12
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 13
+                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 14
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u0, v0, 1.0f, 0.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 15
                                     });
 
     return vertices;
@@ -192,10 +197,10 @@ std::vector<GLfloat> Voxel::GetTopVertices()
 
     vertices.insert(vertices.end(), {
                                         // Top face
-                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 1.0f, 0.0f,                     // Vertex 16
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 1.0f, 0.0f,           // Vertex 17
-                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v0, 0.0f, 1.0f, 0.0f, // Vertex 18
-                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v0, 0.0f, 1.0f, 0.0f,           // Vertex 19
+                                        m_position.x, m_position.y + m_width, m_position.z, u0, v1, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 16
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z, u1, v1, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 17
+                                        m_position.x + m_width, m_position.y + m_width, m_position.z + m_width, u1, v0, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 18
+                                        m_position.x, m_position.y + m_width, m_position.z + m_width, u0, v0, 0.0f, 1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 19
                                     });
 
     return vertices;
@@ -212,10 +217,10 @@ std::vector<GLfloat> Voxel::GetBottomVertices()
 
     vertices.insert(vertices.end(), {
                                         // Bottom face
-                                        m_position.x, m_position.y, m_position.z + m_width, u0, v1, 0.0f, -1.0f, 0.0f,           // Vertex 20
-                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v1, 0.0f, -1.0f, 0.0f, // Vertex 21
-                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 0.0f, -1.0f, 0.0f,           // Vertex 22
-                                        m_position.x, m_position.y, m_position.z, u0, v0, 0.0f, -1.0f, 0.0f,                     // Vertex 23
+                                        m_position.x, m_position.y, m_position.z + m_width, u0, v1, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 20
+                                        m_position.x + m_width, m_position.y, m_position.z + m_width, u1, v1, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f, // Vertex 21
+                                        m_position.x + m_width, m_position.y, m_position.z, u1, v0, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,           // Vertex 22
+                                        m_position.x, m_position.y, m_position.z, u0, v0, 0.0f, -1.0f, 0.0f, 15.0f, 0.0f, 3.0f,                     // Vertex 23
                                     });
 
     return vertices;
@@ -24,6 +24,8 @@
 #include <fstream>
 #include <cmath>
 #include <map>
+#include <csignal>
+#include <cstdlib>
 #include <glm/glm.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -31,9 +33,20 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <stb_image.h>
 #include "ChunkManager.hpp"
+#include "HorizonClipmap.hpp"
+#include "OcclusionCuller.hpp"
+#include "GpuBufferArena.hpp"
+#include "StagingRing.hpp"
+#include "FrameStats.hpp"
+#include "FrameTelemetry.hpp"
+#include "GpuTimer.hpp"
+#include "FrameUniforms.hpp"
+#include "MemoryStats.hpp"
+#include "Replay.hpp"
 #include "Camera.hpp"
 #include "Voxel.hpp"
 #include "Shader.hpp"
+#include "Trace.hpp"
 
 // vvvvvvvvvvvvvvvvvvvvvvvvvv Globals vvvvvvvvvvvvvvvvvvvvvvvvvv
 // Globals generally are prefixed with 'g' in this application.
@@ -58,12 +71,36 @@ GLuint gGraphicsPipelineShaderProgram = 0;
 // For example, we may have multiple vertex buffer objects (VBO) related to rendering one
 // object. The VAO allows us to setup the OpenGL state to render that object using the
 // correct layout and correct buffers with one call after being setup.
-GLuint gVoxelVAO = 0;
-// Vertex Buffer Object (VBO)
-// Vertex Buffer Objects store information relating to vertices (e.g. positions, normals, textures)
-// VBOs are our mechanism for arranging geometry on the GPU.
-GLuint gVoxelVBO = 0;
-GLuint gVoxelIBO = 0;
+// All chunk meshes are sub-allocated from one shared vertex/index buffer pair (see GpuBufferArena).
+GpuBufferArena *gChunkArena = nullptr;
+// Arena handle of each chunk's mesh, -1 until the chunk is first meshed
+std::vector<int> gChunkMeshHandles;
+
+// Streaming uploads
+// New chunk meshes are copied into the arena through a fenced staging ring, at most
+// UPLOAD_BYTES_PER_FRAME per frame. Meshes that do not fit wait here for a later frame
+// (newest mesh per chunk wins) while the old mesh keeps being drawn.
+const GLsizeiptr STAGING_RING_BYTES = 8 * 1024 * 1024;
+const GLsizeiptr UPLOAD_BYTES_PER_FRAME = 2 * 1024 * 1024;
+StagingRing *gStagingRing = nullptr;
+struct PendingChunkMesh
+{
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+};
+std::map<int, PendingChunkMesh> gPendingChunkMeshes;
+// Approximate size of one queue entry: the map node and its tree links
+const size_t PENDING_ENTRY_BYTES = sizeof(std::pair<const int, PendingChunkMesh>) + 4 * sizeof(void *);
+
+// Heightfield of the terrain past the loaded chunks, drawn from the chunk arena with the chunks
+HorizonClipmap *gHorizon = nullptr;
+int gHorizonMeshHandle = -1;
+// Horizon mesh waiting for room in the staging ring, a newer one replaces it
+PendingChunkMesh gPendingHorizonMesh;
+bool gHorizonUploadPending = false;
+
+// Set from the SIGUSR1 handler, the main loop prints the memory stats when it sees it
+volatile std::sig_atomic_t gMemoryDumpRequested = 0;
 
 GLuint gSunVAO = 0;		// New VAO for the sun
 GLuint gSunVBO = 0;		// New VBO for the sun
@@ -83,8 +120,43 @@ float g_uRotate = 0.0f;
 // Camera
 Camera gCamera;
 
-std::vector<GLfloat> gVoxelVertexData;
-std::vector<GLuint> gVoxelIndexBufferData;
+// Culling
+// The software depth buffer rejects chunks hidden behind nearer terrain before they are drawn.
+OcclusionCuller gOcclusionCuller(256, 128, 2);
+std::vector<int> gVisibleChunks;
+// Arena handles of the visible chunks, submitted together in one batched draw
+std::vector<int> gVisibleMeshHandles;
+FrameStats gFrameStats;
+
+// Per frame uniforms (view, projection, light, camera) shared by every shader program
+FrameUniformBuffer *gFrameUniformBuffer = nullptr;
+
+// Per phase frame timings and the hitch flight recorder (last 5 seconds, frames over 50 ms)
+FrameTelemetry gFrameTelemetry(5.0, 50.0);
+GpuTimer *gGpuTimer = nullptr;
+std::vector<GpuTimer::Result> gGpuTimes;
+
+// Replay
+// --record <file> saves the camera path and block edits of the session, --replay <file> drives
+// the engine from such a file on a fixed timestep instead of from input.
+ReplayRecorder *gReplayRecorder = nullptr;
+std::string gRecordPath;
+float gRecordSeconds = 0.0f;
+ReplayPlayer *gReplayPlayer = nullptr;
+uint32_t gReplayTick = 0;
+std::vector<ReplayEvent> gReplayEvents;
+
+// Levels of detail
+// Distant chunks get coarser meshes and the window grows to LOD_GRID_SIZE, --no-lod keeps every
+// chunk at full detail in the CHUNK_GRID_SIZE window. --window <chunks> picks the window either way
+bool gLevelsOfDetail = true;
+
+// Farthest block a click can break or place, in blocks
+const float REACH_DISTANCE = 8.0f;
+// Block light emitted by the light sources placed with the middle mouse button
+const int LIGHT_SOURCE_LEVEL = 14;
+// Lowest the eye may get above the terrain under it, in blocks
+const float GROUND_CLEARANCE = 1.5f;
 
 std::vector<GLfloat> gSunVertexData;
 std::vector<GLuint> gSunIndexBufferData;
@@ -147,45 +219,138 @@ void InitializeProgram()
 }
 
 /**
- * Setup your geometry during the vertex specification step
+ * Bytes held by a chunk mesh waiting for upload
+ *
+ * @return size in bytes
+ */
+size_t PendingMeshBytes(const PendingChunkMesh &pending)
+{
+	return pending.vertices.capacity() * sizeof(GLfloat) + pending.indices.capacity() * sizeof(GLuint);
+}
+
+/**
+ * Signal handler, only flags the request so the main loop does the printing
  *
  * @return void
  */
-void VertexSpecification(ChunkManager &chunkManager)
+void RequestMemoryDump(int)
 {
-	// Get the vertex data for the model
-	gVoxelVertexData = chunkManager.GetVertexData();
-	gVoxelIndexBufferData = chunkManager.GetIndexData();
+	gMemoryDumpRequested = 1;
+}
 
-	// Store the sun data
-	gSunVertexData = sun.GetVertexData();
-	GLuint nextSunIndex = 0;
-	sun.GetIndexData(gSunIndexBufferData, nextSunIndex);
+/**
+ * Rebuild the meshes of chunks that changed and stream them into the chunk arena
+ *
+ * @return number of chunk meshes uploaded
+ */
+int UploadChunkMeshes(ChunkManager &chunkManager)
+{
+	TRACE_FUNCTION();
+	std::vector<int> dirtyChunks;
+	chunkManager.TakeDirtyChunks(dirtyChunks);
 
-	// === Setup Cube VAO ===
-	glGenVertexArrays(1, &gVoxelVAO);
-	glBindVertexArray(gVoxelVAO);
+	for (int chunk : dirtyChunks)
+	{
+		// A chunk edited again before its upload replaces the queued mesh
+		auto queued = gPendingChunkMeshes.find(chunk);
+		if (queued == gPendingChunkMeshes.end())
+		{
+			MemoryStats::Add(MEMORY_JOB_QUEUES, PENDING_ENTRY_BYTES);
+		}
+		else
+		{
+			MemoryStats::Remove(MEMORY_CPU_MESHES, PendingMeshBytes(queued->second));
+		}
+		PendingChunkMesh &pending = gPendingChunkMeshes[chunk];
+		pending.vertices = chunkManager.GetChunkVertexData(chunk, pending.indices);
+		MemoryStats::Add(MEMORY_CPU_MESHES, PendingMeshBytes(pending));
+	}
 
-	glGenBuffers(1, &gVoxelVBO);
-	glBindBuffer(GL_ARRAY_BUFFER, gVoxelVBO);
-	glBufferData(GL_ARRAY_BUFFER, gVoxelVertexData.size() * sizeof(GLfloat),
-				 gVoxelVertexData.data(), GL_STATIC_DRAW);
+	// Upload until the staging ring runs out of room or the frame budget is spent
+	int uploaded = 0;
+	while (!gPendingChunkMeshes.empty())
+	{
+		auto pending = gPendingChunkMeshes.begin();
+		const int handle = gChunkArena->Upload(pending->second.vertices, pending->second.indices, *gStagingRing);
+		if (handle < 0)
+		{
+			break;
+		}
+		gChunkArena->Free(gChunkMeshHandles[pending->first]);
+		gChunkMeshHandles[pending->first] = handle;
+		MemoryStats::Remove(MEMORY_CPU_MESHES, PendingMeshBytes(pending->second));
+		MemoryStats::Remove(MEMORY_JOB_QUEUES, PENDING_ENTRY_BYTES);
+		gPendingChunkMeshes.erase(pending);
+		uploaded++;
+	}
 
-	glGenBuffers(1, &gVoxelIBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gVoxelIBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, gVoxelIndexBufferData.size() * sizeof(GLuint),
-				 gVoxelIndexBufferData.data(), GL_STATIC_DRAW);
+	// Edits leave holes behind, compact the arena once they add up
+	gChunkArena->DefragmentIfNeeded(0.5f);
+	return uploaded;
+}
 
-	glEnableVertexAttribArray(0); // Position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (void *)0);
+/**
+ * Recenter the horizon on the eye (in chunk space) around the loaded chunks and stream its mesh
+ * into the chunk arena when it changed
+ *
+ * @return void
+ */
+void UpdateHorizon(ChunkManager &chunkManager, const glm::vec3 &eye)
+{
+	TRACE_FUNCTION();
+	gHorizon->Update(eye.x, eye.z, chunkManager.GetWindowOrigin() * Chunk::CHUNK_SIZE,
+					 chunkManager.GetWindowSize() * Chunk::CHUNK_SIZE);
+	if (gHorizon->IsDirty())
+	{
+		if (gHorizonUploadPending)
+		{
+			MemoryStats::Remove(MEMORY_CPU_MESHES, PendingMeshBytes(gPendingHorizonMesh));
+		}
+		gHorizon->BuildMesh(gPendingHorizonMesh.vertices, gPendingHorizonMesh.indices);
+		MemoryStats::Add(MEMORY_CPU_MESHES, PendingMeshBytes(gPendingHorizonMesh));
+		gHorizonUploadPending = true;
+	}
+	if (!gHorizonUploadPending)
+	{
+		return;
+	}
 
-	glEnableVertexAttribArray(1); // Texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (GLvoid *)(sizeof(GL_FLOAT) * 3));
+	// Without room in the staging ring the old horizon stays until a later frame
+	const int handle = gChunkArena->Upload(gPendingHorizonMesh.vertices, gPendingHorizonMesh.indices, *gStagingRing);
+	if (handle < 0)
+	{
+		return;
+	}
+	gChunkArena->Free(gHorizonMeshHandle);
+	gHorizonMeshHandle = handle;
+	MemoryStats::Remove(MEMORY_CPU_MESHES, PendingMeshBytes(gPendingHorizonMesh));
+	gHorizonUploadPending = false;
+}
 
-	glEnableVertexAttribArray(2); // Normals
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (GLvoid *)(sizeof(GL_FLOAT) * 5));
+/**
+ * Setup your geometry during the vertex specification step
+ *
+ * @return void
+ */
+void VertexSpecification(ChunkManager &chunkManager)
+{
+	TRACE_FUNCTION();
+	// === Setup the chunk arena ===
+	// Sized for the whole grid up front, it grows if edits ever need more room
+	const GLuint chunkCount = chunkManager.GetChunkCount();
+	gChunkArena = new GpuBufferArena(chunkCount * 4096, chunkCount * 6144);
+	gChunkMeshHandles.assign(chunkCount, -1);
+	gStagingRing = new StagingRing(STAGING_RING_BYTES, UPLOAD_BYTES_PER_FRAME);
+	gFrameUniformBuffer = new FrameUniformBuffer();
+	gGpuTimer = new GpuTimer();
 
-	glBindVertexArray(0); // Unbind cube VAO
+	// Store the sun data
+	gSunVertexData = sun.GetVertexData();
+	GLuint nextSunIndex = 0;
+	sun.GetIndexData(gSunIndexBufferData, nextSunIndex);
+	const size_t sunBytes = gSunVertexData.size() * sizeof(GLfloat) + gSunIndexBufferData.size() * sizeof(GLuint);
+	MemoryStats::Add(MEMORY_CPU_MESHES, sunBytes);
+	MemoryStats::Add(MEMORY_GPU_BUFFERS, sunBytes, 2);
 
 	// === Setup Sun VAO ===
 	glGenVertexArrays(1, &gSunVAO);
@@ -196,20 +361,19 @@ void VertexSpecification(ChunkManager &chunkManager)
 	glBufferData(GL_ARRAY_BUFFER, gSunVertexData.size() * sizeof(GLfloat),
 				 gSunVertexData.data(), GL_STATIC_DRAW);
 
-	GLuint sunIBO;
-	glGenBuffers(1, &sunIBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sunIBO);
+	glGenBuffers(1, &gSunIBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gSunIBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, gSunIndexBufferData.size() * sizeof(GLuint),
 				 gSunIndexBufferData.data(), GL_STATIC_DRAW);
 
 	glEnableVertexAttribArray(0); // Position
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (void *)0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * Voxel::VERTEX_FLOATS, (void *)0);
 
 	glEnableVertexAttribArray(1); // Texture coordinates
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (GLvoid *)(sizeof(GL_FLOAT) * 3));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * Voxel::VERTEX_FLOATS, (GLvoid *)(sizeof(GL_FLOAT) * 3));
 
 	glEnableVertexAttribArray(2); // Normals
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * 8, (GLvoid *)(sizeof(GL_FLOAT) * 5));
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GL_FLOAT) * Voxel::VERTEX_FLOATS, (GLvoid *)(sizeof(GL_FLOAT) * 5));
 
 	glBindVertexArray(0); // Unbind sun VAO
 }
@@ -232,6 +396,8 @@ void LoadTexture()
 	{
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
+		// RGB texels, the mip chain adds about a third
+		MemoryStats::Add(MEMORY_TEXTURES, (int64_t)width * height * 3 * 4 / 3);
 	}
 	else
 	{
@@ -240,7 +406,7 @@ void LoadTexture()
 	stbi_image_free(data);
 }
 
-void UpdateSunPosition(float deltaTime, Shader &voxelShader, Shader &sunShader)
+void UpdateSunPosition(float deltaTime, Shader &sunShader)
 {
 	float radius = 30.0f;			 // Radius of the circle
 	float speed = 0.5f;				 // Angular speed (radians per second)
@@ -274,6 +440,29 @@ void UpdateSunPosition(float deltaTime, Shader &voxelShader, Shader &sunShader)
 	sunShader.use();
 	sunShader.setMat4("model", model);
 }
+
+/**
+ * Model matrix of the voxel world, moved and turned by the arrow keys
+ *
+ * @return glm::mat4
+ */
+glm::mat4 WorldModelMatrix()
+{
+	glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, g_uOffset));
+	return glm::rotate(model, glm::radians(g_uRotate), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+/**
+ * The camera's eye in the chunks' own space, where streaming, levels of detail, the horizon,
+ * culling and picking all work
+ *
+ * @return glm::vec3
+ */
+glm::vec3 ChunkSpaceEye()
+{
+	return glm::vec3(glm::inverse(WorldModelMatrix()) * glm::vec4(gCamera.GetEyePosition(), 1.0f));
+}
+
 /**
  * PreDraw
  * Typically we will use this for setting some sort of 'state'
@@ -281,39 +470,42 @@ void UpdateSunPosition(float deltaTime, Shader &voxelShader, Shader &sunShader)
  * 		 pipeline.
  * @return void
  */
-void PreDraw(Shader &voxelShader, Shader &sunShader, float deltaTime)
+void PreDraw(ChunkManager &chunkManager, Shader &voxelShader, Shader &sunShader, float deltaTime)
 {
+	TRACE_FUNCTION();
 	glEnable(GL_DEPTH_TEST);
 	glViewport(0, 0, gScreenWidth, gScreenHeight);
 	glClearColor(135.0f / 255.0f, 206.0f / 255.0f, 235.0f / 255.0f, 1.0f); // Sky Blue
 	glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
 
 	// Model, view, projection setup
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, g_uOffset));
-	model = glm::rotate(model, glm::radians(g_uRotate), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 model = WorldModelMatrix();
 
-	float farPlane = 100.0f;
+	// Far enough for the corners of the horizon
+	float farPlane = gHorizon->GetReach() * 1.5f;
 	glm::mat4 projection = glm::perspective(glm::radians(45.0f),
 											(float)gScreenWidth / (float)gScreenHeight, 0.1f, farPlane);
 	glm::mat4 view = gCamera.GetViewMatrix();
 
+	// Cull chunks against the view frustum and the nearest terrain
+	chunkManager.CullChunks(gOcclusionCuller, projection * view * model, ChunkSpaceEye(), gVisibleChunks);
+
 	// Update shaders and sun position
-	UpdateSunPosition(deltaTime, voxelShader, sunShader);
+	UpdateSunPosition(deltaTime, sunShader);
+
+	// Per frame values go into the uniform buffer every program reads
+	FrameUniforms frameUniforms;
+	frameUniforms.view = view;
+	frameUniforms.projection = projection;
+	frameUniforms.viewProjection = projection * view;
+	frameUniforms.lightPosition = glm::vec4(sun.GetPosition(), 1.0f);
+	frameUniforms.lightColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+	frameUniforms.cameraPosition = glm::vec4(gCamera.GetEyePosition(), 1.0f);
+	gFrameUniformBuffer->Update(frameUniforms);
 
 	// Setup voxel shader
 	voxelShader.use();
-	voxelShader.setVec3("lightColor", 1.0f, 1.0f, 1.0f);
-	voxelShader.setVec3("lightPos", sun.GetPosition());
-	voxelShader.setVec3("viewPos",
-						gCamera.GetEyeXPosition(), gCamera.GetEyeYPosition(), gCamera.GetEyeZPosition());
-	voxelShader.setMat4("projection", projection);
-	voxelShader.setMat4("view", view);
 	voxelShader.setMat4("model", model);
-
-	// Set up sun shader
-	sunShader.use();
-	sunShader.setMat4("projection", projection);
-	sunShader.setMat4("view", view);
 }
 
 /**
@@ -326,6 +518,7 @@ void PreDraw(Shader &voxelShader, Shader &sunShader, float deltaTime)
  */
 void Draw(Shader &voxelShader, Shader &sunShader)
 {
+	TRACE_FUNCTION();
 	// Set polygon mode
 	if (drawType)
 	{
@@ -336,12 +529,20 @@ void Draw(Shader &voxelShader, Shader &sunShader)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	}
 
-	// Draw voxel object
+	gFrameStats = FrameStats();
+
+	// Draw the chunks that survived culling
 	voxelShader.use();
-	glBindVertexArray(gVoxelVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, gVoxelVBO);
-	int elements = gVoxelIndexBufferData.size();
-	glDrawElements(GL_TRIANGLES, elements, GL_UNSIGNED_INT, nullptr);
+	gVisibleMeshHandles.clear();
+	for (int chunk : gVisibleChunks)
+	{
+		gVisibleMeshHandles.push_back(gChunkMeshHandles[chunk]);
+	}
+	if (gHorizonMeshHandle >= 0)
+	{
+		gVisibleMeshHandles.push_back(gHorizonMeshHandle);
+	}
+	gChunkArena->DrawMeshes(gVisibleMeshHandles, gFrameStats);
 
 	// Draw the sun
 	sunShader.use();
@@ -349,6 +550,7 @@ void Draw(Shader &voxelShader, Shader &sunShader)
 	glBindBuffer(GL_ARRAY_BUFFER, gSunVBO);
 	int sunElements = gSunIndexBufferData.size();
 	glDrawElements(GL_TRIANGLES, sunElements, GL_UNSIGNED_INT, nullptr);
+	gFrameStats.drawCalls++;
 
 	// Reset the graphics pipeline (optional)
 	glUseProgram(0);
@@ -367,6 +569,25 @@ void getOpenGLVersionInfo()
 	std::cout << "Shading language: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << "\n";
 }
 
+/**
+ * Lift the camera so the eye stays GROUND_CLEARANCE above the highest block of the column
+ * under it. Used for the spawn position and after the camera moves
+ *
+ * @return void
+ */
+void ClampCameraToGround(ChunkManager &chunkManager)
+{
+	const glm::mat4 model = WorldModelMatrix();
+	const glm::vec3 eye = ChunkSpaceEye();
+	const int surface = chunkManager.GetSurfaceHeight((int)std::floor(eye.x), (int)std::floor(eye.z));
+	if (surface < 0 || eye.y >= surface + GROUND_CLEARANCE)
+	{
+		return;
+	}
+	const glm::vec3 lifted = glm::vec3(model * glm::vec4(eye.x, surface + GROUND_CLEARANCE, eye.z, 1.0f));
+	gCamera.SetCameraEyePosition(lifted.x, lifted.y, lifted.z);
+}
+
 /**
  * Function called in the main application loop to handle user input
  *
@@ -374,6 +595,7 @@ void getOpenGLVersionInfo()
  */
 void Input(ChunkManager &chunkManager)
 {
+	TRACE_FUNCTION();
 	// Event handler that handles various events in SDL
 	// that are related to input and output
 	SDL_Event e;
@@ -381,6 +603,12 @@ void Input(ChunkManager &chunkManager)
 	// Handle events on queue
 	while (SDL_PollEvent(&e) != 0)
 	{
+		// A replay owns the camera and the edits, only quitting and the stats keys still work
+		if (gReplayPlayer != nullptr && e.type != SDL_QUIT && e.type != SDL_KEYDOWN)
+		{
+			continue;
+		}
+
 		// If users posts an event to quit
 		// An example is hitting the "x" in the corner of the window.
 		if (e.type == SDL_QUIT)
@@ -395,6 +623,33 @@ void Input(ChunkManager &chunkManager)
 			case SDLK_t:
 				drawType = !drawType;
 				break;
+			case SDLK_p:
+			{
+				const CullStats &stats = gOcclusionCuller.GetStats();
+				std::cout << "Chunks tested: " << stats.chunksTested
+						  << ", frustum culled: " << stats.frustumCulled
+						  << ", occlusion culled: " << stats.occlusionCulled
+						  << " (" << stats.OcclusionRate() * 100.0f << "%)"
+						  << ", visible: " << stats.chunksVisible
+						  << ", occluders: " << stats.occluderBoxes
+						  << ", raster: " << stats.rasterMilliseconds << " ms" << std::endl;
+				std::cout << "Draw calls: " << gFrameStats.drawCalls
+						  << ", chunks drawn: " << gFrameStats.chunksDrawn
+						  << ", triangles: " << gFrameStats.trianglesSubmitted
+						  << ", submit: " << gFrameStats.submitMilliseconds << " ms" << std::endl;
+				gFrameTelemetry.PrintSummary(std::cout);
+				break;
+			}
+			case SDLK_m:
+				MemoryStats::Dump(std::cout);
+				break;
+			case SDLK_j:
+				// Dump everything traced so far, open it in chrome://tracing or ui.perfetto.dev
+				if (Tracer::Export("trace.json"))
+				{
+					std::cout << "Wrote trace.json" << std::endl;
+				}
+				break;
 			case SDLK_q:
 				gQuit = true;
 			default:
@@ -409,14 +664,43 @@ void Input(ChunkManager &chunkManager)
 		}
 		else if (e.type == SDL_MOUSEBUTTONDOWN)
 		{
-			int cameraX = floor(gCamera.GetEyeXPosition());
-			int cameraY = floor(gCamera.GetEyeYPosition());
-			int cameraZ = floor(gCamera.GetEyeZPosition());
-
-			std::cout << "Camera position " << cameraX << ", " << cameraY << ", " << cameraZ << std::endl;
+			// Left click breaks the block under the crosshair, right click places one against the
+			// face it hit and middle click puts a light source there. There is no face when the
+			// camera is inside the block
+			const glm::mat4 toChunkSpace = glm::inverse(WorldModelMatrix());
+			const glm::vec3 origin = ChunkSpaceEye();
+			const glm::vec3 direction = glm::vec3(toChunkSpace * glm::vec4(gCamera.GetViewDirection(), 0.0f));
+			RaycastHit hit;
+			const bool light = e.button.button == SDL_BUTTON_MIDDLE;
+			const bool place = e.button.button == SDL_BUTTON_RIGHT || light;
+			if (chunkManager.Raycast(origin, direction, REACH_DISTANCE, hit) &&
+				!(place && hit.normal == glm::ivec3(0)))
+			{
+				const glm::ivec3 block = place ? hit.block + hit.normal : hit.block;
+				if (light)
+				{
+					std::cout << "Placed light " << block.x << ", " << block.y << ", " << block.z << std::endl;
+					chunkManager.SetLightSource(block.x, block.y, block.z, LIGHT_SOURCE_LEVEL);
+				}
+				else
+				{
+					std::cout << (place ? "Placed block " : "Broke block ") << block.x << ", " << block.y << ", " << block.z << std::endl;
+					chunkManager.SetBlock(block.x, block.y, block.z, place);
+				}
+				if (gReplayRecorder != nullptr && light)
+				{
+					gReplayRecorder->RecordLight(gRecordSeconds * gReplayRecorder->GetTickRate(), block.x, block.y, block.z, LIGHT_SOURCE_LEVEL);
+				}
+				else if (gReplayRecorder != nullptr)
+				{
+					gReplayRecorder->RecordEdit(gRecordSeconds * gReplayRecorder->GetTickRate(), block.x, block.y, block.z, place);
+				}
+			}
+		}
 
-			chunkManager.UpdateChunks(cameraX, cameraY, cameraZ);
-			VertexSpecification(chunkManager);
+		if (gReplayPlayer != nullptr)
+		{
+			continue;
 		}
 
 		// Retrieve keyboard state
@@ -463,6 +747,45 @@ void Input(ChunkManager &chunkManager)
 		SDL_GetGlobalMouseState(&mouseX, &mouseY);
 		gCamera.MouseLook(mouseX, mouseY);
 	}
+
+	if (gReplayPlayer == nullptr)
+	{
+		ClampCameraToGround(chunkManager);
+	}
+}
+
+/**
+ * Apply the replay events due this tick and advance the replay clock by one tick
+ *
+ * @return void
+ */
+void ApplyReplayEvents(ChunkManager &chunkManager)
+{
+	gReplayPlayer->TakeEvents(gReplayTick, gReplayEvents);
+	for (const ReplayEvent &event : gReplayEvents)
+	{
+		if (event.type == ReplayEvent::CAMERA)
+		{
+			gCamera.SetCameraEyePosition(event.position.x, event.position.y, event.position.z);
+			gCamera.SetViewDirection(event.direction);
+		}
+		else if (event.type == ReplayEvent::LIGHT)
+		{
+			chunkManager.SetLightSource(event.block.x, event.block.y, event.block.z, event.level);
+		}
+		else
+		{
+			chunkManager.SetBlock(event.block.x, event.block.y, event.block.z, event.type == ReplayEvent::PLACE);
+		}
+	}
+
+	if (gReplayPlayer->IsFinished() && gReplayTick >= gReplayPlayer->GetLastTick())
+	{
+		std::cout << "Replay finished after " << gReplayTick + 1 << " ticks" << std::endl;
+		gFrameTelemetry.PrintSummary(std::cout);
+		gQuit = true;
+	}
+	gReplayTick++;
 }
 
 /**
@@ -481,19 +804,74 @@ void MainLoop(ChunkManager &chunkManager, Shader &voxelShader, Shader &sunShader
 	// While application is running
 	while (!gQuit)
 	{
+		TRACE_SCOPE("Frame");
+		gFrameTelemetry.BeginFrame();
 		// Calculate delta time
 		uint64_t currentTime = SDL_GetPerformanceCounter();
 		deltaTime = (float)(currentTime - lastTime) / SDL_GetPerformanceFrequency();
 		lastTime = currentTime;
+		if (gReplayPlayer != nullptr)
+		{
+			// Fixed timestep: every frame is one tick, however long it actually took
+			deltaTime = 1.0f / gReplayPlayer->GetTickRate();
+			ApplyReplayEvents(chunkManager);
+		}
+		if (gMemoryDumpRequested)
+		{
+			gMemoryDumpRequested = 0;
+			MemoryStats::Dump(std::cout);
+		}
+		// GPU times of earlier frames that have finished by now
+		gGpuTimer->Poll(gGpuTimes);
+		for (const GpuTimer::Result &result : gGpuTimes)
+		{
+			gFrameTelemetry.RecordGpuTime(result.frameIndex, result.milliseconds);
+		}
+		// Release staging memory the GPU has finished copying
+		gStagingRing->BeginFrame();
 		// Handle Input
 		Input(chunkManager);
+		if (gReplayRecorder != nullptr)
+		{
+			gRecordSeconds += deltaTime;
+			gReplayRecorder->RecordCamera(gRecordSeconds * gReplayRecorder->GetTickRate(),
+										  gCamera.GetEyePosition(), gCamera.GetViewDirection());
+		}
+		gFrameTelemetry.EndPhase(PHASE_INPUT);
+		// Time all GPU work of the frame, from the upload copies to the last draw
+		gGpuTimer->Begin(gFrameTelemetry.GetFrameIndex());
+		// Load the chunks around the camera, then stream changed chunk meshes to the GPU
+		const glm::vec3 eye = ChunkSpaceEye();
+		chunkManager.StreamAround(eye.x, eye.z);
+		// Distant chunks switch to coarser meshes as the camera moves away from them
+		if (gLevelsOfDetail)
+		{
+			chunkManager.UpdateLevelsOfDetail(eye);
+		}
+		const int chunksUploaded = UploadChunkMeshes(chunkManager);
+		// Chunks loaded with their saved light were meshed with it, check it a few at a time
+		chunkManager.RelightSavedChunks();
+		UpdateHorizon(chunkManager, eye);
+		// Pack the voxels of chunks nobody touched for a while
+		chunkManager.CompressColdChunks();
+		gFrameTelemetry.EndPhase(PHASE_UPLOAD);
 		// Setup anything (i.e. OpenGL State) that needs to take
 		// place before draw calls
-		PreDraw(voxelShader, sunShader, deltaTime);
+		PreDraw(chunkManager, voxelShader, sunShader, deltaTime);
+		gFrameTelemetry.EndPhase(PHASE_PREDRAW);
 		// Draw Calls in OpenGL
 		Draw(voxelShader, sunShader);
+		gGpuTimer->End();
+		// Fence this frame's uploads so their staging memory can be reused
+		gStagingRing->EndFrame();
+		gFrameTelemetry.EndPhase(PHASE_DRAW);
 		// Update screen of our specified window
-		SDL_GL_SwapWindow(gGraphicsApplicationWindow);
+		{
+			TRACE_SCOPE("SwapWindow");
+			SDL_GL_SwapWindow(gGraphicsApplicationWindow);
+		}
+		gFrameTelemetry.EndPhase(PHASE_SWAP);
+		gFrameTelemetry.EndFrame(gFrameStats.chunksDrawn, chunksUploaded);
 	}
 }
 
@@ -511,12 +889,26 @@ void CleanUp()
 	gGraphicsApplicationWindow = nullptr;
 
 	// Delete our OpenGL Objects
-	glDeleteBuffers(1, &gVoxelVBO);
-	glDeleteVertexArrays(1, &gVoxelVAO);
+	delete gFrameUniformBuffer;
+	gFrameUniformBuffer = nullptr;
+	delete gGpuTimer;
+	gGpuTimer = nullptr;
+	delete gStagingRing;
+	gStagingRing = nullptr;
+	if (gHorizonUploadPending)
+	{
+		MemoryStats::Remove(MEMORY_CPU_MESHES, PendingMeshBytes(gPendingHorizonMesh));
+	}
+	delete gHorizon;
+	gHorizon = nullptr;
+	delete gChunkArena;
+	gChunkArena = nullptr;
 
 	// Delete our Sun OpenGL Objects
 	glDeleteBuffers(1, &gSunVBO);
+	glDeleteBuffers(1, &gSunIBO);
 	glDeleteVertexArrays(1, &gSunVAO);
+	MemoryStats::Remove(MEMORY_GPU_BUFFERS, gSunVertexData.size() * sizeof(GLfloat) + gSunIndexBufferData.size() * sizeof(GLuint), 2);
 
 	// Delete our Graphics pipeline
 
@@ -531,7 +923,66 @@ void CleanUp()
  */
 int main(int argc, char **argv)
 {
-	ChunkManager chunkManager = ChunkManager();
+#if defined(LINUX) || defined(MAC)
+	// kill -USR1 <pid> prints the memory stats without touching the window
+	std::signal(SIGUSR1, RequestMemoryDump);
+#endif
+
+	// 1. Parse the command line
+	std::string worldDirectory = "world";
+	int windowSize = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--record" && i + 1 < argc)
+		{
+			gRecordPath = argv[++i];
+			gReplayRecorder = new ReplayRecorder();
+		}
+		else if (arg == "--replay" && i + 1 < argc)
+		{
+			gReplayPlayer = new ReplayPlayer();
+			if (!gReplayPlayer->Load(argv[++i]))
+			{
+				std::cout << "Could not load replay " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--world" && i + 1 < argc)
+		{
+			worldDirectory = argv[++i];
+		}
+		else if (arg == "--window" && i + 1 < argc)
+		{
+			windowSize = std::atoi(argv[++i]);
+		}
+		else if (arg == "--no-lod")
+		{
+			gLevelsOfDetail = false;
+		}
+		else
+		{
+			std::cout << "usage: " << argv[0] << " [--record file] [--replay file] [--world directory] [--window chunks] [--no-lod]" << std::endl;
+			return 1;
+		}
+	}
+
+	// Recordings and replays start from the generated world so they play back the same way
+	if (gReplayRecorder != nullptr || gReplayPlayer != nullptr)
+	{
+		worldDirectory.clear();
+	}
+	if (windowSize <= 0)
+	{
+		windowSize = gLevelsOfDetail ? ChunkManager::LOD_GRID_SIZE : ChunkManager::CHUNK_GRID_SIZE;
+	}
+	ChunkManager chunkManager(worldDirectory, windowSize);
+	gHorizon = new HorizonClipmap(ChunkManager::SEED);
+	// Spawn above the terrain, replays place the camera themselves
+	if (gReplayPlayer == nullptr)
+	{
+		ClampCameraToGround(chunkManager);
+	}
 
 	// 2. Setup the graphics program
 	InitializeProgram();
@@ -552,5 +1003,15 @@ int main(int argc, char **argv)
 	// 6. Call the cleanup function when our program terminates
 	CleanUp();
 
+	if (gReplayRecorder != nullptr)
+	{
+		if (gReplayRecorder->Save(gRecordPath))
+		{
+			std::cout << "Recorded " << gReplayRecorder->GetEventCount() << " events to " << gRecordPath << std::endl;
+		}
+		delete gReplayRecorder;
+	}
+	delete gReplayPlayer;
+
 	return 0;
 }